@@ -5,10 +5,31 @@ in vec4 position_model;
 in vec4 normal;
 in vec2 texcoords;
 in vec4 vertex_color;
+flat in vec3 piece_bbox_min; // Bounding box of the maze piece
+flat in vec3 piece_bbox_max;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Set once per frame (see UniformBuffers)
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+
+// Set before each draw call. Vertices are decoded with position_offset and
+// position_scale; the model matrix of the instance is used instead of
+// "model" when instanced is 1.
+layout (std140) uniform DrawData
+{
+    mat4 model;
+    vec4 bbox_min;
+    vec4 bbox_max;
+    vec4 position_offset;
+    vec4 position_scale;
+    int object_id;
+    int interpolation_type;
+    int instanced;
+};
 
 // Identify the object to be rendered
 #define COW 0
@@ -16,15 +37,10 @@ uniform mat4 projection;
 #define MAZE 2
 #define CHEST 3
 #define CHEST_LID 4
-uniform int object_id;
 
 // Identify the type of interpolation to be used
 #define GOURAUD_INTERPOLATION 0
 #define PHONG_INTERPOLATION 1
-uniform int interpolation_type;
-
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
 
 uniform sampler2D gold_texture;
 uniform sampler2D grass_texture;
@@ -52,8 +68,6 @@ void main()
     }
     else
     {
-        vec4 origin = vec4(0.0,0.0,0.0,1.0);
-        vec4 camera_position = inverse(view) * origin;
         vec4 p = position_world;
         vec4 n = normalize(normal);
         vec4 l = normalize(camera_position - p);
@@ -76,14 +90,16 @@ void main()
         {
             case MAZE:
             {
-                float minx = bbox_min.x;
-                float maxx = bbox_max.x;
+                // The maze is drawn as a single batch, so the box of each
+                // piece comes with its vertices instead of bbox_min/bbox_max
+                float minx = piece_bbox_min.x;
+                float maxx = piece_bbox_max.x;
 
-                float miny = bbox_min.y;
-                float maxy = bbox_max.y;
+                float miny = piece_bbox_min.y;
+                float maxy = piece_bbox_max.y;
 
-                float minz = bbox_min.z;
-                float maxz = bbox_max.z;
+                float minz = piece_bbox_min.z;
+                float maxz = piece_bbox_max.z;
 
                 float epsilon = 0.525;
 
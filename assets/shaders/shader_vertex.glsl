@@ -1,26 +1,49 @@
 #version 330 core
 
-layout (location = 0) in vec4 model_coefficients;
-layout (location = 1) in vec4 normal_coefficients;
+// Vertices are packed (see "vertex_format.h"): positions are 16-bit
+// normalized within a box, decoded with position_offset and position_scale,
+// normals are 10-bit signed normalized and texture coordinates half floats
+layout (location = 0) in vec3 packed_position;
+layout (location = 1) in vec4 packed_normal;
 layout (location = 2) in vec2 texture_coefficients; // Texture coordinates defined in the OBJ file (if available)
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Bounding box of the maze piece the vertex belongs to (maze batch only),
+// quantized like the positions
+layout (location = 3) in vec3 piece_bbox_min_coefficients;
+layout (location = 4) in vec3 piece_bbox_max_coefficients;
+// Model matrix of the instance, used instead of "model" when instanced is 1
+layout (location = 5) in mat4 instance_model;
+
+// Set once per frame (see UniformBuffers)
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+
+// Set before each draw call. Vertices are decoded with position_offset and
+// position_scale; the model matrix of the instance is used instead of
+// "model" when instanced is 1.
+layout (std140) uniform DrawData
+{
+    mat4 model;
+    vec4 bbox_min;
+    vec4 bbox_max;
+    vec4 position_offset;
+    vec4 position_scale;
+    int object_id;
+    int interpolation_type;
+    int instanced;
+};
 
 // Identify the object to be rendered
 #define COW 0
 #define PLANE 1
 #define MAZE 2
-uniform int object_id;
 
 // Identify the type of interpolation to be used
 #define GOURAUD_INTERPOLATION 0
 #define PHONG_INTERPOLATION 1
-uniform int interpolation_type;
-
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
 
 uniform sampler2D gold_texture;
 uniform sampler2D grass_texture;
@@ -34,25 +57,32 @@ out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
 out vec4 vertex_color;
+flat out vec3 piece_bbox_min;
+flat out vec3 piece_bbox_max;
 
 void main()
 {
-    gl_Position = projection * view * model * model_coefficients;
+    vec4 model_coefficients = vec4(position_offset.xyz + position_scale.xyz * packed_position, 1.0);
+    vec4 normal_coefficients = vec4(packed_normal.xyz, 0.0);
+    mat4 model_matrix = (instanced != 0) ? instance_model : model;
+
+    gl_Position = projection * view * model_matrix * model_coefficients;
 
-    position_world = model * model_coefficients;
+    position_world = model_matrix * model_coefficients;
     position_model = model_coefficients;
 
-    normal = inverse(transpose(model)) * normal_coefficients;
+    normal = inverse(transpose(model_matrix)) * normal_coefficients;
     normal.w = 0.0;
 
     texcoords = texture_coefficients;
 
+    piece_bbox_min = position_offset.xyz + position_scale.xyz * piece_bbox_min_coefficients;
+    piece_bbox_max = position_offset.xyz + position_scale.xyz * piece_bbox_max_coefficients;
+
     float u, v;
 
     if (interpolation_type == GOURAUD_INTERPOLATION)
     {
-        vec4 origin = vec4(0.0,0.0,0.0,1.0);
-        vec4 camera_position = inverse(view) * origin;
         vec4 p = position_world;
         vec4 n = normalize(normal);
         vec4 l = normalize(camera_position - p);
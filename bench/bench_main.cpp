@@ -0,0 +1,46 @@
+// Runs the CowQuest benchmarks. With no arguments, every benchmark is run;
+// otherwise only the ones named on the command line.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmarks.h"
+
+namespace {
+
+struct Benchmark {
+    const char* name;
+    int (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    {"bvh", runBvhBenchmark},
+    {"sap", runSweepAndPruneBenchmark},
+    {"dynamic", runDynamicTreeBenchmark},
+    {"soa", runSoaBenchmark},
+    {"frustum", runFrustumBenchmark},
+    {"occlusion", runOcclusionBenchmark},
+    {"meshlets", runMeshletBenchmark},
+    {"textures", runTextureBenchmark},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int result = EXIT_SUCCESS;
+    for (const Benchmark& benchmark : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], benchmark.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        printf("== %s\n", benchmark.name);
+        if (benchmark.run() != EXIT_SUCCESS) {
+            result = EXIT_FAILURE;
+        }
+        printf("\n");
+    }
+    return result;
+}
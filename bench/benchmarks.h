@@ -0,0 +1,18 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <chrono>
+
+using BenchClock = std::chrono::steady_clock;
+
+// Each benchmark prints its own table and returns EXIT_SUCCESS or EXIT_FAILURE
+int runBvhBenchmark();
+int runSweepAndPruneBenchmark();
+int runDynamicTreeBenchmark();
+int runSoaBenchmark();
+int runFrustumBenchmark();
+int runOcclusionBenchmark();
+int runMeshletBenchmark();
+int runTextureBenchmark();
+
+#endif // BENCHMARKS_H
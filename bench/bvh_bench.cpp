@@ -0,0 +1,139 @@
+// Benchmark of the static BVH used by moveAndSlide() and
+// resolveCollisionsWithStaticObjects().
+//
+// Builds a maze-like grid of wall boxes, from the size of the current maze
+// (~120 pieces) up to 100k pieces, and measures the cost of player-sized box
+// queries and movement segment queries against a linear scan.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "physics/bounding.h"
+#include "physics/bvh.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+// Thin walls of random orientation laid over a square grid of cells
+std::vector<AABB> makeMaze(size_t numWalls, std::mt19937& rng) {
+    const float cellSize = 4.0f;
+    const float wallThickness = 0.5f;
+    size_t side = 1;
+    while (side * side < numWalls) {
+        ++side;
+    }
+
+    std::uniform_int_distribution<int> orientation(0, 1);
+    std::vector<AABB> walls;
+    walls.reserve(numWalls);
+    for (size_t i = 0; i < numWalls; ++i) {
+        float x = (i % side) * cellSize;
+        float z = (i / side) * cellSize;
+        glm::vec4 min(x, 0.0f, z, 1.0f);
+        glm::vec4 max;
+        if (orientation(rng)) {
+            max = glm::vec4(x + cellSize, 3.0f, z + wallThickness, 1.0f);
+        } else {
+            max = glm::vec4(x + wallThickness, 3.0f, z + cellSize, 1.0f);
+        }
+        walls.emplace_back(min, max);
+    }
+    return walls;
+}
+
+double nanosecondsPerQuery(Clock::time_point start, Clock::time_point end, size_t numQueries) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / numQueries;
+}
+
+} // namespace
+
+int runBvhBenchmark() {
+    const size_t sizes[] = {120, 1000, 10000, 100000};
+    const size_t numQueries = 20000;
+
+    std::mt19937 rng(42);
+
+    printf("%10s %12s %14s %14s %14s %14s %10s\n",
+           "walls", "build (ms)", "box bvh (ns)", "box scan (ns)",
+           "seg bvh (ns)", "seg scan (ns)", "hits");
+
+    for (size_t numWalls : sizes) {
+        std::vector<AABB> walls = makeMaze(numWalls, rng);
+
+        AABB worldBounds = walls[0];
+        for (const AABB& wall : walls) {
+            worldBounds.setMin(glm::min(worldBounds.getMin(), wall.getMin()));
+            worldBounds.setMax(glm::max(worldBounds.getMax(), wall.getMax()));
+        }
+
+        // Player-sized boxes and short movement segments spread over the maze
+        std::uniform_real_distribution<float> px(worldBounds.getMin().x, worldBounds.getMax().x);
+        std::uniform_real_distribution<float> pz(worldBounds.getMin().z, worldBounds.getMax().z);
+        std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+        std::vector<AABB> boxes;
+        std::vector<glm::vec4> origins;
+        std::vector<glm::vec4> moves;
+        for (size_t i = 0; i < numQueries; ++i) {
+            glm::vec4 center(px(rng), 1.0f, pz(rng), 1.0f);
+            boxes.emplace_back(center - glm::vec4(0.5f, 1.0f, 0.5f, 0.0f),
+                               center + glm::vec4(0.5f, 1.0f, 0.5f, 0.0f));
+            origins.push_back(center);
+            moves.emplace_back(step(rng), 0.0f, step(rng), 0.0f);
+        }
+
+        auto buildStart = Clock::now();
+        StaticBVH bvh;
+        bvh.build(walls);
+        auto buildEnd = Clock::now();
+
+        size_t bvhHits = 0;
+        auto start = Clock::now();
+        for (const AABB& box : boxes) {
+            bvh.query(box, [&](int) { ++bvhHits; return false; });
+        }
+        double boxBvh = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        size_t scanHits = 0;
+        start = Clock::now();
+        for (const AABB& box : boxes) {
+            for (const AABB& wall : walls) {
+                scanHits += box.intersects(wall) ? 1 : 0;
+            }
+        }
+        double boxScan = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        size_t segmentHits = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < numQueries; ++i) {
+            bvh.querySegment(origins[i], moves[i], [&](int) { ++segmentHits; return false; });
+        }
+        double segmentBvh = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        size_t segmentScanHits = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < numQueries; ++i) {
+            for (const AABB& wall : walls) {
+                segmentScanHits += wall.intersectsSegment(origins[i], origins[i] + moves[i]) ? 1 : 0;
+            }
+        }
+        double segmentScan = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        if (bvhHits != scanHits || segmentHits != segmentScanHits) {
+            fprintf(stderr, "ERROR: BVH and linear scan disagree (%zu/%zu boxes, %zu/%zu segments).\n",
+                    bvhHits, scanHits, segmentHits, segmentScanHits);
+            return EXIT_FAILURE;
+        }
+
+        printf("%10zu %12.3f %14.1f %14.1f %14.1f %14.1f %10zu\n",
+               numWalls,
+               std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(),
+               boxBvh, boxScan, segmentBvh, segmentScan, bvhHits + segmentHits);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+// Benchmark of the pair queries of the dynamic AABB tree.
+//
+// Moves from 100 to 10k boxes with a random walk every frame, replacing a
+// few of them by new ones, so that the tree goes through moves, reinsertions
+// and the rotations that keep it balanced. The pairs of queryPairs() and
+// queryStaticPairs() (against a BVH of walls) are checked against those of a
+// nested loop over the fat boxes, every frame up to 1000 boxes and on the
+// last frame above.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "physics/bounding.h"
+#include "physics/bvh.h"
+#include "physics/dynamic_tree.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+using Pair = std::pair<int32_t, int32_t>;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Same test as the tree, bounds included
+bool overlaps(const AABB& a, const AABB& b) {
+    return a.getMin().x <= b.getMax().x && a.getMax().x >= b.getMin().x &&
+           a.getMin().y <= b.getMax().y && a.getMax().y >= b.getMin().y &&
+           a.getMin().z <= b.getMax().z && a.getMax().z >= b.getMin().z;
+}
+
+AABB boxAround(const glm::vec4& center, const glm::vec4& halfSize) {
+    return AABB(center - halfSize, center + halfSize);
+}
+
+} // namespace
+
+int runDynamicTreeBenchmark() {
+    const size_t sizes[] = {100, 1000, 10000};
+    const int numFrames = 20;
+    const size_t replacedPerFrame = 4; // Destroyed and created again elsewhere
+    const size_t maxCheckedEveryFrame = 1000;
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+    std::uniform_int_distribution<int> wallAxis(0, 1);
+    const glm::vec4 boxHalfSize(0.5f, 0.5f, 0.5f, 0.0f);
+
+    printf("%10s %12s %12s %12s %10s %8s %10s %10s\n", "boxes", "pairs (ms)", "static (ms)", "n^2 (ms)",
+           "moved", "height", "pairs", "static");
+
+    for (size_t numBoxes : sizes) {
+        // Unit boxes over a flat world, and as many walls, 4 units long
+        float side = std::sqrt(static_cast<float>(numBoxes)) * 3.0f;
+        std::uniform_real_distribution<float> position(0.0f, side);
+        auto randomBox = [&]() {
+            return boxAround(glm::vec4(position(rng), 0.5f, position(rng), 1.0f), boxHalfSize);
+        };
+
+        std::vector<AABB> walls;
+        for (size_t i = 0; i < numBoxes; ++i) {
+            glm::vec4 halfSize = wallAxis(rng) == 0 ? glm::vec4(2.0f, 1.0f, 0.1f, 0.0f)
+                                                    : glm::vec4(0.1f, 1.0f, 2.0f, 0.0f);
+            walls.push_back(boxAround(glm::vec4(position(rng), 1.0f, position(rng), 1.0f), halfSize));
+        }
+        StaticBVH bvh;
+        bvh.build(walls);
+
+        DynamicAABBTree tree;
+        std::vector<AABB> boxes;
+        std::vector<int32_t> proxies;
+        for (size_t i = 0; i < numBoxes; ++i) {
+            boxes.push_back(randomBox());
+            proxies.push_back(tree.createProxy(boxes[i], nullptr));
+        }
+
+        double pairTime = 0.0;
+        double staticTime = 0.0;
+        double bruteForceTime = 0.0;
+        int numChecked = 0;
+        size_t numMoved = 0;
+        std::vector<Pair> pairs, staticPairs, expectedPairs, expectedStaticPairs;
+        for (int frame = 0; frame < numFrames; ++frame) {
+            for (size_t i = 0; i < numBoxes; ++i) {
+                glm::vec4 displacement(step(rng), 0.0f, step(rng), 0.0f);
+                boxes[i].move(displacement);
+                numMoved += tree.moveProxy(proxies[i], boxes[i], glm::vec3(displacement)) ? 1 : 0;
+            }
+            for (size_t j = 0; j < replacedPerFrame; ++j) {
+                size_t i = rng() % numBoxes;
+                tree.destroyProxy(proxies[i]);
+                boxes[i] = randomBox();
+                proxies[i] = tree.createProxy(boxes[i], nullptr);
+            }
+
+            pairs.clear();
+            auto start = Clock::now();
+            tree.queryPairs([&](int32_t a, int32_t b) { pairs.emplace_back(a, b); });
+            pairTime += millisecondsSince(start);
+
+            staticPairs.clear();
+            start = Clock::now();
+            tree.queryStaticPairs(bvh, [&](int32_t proxy, int wall) { staticPairs.emplace_back(proxy, wall); });
+            staticTime += millisecondsSince(start);
+
+            if (numBoxes > maxCheckedEveryFrame && frame + 1 < numFrames) {
+                continue;
+            }
+            start = Clock::now();
+            expectedPairs.clear();
+            expectedStaticPairs.clear();
+            for (size_t i = 0; i < numBoxes; ++i) {
+                AABB fat = tree.getFatAABB(proxies[i]);
+                for (size_t j = i + 1; j < numBoxes; ++j) {
+                    if (overlaps(fat, tree.getFatAABB(proxies[j]))) {
+                        expectedPairs.emplace_back(std::min(proxies[i], proxies[j]),
+                                                   std::max(proxies[i], proxies[j]));
+                    }
+                }
+                for (size_t wall = 0; wall < walls.size(); ++wall) {
+                    if (overlaps(fat, walls[wall])) {
+                        expectedStaticPairs.emplace_back(proxies[i], static_cast<int32_t>(wall));
+                    }
+                }
+            }
+            bruteForceTime += millisecondsSince(start);
+            ++numChecked;
+
+            std::sort(pairs.begin(), pairs.end());
+            std::sort(staticPairs.begin(), staticPairs.end());
+            std::sort(expectedPairs.begin(), expectedPairs.end());
+            std::sort(expectedStaticPairs.begin(), expectedStaticPairs.end());
+            if (pairs != expectedPairs || staticPairs != expectedStaticPairs) {
+                fprintf(stderr, "ERROR: frame %d of %zu boxes: the tree found %zu/%zu pairs, "
+                        "the nested loop %zu/%zu.\n", frame, numBoxes, pairs.size(), staticPairs.size(),
+                        expectedPairs.size(), expectedStaticPairs.size());
+                return EXIT_FAILURE;
+            }
+        }
+
+        // The rotations keep the height logarithmic, whatever the moves
+        int32_t maxHeight = 2 * static_cast<int32_t>(std::ceil(std::log2(static_cast<double>(numBoxes)))) + 2;
+        if (tree.getProxyCount() != numBoxes || tree.getHeight() > maxHeight) {
+            fprintf(stderr, "ERROR: %zu proxies in a tree of height %d, above %d.\n", tree.getProxyCount(),
+                    tree.getHeight(), maxHeight);
+            return EXIT_FAILURE;
+        }
+
+        printf("%10zu %12.3f %12.3f %12.3f %10zu %8d %10zu %10zu\n", numBoxes, pairTime / numFrames,
+               staticTime / numFrames, bruteForceTime / numChecked, numMoved / numFrames, tree.getHeight(),
+               pairs.size(), staticPairs.size());
+    }
+
+    return EXIT_SUCCESS;
+}
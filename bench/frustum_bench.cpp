@@ -0,0 +1,121 @@
+// Benchmark of the frustum culler and its plane test kernels.
+//
+// Culls many boxes spread over a floor, like the maze pieces, against
+// cameras placed and turned at random, comparing the SIMD kernels with the
+// scalar kernel (which must return exactly the same bits).
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "graphics/frustum.h"
+#include "utils/math_utils.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+// Same projection as the game
+const float nearPlane = -0.1f;
+const float farPlane = -100.0f;
+const float fieldOfView = 3.14159265f / 3.0f;
+
+ViewFrustum makeFrustum(std::mt19937& rng, float extent) {
+    std::uniform_real_distribution<float> position(0.0f, extent);
+    std::uniform_real_distribution<float> yaw(0.0f, 6.2831853f);
+
+    float angle = yaw(rng);
+    glm::vec4 camera(position(rng), 1.0f, position(rng), 1.0f);
+    glm::vec4 view(std::sin(angle), 0.0f, std::cos(angle), 0.0f);
+    glm::mat4 clip = Matrix_Perspective(fieldOfView, 16.0f / 9.0f, nearPlane, farPlane)
+                   * Matrix_Camera_View(camera, view, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    return ViewFrustum::fromMatrix(clip);
+}
+
+double nanosecondsPerFrustum(Clock::time_point start, Clock::time_point end, size_t numFrusta) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / numFrusta;
+}
+
+} // namespace
+
+int runFrustumBenchmark() {
+    const size_t sizes[] = {128, 1024, 16384, 131072};
+
+    std::mt19937 rng(42);
+
+    printf("SIMD path: %s, batch of %zu boxes\n", FrustumCuller::simdPath(), FrustumCuller::batchSize);
+    printf("%10s %10s %14s %14s %10s\n", "boxes", "frusta", "scalar (ns)", "simd (ns)", "visible");
+
+    for (size_t numBoxes : sizes) {
+        const size_t numFrusta = std::max<size_t>(16, (1u << 22) / numBoxes);
+        const float extent = 4.0f * std::sqrt(static_cast<float>(numBoxes));
+
+        std::uniform_real_distribution<float> position(0.0f, extent);
+        std::uniform_real_distribution<float> size(0.2f, 2.0f);
+        FrustumCuller culler;
+        for (size_t i = 0; i < numBoxes; ++i) {
+            glm::vec4 center(position(rng), size(rng), position(rng), 1.0f);
+            glm::vec4 halfSize(size(rng), size(rng), size(rng), 0.0f);
+            culler.add(AABB(center - halfSize, center + halfSize));
+        }
+        std::vector<ViewFrustum> frusta;
+        for (size_t i = 0; i < numFrusta; ++i) {
+            frusta.push_back(makeFrustum(rng, extent));
+        }
+
+        const size_t numBatches = (numBoxes + FrustumCuller::batchSize - 1) / FrustumCuller::batchSize;
+        std::vector<uint32_t> scalarMasks;
+        scalarMasks.reserve(numFrusta * numBatches);
+        auto start = Clock::now();
+        for (const ViewFrustum& frustum : frusta) {
+            for (size_t first = 0; first < numBoxes; first += FrustumCuller::batchSize) {
+                scalarMasks.push_back(culler.testRangeScalar(frustum, first, numBoxes - first));
+            }
+        }
+        double scalarTime = nanosecondsPerFrustum(start, Clock::now(), numFrusta);
+
+        std::vector<uint32_t> simdMasks;
+        simdMasks.reserve(numFrusta * numBatches);
+        start = Clock::now();
+        for (const ViewFrustum& frustum : frusta) {
+            for (size_t first = 0; first < numBoxes; first += FrustumCuller::batchSize) {
+                simdMasks.push_back(culler.testRange(frustum, first, numBoxes - first));
+            }
+        }
+        double simdTime = nanosecondsPerFrustum(start, Clock::now(), numFrusta);
+
+        if (simdMasks != scalarMasks) {
+            fprintf(stderr, "ERROR: SIMD and scalar kernels disagree.\n");
+            return EXIT_FAILURE;
+        }
+
+        // cull() must list the same boxes as the masks
+        std::vector<uint32_t> visible;
+        size_t numVisible = 0;
+        for (const ViewFrustum& frustum : frusta) {
+            visible.clear();
+            numVisible += culler.cull(frustum, visible);
+        }
+        size_t maskVisible = 0;
+        for (uint32_t mask : simdMasks) {
+            while (mask) {
+                mask &= mask - 1;
+                ++maskVisible;
+            }
+        }
+        if (numVisible != maskVisible) {
+            fprintf(stderr, "ERROR: cull() and testRange() disagree (%zu/%zu boxes).\n", numVisible, maskVisible);
+            return EXIT_FAILURE;
+        }
+
+        printf("%10zu %10zu %14.1f %14.1f %9.1f%%\n", numBoxes, numFrusta, scalarTime, simdTime,
+               100.0 * numVisible / (numFrusta * numBoxes));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+// Benchmark of the meshlet culling.
+//
+// Splits a dense torus, about as many triangles as the cow, into meshlets
+// and culls them against cameras placed around it at random, some close
+// enough to see only part of it. Compares the triangles culled with the
+// triangles a per-triangle test would cull, and checks that no culled
+// meshlet holds a triangle facing the camera inside the view frustum.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "graphics/meshlets.h"
+#include "graphics/mesh_optimizer.h"
+#include "utils/math_utils.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+// Same projection as the game
+const float nearPlane = -0.1f;
+const float farPlane = -100.0f;
+const float fieldOfView = 3.14159265f / 3.0f;
+
+const float majorRadius = 1.0f;
+const float minorRadius = 0.4f;
+
+glm::vec3 position(const MeshVertex& vertex) {
+    return glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+}
+
+// A torus of 2 * rings * sides triangles, facing outwards
+void buildTorus(size_t rings, size_t sides, std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    const float twoPi = 6.2831853f;
+    for (size_t i = 0; i < rings; ++i) {
+        for (size_t j = 0; j < sides; ++j) {
+            float u = twoPi * i / rings;
+            float v = twoPi * j / sides;
+            glm::vec3 normal(std::cos(v) * std::cos(u), std::sin(v), std::cos(v) * std::sin(u));
+            glm::vec3 p = majorRadius * glm::vec3(std::cos(u), 0.0f, std::sin(u)) + minorRadius * normal;
+            vertices.push_back({{p.x, p.y, p.z, 1.0f}, {normal.x, normal.y, normal.z, 0.0f}, {0.0f, 0.0f}});
+        }
+    }
+    auto vertex = [&](size_t i, size_t j) { return static_cast<uint32_t>((i % rings) * sides + j % sides); };
+    for (size_t i = 0; i < rings; ++i) {
+        for (size_t j = 0; j < sides; ++j) {
+            uint32_t quad[4] = {vertex(i, j), vertex(i + 1, j), vertex(i + 1, j + 1), vertex(i, j + 1)};
+            uint32_t triangles[2][3] = {{quad[0], quad[1], quad[2]}, {quad[0], quad[2], quad[3]}};
+            for (auto& triangle : triangles) {
+                glm::vec3 a = position(vertices[triangle[0]]);
+                glm::vec3 b = position(vertices[triangle[1]]);
+                glm::vec3 c = position(vertices[triangle[2]]);
+                glm::vec3 outwards(vertices[triangle[0]].normal[0], vertices[triangle[0]].normal[1],
+                                   vertices[triangle[0]].normal[2]);
+                if (glm::dot(glm::cross(b - a, c - a), outwards) < 0.0f) {
+                    std::swap(triangle[1], triangle[2]);
+                }
+                indices.insert(indices.end(), triangle, triangle + 3);
+            }
+        }
+    }
+}
+
+struct Camera {
+    ViewFrustum frustum;
+    glm::vec3 position;
+};
+
+Camera makeCamera(std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(1.8f, 6.0f);
+
+    glm::vec3 direction;
+    do {
+        direction = glm::vec3(unit(rng), unit(rng), unit(rng));
+    } while (glm::length(direction) < 0.1f || glm::length(direction) > 1.0f);
+    glm::vec3 position = glm::normalize(direction) * distance(rng);
+    glm::vec3 target = 0.5f * glm::vec3(unit(rng), unit(rng), unit(rng));
+
+    glm::mat4 clip = Matrix_Perspective(fieldOfView, 16.0f / 9.0f, nearPlane, farPlane)
+                   * Matrix_Camera_View(glm::vec4(position, 1.0f), glm::vec4(target - position, 0.0f),
+                                        glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    return {ViewFrustum::fromMatrix(clip), position};
+}
+
+bool isBehind(const glm::vec4& plane, const glm::vec3& p) {
+    return glm::dot(glm::vec3(plane), p) + plane.w < 0.0f;
+}
+
+// Per triangle tests: facing away from the camera, or entirely behind one
+// plane of the frustum
+bool isFacingAway(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& camera) {
+    return glm::dot(glm::cross(b - a, c - a), a - camera) >= 0.0f;
+}
+
+bool isOutside(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const ViewFrustum& frustum) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (isBehind(plane, a) && isBehind(plane, b) && isBehind(plane, c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int runMeshletBenchmark() {
+    const size_t numFrames = 4096;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    buildTorus(128, 96, vertices, indices);
+    OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    size_t numTriangles = indices.size() / 3;
+
+    auto start = Clock::now();
+    std::vector<Meshlet> meshlets = BuildMeshlets(vertices.data(), vertices.size(), indices.data(), indices.size());
+    double buildTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    size_t numMeshletVertices = 0;
+    std::vector<uint32_t> seen(vertices.size(), UINT32_MAX);
+    for (size_t m = 0; m < meshlets.size(); ++m) {
+        for (uint32_t i = 0; i < meshlets[m].numIndices; ++i) {
+            uint32_t v = indices[meshlets[m].firstIndex + i];
+            numMeshletVertices += seen[v] != m ? 1 : 0;
+            seen[v] = static_cast<uint32_t>(m);
+        }
+    }
+    printf("%zu triangles in %zu meshlets (%.1f vertices, %.1f triangles each), built in %.1f ms\n",
+           numTriangles, meshlets.size(), double(numMeshletVertices) / meshlets.size(),
+           double(numTriangles) / meshlets.size(), buildTime);
+
+    std::mt19937 rng(42);
+    std::vector<Camera> cameras;
+    for (size_t i = 0; i < numFrames; ++i) {
+        cameras.push_back(makeCamera(rng));
+    }
+
+    std::vector<uint32_t> visible;
+    size_t numCulled = 0;
+    start = Clock::now();
+    for (const Camera& camera : cameras) {
+        visible.clear();
+        numCulled += CullMeshlets(meshlets.data(), meshlets.size(), camera.frustum, camera.position, visible);
+    }
+    double cullTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / numFrames;
+
+    // The same frames, triangle by triangle
+    size_t numCulledPerTriangle = 0;
+    for (const Camera& camera : cameras) {
+        for (const Meshlet& meshlet : meshlets) {
+            bool culled = !IsMeshletVisible(meshlet, camera.frustum, camera.position);
+            for (uint32_t i = 0; i < meshlet.numIndices; i += 3) {
+                glm::vec3 a = position(vertices[indices[meshlet.firstIndex + i]]);
+                glm::vec3 b = position(vertices[indices[meshlet.firstIndex + i + 1]]);
+                glm::vec3 c = position(vertices[indices[meshlet.firstIndex + i + 2]]);
+                bool hidden = isFacingAway(a, b, c, camera.position) || isOutside(a, b, c, camera.frustum);
+                numCulledPerTriangle += hidden ? 1 : 0;
+                if (culled && !hidden) {
+                    fprintf(stderr, "ERROR: a culled meshlet holds a visible triangle.\n");
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+
+    printf("%12s %14s %20s\n", "cull (us)", "culled", "culled per triangle");
+    printf("%12.2f %13.1f%% %19.1f%%\n", cullTime, 100.0 * numCulled / (numFrames * numTriangles),
+           100.0 * numCulledPerTriangle / (numFrames * numTriangles));
+    return EXIT_SUCCESS;
+}
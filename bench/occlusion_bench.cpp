@@ -0,0 +1,190 @@
+// Benchmark of the software occlusion culling.
+//
+// Draws walls, boxes 12 triangles each spread over a floor like the maze,
+// into an OcclusionBuffer from cameras placed and turned at random, then
+// tests small boxes against it. Compares the SIMD rasterizer with the
+// scalar one (which must draw exactly the same depths) for a growing number
+// of occluders.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "graphics/occlusion.h"
+#include "utils/math_utils.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+// Same projection as the game
+const float nearPlane = -0.1f;
+const float farPlane = -100.0f;
+const float fieldOfView = 3.14159265f / 3.0f;
+
+const float floorExtent = 200.0f;
+
+struct Box {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// The 8 corners and 12 triangles of a box
+void appendBox(const Box& box, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+    static const uint32_t faces[36] = {
+        0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,  0, 4, 5, 0, 5, 1,
+        2, 3, 7, 2, 7, 6,  0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3
+    };
+    uint32_t base = static_cast<uint32_t>(positions.size());
+    for (int i = 0; i < 8; ++i) {
+        positions.push_back(glm::vec3((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                                      (i & 4) ? box.max.z : box.min.z));
+    }
+    for (uint32_t index : faces) {
+        indices.push_back(base + index);
+    }
+}
+
+// A wall along x or z, as tall as the maze walls
+Box makeWall(std::mt19937& rng) {
+    std::uniform_real_distribution<float> position(0.0f, floorExtent);
+    std::uniform_real_distribution<float> length(6.0f, 24.0f);
+    glm::vec3 start(position(rng), 0.0f, position(rng));
+    glm::vec3 size = rng() % 2 ? glm::vec3(length(rng), 13.0f, 1.0f) : glm::vec3(1.0f, 13.0f, length(rng));
+    return {start, start + size};
+}
+
+glm::mat4 makeCamera(std::mt19937& rng) {
+    std::uniform_real_distribution<float> position(0.0f, floorExtent);
+    std::uniform_real_distribution<float> yaw(0.0f, 6.2831853f);
+
+    float angle = yaw(rng);
+    glm::vec4 camera(position(rng), 2.0f, position(rng), 1.0f);
+    glm::vec4 view(std::sin(angle), 0.0f, std::cos(angle), 0.0f);
+    return Matrix_Perspective(fieldOfView, 16.0f / 9.0f, nearPlane, farPlane)
+         * Matrix_Camera_View(camera, view, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+double microsecondsPerFrame(Clock::time_point start, Clock::time_point end, size_t numFrames) {
+    return std::chrono::duration<double, std::micro>(end - start).count() / numFrames;
+}
+
+} // namespace
+
+int runOcclusionBenchmark() {
+    const size_t occluderCounts[] = {16, 64, 256, 1024};
+    const size_t numOccludees = 4096;
+    const size_t numFrames = 64;
+
+    std::mt19937 rng(42);
+
+    printf("SIMD path: %s, %dx%d depth buffer, %zu boxes tested per frame\n", OcclusionBuffer::simdPath(),
+           OcclusionBuffer::width, OcclusionBuffer::height, numOccludees);
+    printf("%10s %10s %12s %12s %12s %12s %10s\n", "occluders", "triangles", "scalar (us)", "simd (us)",
+           "levels (us)", "test (us)", "occluded");
+
+    std::vector<Box> occludees;
+    std::uniform_real_distribution<float> position(0.0f, floorExtent);
+    std::uniform_real_distribution<float> size(0.2f, 1.5f);
+    for (size_t i = 0; i < numOccludees; ++i) {
+        glm::vec3 center(position(rng), size(rng), position(rng));
+        glm::vec3 halfSize(size(rng), size(rng), size(rng));
+        occludees.push_back({center - halfSize, center + halfSize});
+    }
+
+    for (size_t numOccluders : occluderCounts) {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        for (size_t i = 0; i < numOccluders; ++i) {
+            appendBox(makeWall(rng), positions, indices);
+        }
+        std::vector<glm::mat4> cameras;
+        for (size_t i = 0; i < numFrames; ++i) {
+            cameras.push_back(makeCamera(rng));
+        }
+
+        OcclusionBuffer buffer;
+        std::vector<std::vector<float>> scalarDepths;
+        auto start = Clock::now();
+        for (const glm::mat4& camera : cameras) {
+            buffer.clear(camera);
+            buffer.drawTrianglesScalar(positions.data(), positions.size(), indices.data(), indices.size());
+            scalarDepths.push_back(buffer.getDepths());
+        }
+        double scalarTime = microsecondsPerFrame(start, Clock::now(), numFrames);
+
+        double simdTime = 0.0;
+        double levelsTime = 0.0;
+        double testTime = 0.0;
+        size_t numTriangles = 0;
+        size_t numOccluded = 0;
+        for (size_t frame = 0; frame < numFrames; ++frame) {
+            start = Clock::now();
+            buffer.clear(cameras[frame]);
+            buffer.drawTriangles(positions.data(), positions.size(), indices.data(), indices.size());
+            auto drawn = Clock::now();
+            buffer.buildHierarchy();
+            auto built = Clock::now();
+            for (const Box& box : occludees) {
+                numOccluded += buffer.isVisible(box.min, box.max) ? 0 : 1;
+            }
+            auto tested = Clock::now();
+
+            simdTime += microsecondsPerFrame(start, drawn, numFrames);
+            levelsTime += microsecondsPerFrame(drawn, built, numFrames);
+            testTime += microsecondsPerFrame(built, tested, numFrames);
+            numTriangles += buffer.getNumTrianglesDrawn();
+
+            if (buffer.getDepths() != scalarDepths[frame]) {
+                fprintf(stderr, "ERROR: SIMD and scalar rasterizers disagree.\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        printf("%10zu %10zu %12.1f %12.1f %12.1f %12.1f %9.1f%%\n", numOccluders, numTriangles / numFrames,
+               scalarTime, simdTime, levelsTime, testTime, 100.0 * numOccluded / (numFrames * numOccludees));
+    }
+
+    // An OcclusionCuller draws the occluders in the view frustum on its
+    // worker thread, which must give the answers of a buffer drawing them all
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    OcclusionCuller culler;
+    for (size_t i = 0; i < 256; ++i) {
+        std::vector<glm::vec3> wallPositions;
+        std::vector<uint32_t> wallIndices;
+        appendBox(makeWall(rng), wallPositions, wallIndices);
+        culler.addOccluder(wallPositions, wallIndices);
+        for (uint32_t& index : wallIndices) {
+            index += static_cast<uint32_t>(positions.size());
+        }
+        positions.insert(positions.end(), wallPositions.begin(), wallPositions.end());
+        indices.insert(indices.end(), wallIndices.begin(), wallIndices.end());
+    }
+    glm::mat4 camera = makeCamera(rng);
+    culler.beginFrame(camera);
+    OcclusionBuffer buffer;
+    buffer.clear(camera);
+    buffer.drawTriangles(positions.data(), positions.size(), indices.data(), indices.size());
+    buffer.buildHierarchy();
+    culler.endFrame();
+
+    size_t numOccluded = 0;
+    for (const Box& box : occludees) {
+        bool visible = culler.isVisible(AABB(glm::vec4(box.min, 1.0f), glm::vec4(box.max, 1.0f)));
+        if (visible != buffer.isVisible(box.min, box.max)) {
+            fprintf(stderr, "ERROR: the worker thread and the buffer disagree.\n");
+            return EXIT_FAILURE;
+        }
+        numOccluded += visible ? 0 : 1;
+    }
+    printf("Worker thread: %zu of %zu occluders drawn in %.1f us, %zu boxes occluded\n",
+           culler.getNumOccludersDrawn(), culler.getNumOccluders(), culler.getFrameTime() * 1e6, numOccluded);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// Benchmark of the sweep-and-prune broadphase used by resolveCollisions().
+//
+// Moves from 100 to 100k boxes with a small random walk every frame and
+// measures the cost of finding the overlapping pairs, compared with the old
+// nested loop over every pair (only run while it takes reasonable time).
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "physics/bounding.h"
+#include "physics/sweep_and_prune.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int runSweepAndPruneBenchmark() {
+    const size_t sizes[] = {100, 1000, 10000, 100000};
+    const int numFrames = 30;
+    const size_t maxBruteForceBoxes = 10000;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+
+    printf("%10s %14s %14s %14s %14s %12s\n",
+           "boxes", "first (ms)", "frame (ms)", "swaps/frame", "n^2 (ms)", "pairs");
+
+    for (size_t numBoxes : sizes) {
+        // Unit boxes with a density of about one box per 8 units^3 of a flat
+        // world, similar to a herd spread over the maze floor
+        float side = std::sqrt(static_cast<float>(numBoxes)) * 3.0f;
+        std::uniform_real_distribution<float> position(0.0f, side);
+        std::vector<AABB> boxes;
+        boxes.reserve(numBoxes);
+        for (size_t i = 0; i < numBoxes; ++i) {
+            glm::vec4 center(position(rng), 0.5f, position(rng), 1.0f);
+            boxes.emplace_back(center - glm::vec4(0.5f, 0.5f, 0.5f, 0.0f),
+                               center + glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
+        }
+
+        SweepAndPrune sweepAndPrune;
+        sweepAndPrune.resize(numBoxes);
+        for (size_t i = 0; i < numBoxes; ++i) {
+            sweepAndPrune.setBox(i, boxes[i]);
+        }
+        auto start = Clock::now();
+        sweepAndPrune.findPairs();
+        double firstFrame = millisecondsSince(start);
+
+        double totalFrames = 0.0;
+        size_t totalSwaps = 0;
+        size_t numPairs = 0;
+        for (int frame = 0; frame < numFrames; ++frame) {
+            for (AABB& box : boxes) {
+                box.move(glm::vec4(step(rng), 0.0f, step(rng), 0.0f));
+            }
+
+            start = Clock::now();
+            for (size_t i = 0; i < numBoxes; ++i) {
+                sweepAndPrune.setBox(i, boxes[i]);
+            }
+            numPairs = sweepAndPrune.findPairs().size();
+            totalFrames += millisecondsSince(start);
+            totalSwaps += sweepAndPrune.getLastSwapCount();
+        }
+
+        if (numBoxes <= maxBruteForceBoxes) {
+            start = Clock::now();
+            size_t bruteForcePairs = 0;
+            for (size_t i = 0; i < numBoxes; ++i) {
+                for (size_t j = i + 1; j < numBoxes; ++j) {
+                    bruteForcePairs += boxes[i].intersects(boxes[j]) ? 1 : 0;
+                }
+            }
+            double bruteForce = millisecondsSince(start);
+
+            if (bruteForcePairs != numPairs) {
+                fprintf(stderr, "ERROR: sweep and prune found %zu pairs, nested loop found %zu.\n",
+                        numPairs, bruteForcePairs);
+                return EXIT_FAILURE;
+            }
+            printf("%10zu %14.3f %14.3f %14zu %14.3f %12zu\n", numBoxes, firstFrame,
+                   totalFrames / numFrames, totalSwaps / numFrames, bruteForce, numPairs);
+        } else {
+            printf("%10zu %14.3f %14.3f %14zu %14s %12zu\n", numBoxes, firstFrame,
+                   totalFrames / numFrames, totalSwaps / numFrames, "-", numPairs);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+// Benchmark of the SoA collision world and its batch kernels.
+//
+// Tests box and sphere queries against many boxes and spheres, comparing the
+// SIMD kernels with the scalar kernel (which must return exactly the same
+// bits) and with the same tests done one AABB/BSphere object at a time.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "physics/bounding.h"
+#include "physics/collision_world.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+struct Volume {
+    AABB aabb;
+    BSphere bsphere;
+    bool useSphere;
+};
+
+// Same branch on the kind of each volume as GameObject::intersects
+bool intersects(const Volume& a, const Volume& b) {
+    if (a.useSphere && b.useSphere) {
+        return a.bsphere.intersects(b.bsphere);
+    } else if (a.useSphere) {
+        return a.bsphere.intersects(b.aabb);
+    } else if (b.useSphere) {
+        return a.aabb.intersects(b.bsphere);
+    }
+    return a.aabb.intersects(b.aabb);
+}
+
+// Random boxes and spheres (one in four) spread over a square of side 'extent'
+Volume makeVolume(std::mt19937& rng, float extent) {
+    std::uniform_real_distribution<float> position(0.0f, extent);
+    std::uniform_real_distribution<float> size(0.2f, 2.0f);
+    std::uniform_int_distribution<int> kind(0, 3);
+
+    glm::vec4 center(position(rng), size(rng), position(rng), 1.0f);
+    glm::vec4 halfSize(size(rng), size(rng), size(rng), 0.0f);
+    AABB aabb(center - halfSize, center + halfSize);
+    return {aabb, BSphere(aabb), kind(rng) == 0};
+}
+
+CollisionQuery toQuery(const Volume& volume) {
+    return volume.useSphere ? CollisionQuery::sphere(volume.bsphere) : CollisionQuery::box(volume.aabb);
+}
+
+double nanosecondsPerQuery(Clock::time_point start, Clock::time_point end, size_t numQueries) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / numQueries;
+}
+
+} // namespace
+
+int runSoaBenchmark() {
+    const size_t sizes[] = {128, 1024, 16384, 131072};
+
+    std::mt19937 rng(42);
+
+    printf("SIMD path: %s, batch of %zu objects\n", CollisionWorld::simdPath(), CollisionWorld::batchSize);
+    printf("%10s %10s %14s %14s %14s %10s\n",
+           "objects", "queries", "objects (ns)", "scalar (ns)", "simd (ns)", "hits");
+
+    for (size_t numObjects : sizes) {
+        const size_t numQueries = std::max<size_t>(16, (1u << 22) / numObjects);
+        const float extent = 4.0f * std::sqrt(static_cast<float>(numObjects));
+
+        std::vector<Volume> objects;
+        CollisionWorld world;
+        for (size_t i = 0; i < numObjects; ++i) {
+            objects.push_back(makeVolume(rng, extent));
+            world.add(objects.back().aabb, objects.back().bsphere, objects.back().useSphere);
+        }
+        std::vector<Volume> queries;
+        for (size_t i = 0; i < numQueries; ++i) {
+            queries.push_back(makeVolume(rng, extent));
+        }
+
+        size_t objectHits = 0;
+        size_t objectSphereHits = 0; // Sphere-sphere hits, which the world tests without sqrt
+        auto start = Clock::now();
+        for (const Volume& query : queries) {
+            for (const Volume& object : objects) {
+                bool hit = intersects(query, object);
+                objectHits += hit;
+                objectSphereHits += hit & query.useSphere & object.useSphere;
+            }
+        }
+        double objectTime = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        const size_t numBatches = (numObjects + CollisionWorld::batchSize - 1) / CollisionWorld::batchSize;
+        std::vector<uint32_t> scalarMasks;
+        scalarMasks.reserve(numQueries * numBatches);
+        start = Clock::now();
+        for (const Volume& query : queries) {
+            CollisionQuery q = toQuery(query);
+            for (size_t first = 0; first < numObjects; first += CollisionWorld::batchSize) {
+                scalarMasks.push_back(world.testRangeScalar(q, first, numObjects - first));
+            }
+        }
+        double scalarTime = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        std::vector<uint32_t> simdMasks;
+        simdMasks.reserve(numQueries * numBatches);
+        start = Clock::now();
+        for (const Volume& query : queries) {
+            CollisionQuery q = toQuery(query);
+            for (size_t first = 0; first < numObjects; first += CollisionWorld::batchSize) {
+                simdMasks.push_back(world.testRange(q, first, numObjects - first));
+            }
+        }
+        double simdTime = nanosecondsPerQuery(start, Clock::now(), numQueries);
+
+        if (simdMasks != scalarMasks) {
+            fprintf(stderr, "ERROR: SIMD and scalar kernels disagree.\n");
+            return EXIT_FAILURE;
+        }
+
+        size_t simdHits = 0;
+        size_t simdSphereHits = 0;
+        size_t maskIndex = 0;
+        for (const Volume& query : queries) {
+            for (size_t first = 0; first < numObjects; first += CollisionWorld::batchSize) {
+                uint32_t mask = simdMasks[maskIndex++];
+                while (mask) {
+                    size_t index = first + CollisionWorld::lowestBit(mask);
+                    mask &= mask - 1;
+                    ++simdHits;
+                    simdSphereHits += query.useSphere & objects[index].useSphere;
+                }
+            }
+        }
+        // Box-box and box-sphere hits must match exactly
+        if (simdHits - simdSphereHits != objectHits - objectSphereHits) {
+            fprintf(stderr, "ERROR: collision world and object tests disagree (%zu/%zu hits).\n",
+                    simdHits - simdSphereHits, objectHits - objectSphereHits);
+            return EXIT_FAILURE;
+        }
+
+        printf("%10zu %10zu %14.1f %14.1f %14.1f %10zu\n",
+               numObjects, numQueries, objectTime, scalarTime, simdTime, simdHits);
+    }
+
+    return EXIT_SUCCESS;
+}
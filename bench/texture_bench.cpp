@@ -0,0 +1,121 @@
+// Benchmark of the texture cooker.
+//
+// Builds the mip chain of a procedural 1024x1024 image (gradients, stripes
+// and noise, closer to a photo than to the flat maze blocks) and compresses
+// every level to BC1, on one thread and on every thread. Checks that both
+// give the same bytes and that the decoded base level stays close to the
+// image.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "graphics/texture_cooker.h"
+#include "utils/thread_pool.h"
+
+#include "benchmarks.h"
+
+namespace {
+
+using Clock = BenchClock;
+
+const uint32_t imageSize = 1024;
+
+// Below this, the blocks are visibly wrong rather than just lossy
+const double minPsnr = 30.0;
+
+TextureLevel buildImage() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    TextureLevel image;
+    image.width = imageSize;
+    image.height = imageSize;
+    image.texels.resize(size_t(imageSize) * imageSize * 4);
+    for (uint32_t y = 0; y < imageSize; ++y) {
+        for (uint32_t x = 0; x < imageSize; ++x) {
+            float u = float(x) / imageSize;
+            float v = float(y) / imageSize;
+            float stripes = 0.5f + 0.5f * std::sin(40.0f * (u + 0.3f * v));
+            int rgb[3] = {
+                int(255.0f * u),
+                int(255.0f * (0.3f + 0.5f * stripes * v)),
+                int(255.0f * (1.0f - u) * (1.0f - v)),
+            };
+            uint8_t* texel = &image.texels[(size_t(y) * imageSize + x) * 4];
+            for (int c = 0; c < 3; ++c) {
+                texel[c] = static_cast<uint8_t>(std::min(std::max(rgb[c] + noise(rng), 0), 255));
+            }
+            texel[3] = 255;
+        }
+    }
+    return image;
+}
+
+struct CookResult {
+    double mipTime;     // ms
+    double encodeTime;
+    std::vector<uint8_t> blocks;
+};
+
+CookResult cook(const TextureLevel& image, ThreadPool* pool) {
+    CookResult result;
+    auto start = Clock::now();
+    std::vector<TextureLevel> levels = GenerateMipChain(image, pool);
+    result.mipTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    size_t size = 0;
+    for (const TextureLevel& level : levels) {
+        size += BC1LevelSize(level.width, level.height);
+    }
+    result.blocks.resize(size);
+
+    start = Clock::now();
+    size_t offset = 0;
+    for (const TextureLevel& level : levels) {
+        EncodeBC1(level, result.blocks.data() + offset, pool);
+        offset += BC1LevelSize(level.width, level.height);
+    }
+    result.encodeTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return result;
+}
+
+} // namespace
+
+int runTextureBenchmark() {
+    TextureLevel image = buildImage();
+    printf("%ux%u image, %u levels\n", imageSize, imageSize, MipLevelCount(imageSize, imageSize));
+
+    ThreadPool pool;
+    CookResult serial = cook(image, nullptr);
+    CookResult parallel = cook(image, &pool);
+    if (serial.blocks != parallel.blocks) {
+        fprintf(stderr, "ERROR: the blocks depend on the number of threads.\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> decoded(image.texels.size());
+    DecodeBC1(serial.blocks.data(), imageSize, imageSize, decoded.data());
+    double squaredError = 0.0;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (i % 4 != 3) {
+            double error = double(decoded[i]) - double(image.texels[i]);
+            squaredError += error * error;
+        }
+    }
+    double psnr = 10.0 * std::log10(255.0 * 255.0 / (squaredError / (size_t(imageSize) * imageSize * 3)));
+
+    printf("%8s %12s %12s\n", "threads", "mips (ms)", "BC1 (ms)");
+    printf("%8u %12.1f %12.1f\n", 1u, serial.mipTime, serial.encodeTime);
+    printf("%8u %12.1f %12.1f\n", pool.size(), parallel.mipTime, parallel.encodeTime);
+    printf("BC1 base level: %.2f dB PSNR, %zu bytes for the chain (%.1f%% of RGBA8)\n", psnr,
+           serial.blocks.size(), 100.0 * serial.blocks.size() / (image.texels.size() * 4.0 / 3.0));
+
+    if (psnr < minPsnr) {
+        fprintf(stderr, "ERROR: BC1 PSNR %.2f dB below %.1f dB.\n", psnr, minPsnr);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
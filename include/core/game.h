@@ -19,17 +19,39 @@
 
 #include "utils/math_utils.h"
 #include "core/gameobject.h"
+#include "core/virtual_scene.h"
 #include "graphics/objmodel.h"
 #include "graphics/renderer.h"
 #include "graphics/shaders.h"
 #include "graphics/textures.h"
 #include "graphics/core.h"
+#include "graphics/uniforms.h"
+#include "graphics/render_queue.h"
+#include "graphics/static_batch.h"
+#include "graphics/instanced_mesh.h"
+#include "graphics/frustum.h"
+#include "graphics/pvs.h"
+#include "graphics/occlusion.h"
 #include "physics/bounding.h"
 #include "physics/collisions.h"
+#include "core/simulation.h"
+#include "core/input_log.h"
 #include "utils/file_utils.h"
 
 class Game {
 public:
+    /* Objects drawn and culled by the view frustum in the last frame. A
+     * chest counts as two objects, its base and its lid. Objects inside the
+     * frustum but not visible from the camera cell (maze pieces only) or
+     * behind the occluders are counted apart. */
+    struct CullingStats {
+        size_t drawn = 0;
+        size_t culled = 0;
+        size_t hidden = 0;   // By the PVS
+        size_t occluded = 0; // By the occlusion buffer
+        size_t trianglesCulled = 0; // Of the meshlets of the cow
+    };
+
     Game(Game const&) = delete;
     Game& operator=(Game const&) = delete;
 
@@ -40,6 +62,12 @@ public:
 
     void run();
 
+    // Write the input events of this session to 'path'
+    void recordInput(const std::string& path);
+    // Play the input events of a recorded session instead of the live input,
+    // simulating and drawing exactly the frames that were recorded
+    void replayInput(const std::string& path);
+
     void createWindow(const std::string& title, int width, int height);
     virtual void keyCallback(int key, int scancode, int actions, int mods);
     virtual void mouseButtonCallback(int button, int action, int mods);
@@ -51,16 +79,25 @@ public:
     void renderGameOver(GLFWwindow* window) const;
     void renderVictory(GLFWwindow* window) const;
 
+    // Matrices of the frame, uploaded by renderScene() with the frame data
     void setCameraView();
     void setProjection();
 
-    void createModel(const std::string& objFilePath, glm::mat4 model);
+    // Upload the mesh of an OBJ file and add its objects to the scene
+    void createModel(const std::string& objFilePath, const glm::mat4& model, const Mesh& mesh);
 
     void drawCow(glm::mat4 model);
     void drawPlane(glm::mat4 model);
+    // Frustum (and PVS) culling, which does not need the occlusion buffer
+    // and runs while the occlusion worker draws it
+    void cullMaze(const ViewFrustum& frustum);
+    void cullChests(const ViewFrustum& frustum);
+    // Occlusion culling of what the above kept, then the draw calls
     void drawMaze(glm::mat4 model);
-    void drawChestBase(glm::mat4 model, int chestIndex);
-    void drawChestLid(glm::mat4 model, int chestIndex);
+    void drawChests(const SimulationState& state);
+
+    const CullingStats& getCullingStats() const { return cullingStats; }
+    void renderCullingStats(GLFWwindow* window) const;
 
     ~Game();
 
@@ -87,50 +124,59 @@ private:
     const GLFWvidmode* videoMode;
 
     VirtualScene virtualScene;
-
-    const int maxLife = 5;
-    int playerLife = maxLife;
-    float timeStarving = 0.0f;
-    const float starvationLimit = 90.0f;
+    StaticBatch mazeBatch; // Every maze piece, drawn with a single call
+    InstancedMesh chestBases; // One instance per visible chest
+    InstancedMesh chestLids;
+
+    // Boxes tested against the view frustum every frame: the maze pieces (in
+    // the order of mazeBatch.getPieces()) and the chests, base and lid
+    // together, whose GameObjects are kept to follow the lids
+    FrustumCuller mazeCuller;
+    FrustumCuller chestCuller;
+    std::vector<ObjectHandle> chestBaseObjects;
+    std::vector<ObjectHandle> chestLidObjects;
+    ObjectHandle cowObject;   // Found once the scene is loaded
+    ObjectHandle planeObject;
+    std::vector<uint32_t> visibleMazePieces; // Set by cullMaze(), trimmed by drawMaze()
+    std::vector<uint32_t> visibleChests; // Set by cullChests(), trimmed by drawChests()
+    std::vector<uint32_t> visibleMeshlets; // Of the cow, reused by drawCow()
+    PotentiallyVisibleSet mazePvs; // Maze pieces visible from each cell of the floor
+    // The largest maze pieces, drawn on the CPU each frame to test the
+    // objects that the frustum and the PVS keep
+    OcclusionCuller occlusionCuller;
+    bool occlusionCulling = true; // F4
+    const float minOccluderSize = 10.0f; // Horizontal size of a piece to be an occluder
+    std::vector<AABB> chestBounds; // Base and lid together, updated by cullChests()
+    AABB cowModelBounds; // In model space, placed by Simulation::getCowModel()
+    int cowLod = 0; // Level of detail of the cow, chosen by drawCow() from its size on screen
+    AABB planeBounds;
+    CullingStats cullingStats;
+    bool showCullingStats = false; // F3
+
+    Simulation simulation;
+    SimulationInput input;  // Updated by the callbacks, read by each tick
+    // Longest time simulated in a single frame, so that a long frame does
+    // not make the following ones even longer
+    const double maxFrameTime = 0.25;
+
+    InputRecorder inputRecorder;
+    InputReplay inputReplay;
 
     int windowWidth, windowHeight;
     int windowX, windowY;
     int screenWidth, screenHeight;
     float windowRatio;
     float screenRatio;
+    int framebufferHeight = 1;
     bool fullScreen = false;
 
-    bool lookAtMode = false;
-    const float distanceCameraCowThreshold = 20.0f;
-    glm::vec4 cowPosition = glm::vec4(0.0f, 1.2f, -90.0f, 1.0f);
-    float distanceCameraCow = 0.0f;
-
-    bool gameOver = false;
-    bool victory = false;
-
-    const std::vector<glm::vec3> chestCoordinates = {
-        glm::vec3(29.390f, 1.0f, -39.671f),
-        glm::vec3(-54.558f, 1.0f, 77.954f),
-        glm::vec3(64.719f, 1.0f, -75.398f),
-        glm::vec3(-9.232f, 1.0f, 53.063f)
-    };
-    std::vector<bool> chestOpened = {false, false, false, false};
-    std::vector<float> chestLidRotation = {0.0f, 0.0f, 0.0f, 0.0f};
-    const int numChests = 4;
-
-    const glm::vec4 initialCameraPosition1 = glm::vec4(4.0f, 2.0f, -30.0f, 1.0f);
-    const glm::vec4 initialCameraPosition2 = glm::vec4(84.81f, 2.0f, -76.62f, 1.0f);
-    const glm::vec4 initialCameraLookAt = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-
-    glm::vec4 cameraPosition = initialCameraPosition2;
-    glm::vec4 cameraLookAt = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-    glm::vec4 cameraView = cameraLookAt - cameraPosition;
+    // Camera of the frame being rendered, placed at the interpolated player position
+    glm::vec4 cameraPosition = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec4 cameraView = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
     glm::vec4 cameraUp = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
     glm::vec4 cameraRight = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
-
-    const float baseSpeed = 100.0f;
-    const float speedMultiplier = 1.75f;
-    float currentSpeed = baseSpeed;
+    glm::mat4 viewMatrix = glm::mat4(1.0f);       // Set by setCameraView()
+    glm::mat4 projectionMatrix = glm::mat4(1.0f); // Set by setProjection()
 
     float cameraYaw = 0.0f;
     float cameraPitch = 0.0f;
@@ -144,29 +190,50 @@ private:
     const float farPlane = -100.0f;
     const float fov = M_PI / 3.0f;
 
-    float deltaTime = 0.0f;
-
     GLuint gpuProgramId = 0;
     GLuint numLoadedTextures = 0;
-    UniformMap uniforms = {};
+    UniformTable uniforms = {};
+    UniformBuffers uniformBuffers; // Frame data set by renderScene(), draw data by the render queue
+    RenderQueue renderQueue; // Filled by the draw functions, flushed by renderScene()
 
     unsigned int backgroundTextureID;
 
     void printVirtualScene() {
-        for (auto& obj : virtualScene) {
-            std::cout << obj.first << std::endl;
+        for (size_t i = 0; i < virtualScene.size(); ++i) {
+            std::cout << virtualScene.getName(i) << std::endl;
         }
     }
 
     void gameLoop();
 
+    // Entry point of the GLFW callbacks: record the event, or drop it while
+    // a replay is running, then handle it
+    void receiveInput(InputEvent event);
+    // Call the callback of an input event
+    void dispatchInput(const InputEvent& event);
+    // Simulate the ticks of the next recorded frame, applying its input
+    // events. Returns false at the end of the log.
+    bool replayFrame(float& alpha);
+    // Print the final state, to compare a session with its replay
+    void printInputSessionSummary() const;
+
+    // Place the camera for a frame showing 'state'
+    void updateCamera(const SimulationState& state);
+    // Draw the scene as given by 'state' (interpolated between two ticks)
+    void renderScene(const SimulationState& state);
+    // True when occlusion culling is on and the box is behind the occluders
+    // of the frame. The first call of a frame waits for the occlusion worker.
+    bool isOccluded(const AABB& aabb) {
+        return occlusionCulling && !occlusionCuller.isVisible(aabb);
+    }
+
     static void keyCallback(
         GLFWwindow* window, 
         int key, int scancode,
         int actions, int mods
     ) {
         Game* obj = static_cast<Game*>(glfwGetWindowUserPointer(window));
-        obj->keyCallback(key, scancode, actions, mods);
+        obj->receiveInput({InputEvent::Key, 0, key, actions, mods});
     }
 
     static void mouseButtonCallback(
@@ -174,7 +241,7 @@ private:
         int action, int mods
     ) {
         Game* obj = static_cast<Game*>(glfwGetWindowUserPointer(window));
-        obj->mouseButtonCallback(button, action, mods);
+        obj->receiveInput({InputEvent::MouseButton, 0, button, action, mods});
     }
 
     static void cursorPosCallback(
@@ -182,7 +249,7 @@ private:
         double xpos, double ypos
     ) {
         Game* obj = static_cast<Game*>(glfwGetWindowUserPointer(window));
-        obj->cursorPosCallback(xpos, ypos);
+        obj->receiveInput({InputEvent::Cursor, 0, 0, 0, 0, xpos, ypos});
     }
 
     static void framebufferSizeCallback(
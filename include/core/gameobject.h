@@ -2,8 +2,10 @@
 #define GAMEOBJECT_H
 
 #include <vector>
+#include <cstdint>
 #include <ctime>
 #include <map>
+#include <utility>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -17,77 +19,116 @@
 
 #include "utils/math_utils.h"
 #include "graphics/objmodel.h"
+#include "graphics/mesh.h"
+#include "graphics/vertex_format.h"
 #include "physics/bounding.h"
+#include "physics/dynamic_tree.h"
+
+/* Simplified version of a scene object: its range of the index buffer and
+ * its error in model space units (see MeshLod) */
+struct SceneObjectLod {
+    size_t baseIndex;
+    size_t numIndices;
+    float error;
+};
 
 /* Data structure that represents a virtual object in the scene */
 struct SceneObject {
     SceneObject() 
         : name(""), baseIndex(0), numIndices(0), renderingMode(GL_TRIANGLES), 
-          vertexArrayObjectId(0) {}
+          vertexArrayObjectId(0), indexType(GL_UNSIGNED_INT) {}
 
     std::string name;
     size_t baseIndex;
     size_t numIndices;
     GLenum renderingMode;
     GLuint vertexArrayObjectId;
+    GLenum indexType;                 // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    VertexQuantization quantization;  // Of the positions in the vertex buffer
+    std::vector<SceneObjectLod> lods; // Coarser and coarser, after the full object
+    std::vector<Meshlet> meshlets;    // Covering the full object, in its index buffer
 };
 
 /* Class representing an object in the game scene */
 class GameObject {
 public:
     GameObject()
-        : lastMoveTime(0.0), lastMove(0.0), useBSphere(false) {}
+        : lastMoveTime(0), lastMove(0.0), useBSphere(false) {}
 
     GameObject(const AABB& aabb, bool useBSphere=false)
-        : aabb(aabb), lastMoveTime(0.0), lastMove(0.0), 
+        : aabb(aabb), lastMoveTime(0), lastMove(0.0), 
           bsphere(aabb), useBSphere(useBSphere) {}
 
     GameObject(const AABB& aabb, const BSphere& bsphere, bool useBSphere=false)
-        : aabb(aabb), lastMoveTime(0.0), lastMove(0.0), 
+        : aabb(aabb), lastMoveTime(0), lastMove(0.0), 
           bsphere(bsphere), useBSphere(useBSphere) {}
 
     GameObject(const std::vector<glm::vec4>& vertices, bool useBSphere=false)
-        : aabb(vertices), lastMoveTime(0.0), lastMove(0.0), 
+        : aabb(vertices), lastMoveTime(0), lastMove(0.0), 
           bsphere(vertices), useBSphere(useBSphere) {}
 
     GameObject(const ObjModel& model, bool useBSphere=false)
-        : aabb(model), lastMoveTime(0.0), lastMove(0.0), 
+        : aabb(model), lastMoveTime(0), lastMove(0.0), 
           bsphere(model), useBSphere(useBSphere) {}
 
     GameObject(const ObjModel& model, const glm::mat4& transformation, bool useBSphere=false)
-        : aabb(model, transformation), lastMoveTime(0.0), lastMove(0.0), 
+        : aabb(model, transformation), lastMoveTime(0), lastMove(0.0), 
           bsphere(model, transformation), useBSphere(useBSphere) {}
 
     GameObject(const ObjModel& model, const SceneObject& sceneObject, bool useBSphere=false)
-        : aabb(model), lastMoveTime(0.0), lastMove(0.0), sceneObject(sceneObject), 
+        : aabb(model), lastMoveTime(0), lastMove(0.0), sceneObject(sceneObject), 
           bsphere(model), useBSphere(useBSphere) {}
 
     GameObject(const ObjModel& model, const SceneObject& sceneObject, 
                const glm::mat4& transformation, bool useBSphere=false)
-        : aabb(model, transformation), lastMoveTime(0.0), lastMove(0.0), sceneObject(sceneObject), 
+        : aabb(model, transformation), lastMoveTime(0), lastMove(0.0), sceneObject(sceneObject), 
           bsphere(model), useBSphere(useBSphere) {}
 
+    GameObject(const AABB& aabb, const BSphere& bsphere, const SceneObject& sceneObject, 
+               bool useBSphere=false)
+        : aabb(aabb), lastMoveTime(0), lastMove(0.0), sceneObject(sceneObject), 
+          bsphere(bsphere), useBSphere(useBSphere) {}
+
+    // Copies never share the dynamic tree proxy of the original object
     GameObject(const GameObject& other)
         : aabb(other.aabb), lastMoveTime(other.lastMoveTime), 
           lastMove(other.lastMove), sceneObject(other.sceneObject), 
           bsphere(other.bsphere), useBSphere(other.useBSphere) {}
 
+    // Moves take the dynamic tree proxy over, so that the VirtualScene can
+    // move its objects around
+    GameObject(GameObject&& other) noexcept
+        : sceneObject(std::move(other.sceneObject)), aabb(other.aabb), bsphere(other.bsphere),
+          useBSphere(other.useBSphere), lastMove(other.lastMove), lastMoveTime(other.lastMoveTime) {
+        takeProxy(other);
+    }
+
+    ~GameObject() { detachFromTree(); }
+
     // Getters
-    AABB getAABB() const { return aabb; }
-    BSphere getBSphere() const { return bsphere; }
+    const AABB& getAABB() const { return aabb; }
+    const BSphere& getBSphere() const { return bsphere; }
     glm::vec3 getLastMove() const { return lastMove; }
-    time_t getLastMoveTime() const { return lastMoveTime; }
-    SceneObject getSceneObject() const { return sceneObject; }
+    uint64_t getLastMoveTime() const { return lastMoveTime; }
+    const SceneObject& getSceneObject() const { return sceneObject; }
     bool getUseBSphere() const { return useBSphere; }
+    // Box enclosing the volume used for collision detection
+    AABB getBounds() const { return useBSphere ? bsphere.toAABB() : aabb; }
 
     // Setters
-    void setAABB(const AABB& aabb) { this->aabb = aabb; }
+    void setAABB(const AABB& aabb);
     void setBSphere(const BSphere& bsphere) { this->bsphere = bsphere; }
     void setLastMove(const glm::vec3& lastMove) { this->lastMove = lastMove; }
-    void setLastMoveTime(time_t lastMoveTime) { this->lastMoveTime = lastMoveTime; }
+    void setLastMoveTime(uint64_t lastMoveTime) { this->lastMoveTime = lastMoveTime; }
     void setSceneObject(const SceneObject& sceneObject) { this->sceneObject = sceneObject; }
     void setUseBSphere(bool useBSphere) { this->useBSphere = useBSphere; }
 
+    // Register the GameObject in a dynamic AABB tree. From then on, translate(),
+    // rotate(), scale() and setAABB() keep its proxy up to date.
+    void attachToTree(DynamicAABBTree* tree);
+    void detachFromTree();
+    int32_t getProxyId() const { return proxyId; }
+
     void rotate(float angle, const glm::vec4& axis);
     void translate(float tx, float ty, float tz);
     void scale(float sx, float sy, float sz);
@@ -98,7 +139,9 @@ public:
     // Check if this GameObject intersects another GameObject
     bool intersects(const GameObject& other) const;
 
-    // Update the last movement time
+    // Update the last movement time. It is a logical clock shared by every
+    // GameObject and advanced on each movement, so that the object that moved
+    // last has the largest time, independently of the wall clock.
     void updateMoveTime();
 
     GameObject operator=(const GameObject& other) {
@@ -108,6 +151,21 @@ public:
         lastMove = other.lastMove;
         lastMoveTime = other.lastMoveTime;
         sceneObject = other.sceneObject;
+        updateProxy(glm::vec3(0.0f));
+        return *this;
+    }
+
+    GameObject& operator=(GameObject&& other) noexcept {
+        if (this != &other) {
+            detachFromTree();
+            sceneObject = std::move(other.sceneObject);
+            aabb = other.aabb;
+            bsphere = other.bsphere;
+            useBSphere = other.useBSphere;
+            lastMove = other.lastMove;
+            lastMoveTime = other.lastMoveTime;
+            takeProxy(other);
+        }
         return *this;
     }
 
@@ -119,9 +177,15 @@ private:
     bool useBSphere;         // Flag to use BSphere for collision detection
 
     glm::vec3 lastMove;      // Last movement vector
-    time_t lastMoveTime;     // Time of the last movement
-};
+    uint64_t lastMoveTime;   // Time of the last movement (see updateMoveTime())
 
-using VirtualScene = std::map<std::string, GameObject*>;
+    DynamicAABBTree* tree = nullptr;              // Dynamic tree the object is registered in (if any)
+    int32_t proxyId = DynamicAABBTree::nullNode;  // Proxy of the object in 'tree'
+
+    // Update the proxy of the object after its AABB changed
+    void updateProxy(const glm::vec3& displacement);
+    // Take the proxy of 'other' (moved from), pointing it to this object
+    void takeProxy(GameObject& other);
+};
 
 #endif // GAMEOBJECT_H
\ No newline at end of file
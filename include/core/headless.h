@@ -0,0 +1,17 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/* Headless mode: runs the game simulation without a window or an OpenGL
+ * context. The models are loaded only to build the collision structures,
+ * the player is driven by an input script and the simulated ticks per second
+ * are reported at the end. Used for benchmarks and regression runs in CI.
+ *
+ * Options:
+ *     --ticks N        number of ticks to simulate (default 36000, 5 minutes)
+ *     --script PATH    input script (see InputScript); a built-in script is
+ *                      used when none is given
+ *
+ * Returns the exit code of the program. */
+int RunHeadless(int argc, char** argv);
+
+#endif // HEADLESS_H
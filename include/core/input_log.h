@@ -0,0 +1,84 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* Input event received by the Game callbacks, stamped with the simulation
+ * tick it was received at: the number of ticks simulated so far, so the
+ * event takes effect on tick 'tick + 1'. Frame events mark the end of a
+ * rendered frame and keep the interpolation factor it was drawn with. */
+struct InputEvent {
+    enum Type : uint8_t { Key = 1, MouseButton = 2, Cursor = 3, Frame = 4 };
+
+    Type type;
+    uint64_t tick;
+    int code = 0;    // Key or mouse button (GLFW codes)
+    int action = 0;  // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int mods = 0;
+    double x = 0.0;  // Cursor position
+    double y = 0.0;
+    float alpha = 0.0f; // Frame interpolation factor
+};
+
+/* Writes the input events of a game session to a compact binary log:
+ *
+ *     header:  "CQIN", uint16 version, uint16 tick rate
+ *     event:   uint8 type, varint tick delta from the previous event, then
+ *              Key:          varint key, uint8 action, uint8 mods
+ *              MouseButton:  uint8 button, uint8 action, uint8 mods
+ *              Cursor:       float64 x, float64 y
+ *              Frame:        float32 alpha
+ *
+ * Multi-byte values are little endian; varints are LEB128. Cursor positions
+ * and the frame interpolation factors are stored with all their bits, so a
+ * replay gives exactly the same camera as the recorded session. */
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder() { close(); }
+
+    // Start a new log, replacing the file. Failures end the program.
+    void open(const std::string& path, uint16_t tickRate);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    void record(const InputEvent& event);
+
+    size_t getNumEvents() const { return numEvents; }
+
+private:
+    std::ofstream file;
+    std::string path;
+    std::vector<uint8_t> buffer; // Encoded events not written yet
+    uint64_t lastTick = 0;
+    size_t numEvents = 0;
+    size_t numBytes = 0;
+};
+
+/* Reads back a log written by InputRecorder, one event at a time */
+class InputReplay {
+public:
+    InputReplay() = default;
+
+    // Load the whole log in memory. Invalid logs end the program.
+    void open(const std::string& path);
+    bool isOpen() const { return loaded; }
+
+    uint16_t getTickRate() const { return tickRate; }
+
+    // Read the next event. Returns false at the end of the log.
+    bool next(InputEvent& event);
+
+private:
+    std::string path;
+    std::vector<uint8_t> data;
+    size_t position = 0;
+    uint64_t lastTick = 0;
+    uint16_t tickRate = 0;
+    bool loaded = false;
+};
+
+#endif // INPUT_LOG_H
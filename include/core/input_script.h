@@ -0,0 +1,57 @@
+#ifndef INPUT_SCRIPT_H
+#define INPUT_SCRIPT_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "core/simulation.h"
+
+/* Scripted input for the headless mode. A script is a text file with one
+ * event per line, "<tick> <command> [argument]", applied to the input right
+ * before that tick is simulated:
+ *
+ *     press <W|A|S|D|SHIFT>     hold a key
+ *     release <W|A|S|D|SHIFT>   release a key
+ *     space                     open the chests near the player
+ *     lookat                    toggle the look at the cow mode
+ *     yaw <radians>             set the camera yaw
+ *     pitch <radians>           set the camera pitch
+ *     loop                      start the script again from tick 0
+ *
+ * Events must be sorted by tick. Empty lines and text after '#' are ignored. */
+class InputScript {
+public:
+    InputScript() = default;
+
+    // Load a script from a file, or parse it from a stream. Invalid scripts
+    // are reported on stderr and end the program.
+    static InputScript fromFile(const std::string& path);
+    static InputScript fromStream(std::istream& in, const std::string& sourceName);
+    // Script used when none is given: walks through the maze, turning,
+    // sprinting and trying to open chests, in a loop
+    static InputScript defaultScript();
+
+    // Apply the events of 'tick' to 'input'. Must be called for every tick,
+    // in order, starting at 0.
+    void apply(uint64_t tick, SimulationInput& input);
+
+    size_t size() const { return events.size(); }
+
+private:
+    enum class Command { Press, Release, Space, LookAt, Yaw, Pitch };
+
+    struct Event {
+        uint64_t tick;
+        Command command;
+        int key;     // Press and Release
+        float value; // Yaw and Pitch
+    };
+
+    std::vector<Event> events;
+    uint64_t loopLength = 0; // 0 when the script does not loop
+    size_t nextEvent = 0;
+};
+
+#endif // INPUT_SCRIPT_H
@@ -0,0 +1,60 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/mesh.h"
+#include "core/gameobject.h"
+#include "core/virtual_scene.h"
+
+/* Model of the game world: an OBJ file, or a folder of OBJ files (the maze),
+ * and its model matrix. The same list is loaded by the game, which uploads
+ * the triangles to the GPU, and by the headless mode, which only needs the
+ * bounding volumes of the objects. */
+struct SceneModel {
+    std::string path;
+    glm::mat4 model;
+};
+
+// Models of the game, in loading order. The player cube is placed at
+// 'playerPosition', facing 'playerYaw'.
+std::vector<SceneModel> GetSceneModels(const glm::vec4& playerPosition, float playerYaw);
+
+// OBJ files of a scene model: the file itself, or every file of a folder
+std::vector<std::string> GetModelFiles(const std::string& path);
+
+// Load every OBJ file of 'sceneModels' on a pool of worker threads, which
+// parse the files (or map their cached meshes), compute the normals, the
+// buffers and the bounds. 'upload' is called on the calling thread for each
+// mesh, in the order of the files, as soon as the mesh and the ones before
+// it are ready: the thread owning the OpenGL context is the only one making
+// GL calls, and the scene is built in the same order on every run. Prints
+// the time spent in each stage.
+void LoadSceneMeshes(
+    const std::vector<SceneModel>& sceneModels,
+    const std::function<void(const std::string& file, const glm::mat4& model, Mesh& mesh)>& upload
+);
+
+// Add a GameObject for each shape of 'mesh' to the virtual scene, drawing
+// its range of the index buffer with the vertex array 'vertexArrayObjectId'
+// (0 when the mesh is not on the GPU). 'baseIndex' is the position of the
+// mesh in the index buffer, when it shares the buffer with other meshes, and
+// 'indexType' and 'quantization' describe the packed buffers (see Mesh::packedVertices).
+void AddSceneObjects(
+    VirtualScene& virtualScene,
+    const Mesh& mesh,
+    const glm::mat4& modelMatrix,
+    GLuint vertexArrayObjectId,
+    size_t baseIndex = 0,
+    GLenum indexType = GL_UNSIGNED_INT,
+    const VertexQuantization& quantization = VertexQuantization()
+);
+
+#endif // SCENE_H
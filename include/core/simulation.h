@@ -0,0 +1,154 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "core/gameobject.h"
+#include "core/virtual_scene.h"
+#include "physics/bounding.h"
+#include "physics/collisions.h"
+
+/* Player input sampled at the start of a simulation tick. Movement keys are
+ * held states; the actions are set when their key is pressed and consumed by
+ * the next tick. */
+struct SimulationInput {
+    bool moveForward = false;
+    bool moveBackward = false;
+    bool moveLeft = false;
+    bool moveRight = false;
+    bool sprint = false;
+
+    bool openChest = false;    // Space: open the chests near the player
+    bool toggleLookAt = false; // L: toggle the look at the cow mode
+
+    float cameraYaw = 0.0f;
+    float cameraPitch = 0.0f;
+
+    // Forget the actions once a tick has seen them
+    void clearActions() {
+        openChest = false;
+        toggleLookAt = false;
+    }
+};
+
+/* Part of the simulation state that changes continuously, interpolated
+ * between the last two ticks when rendering */
+struct SimulationState {
+    glm::vec4 playerPosition;
+    glm::vec4 cowPosition;
+    std::vector<float> chestLidRotation;
+
+    // Linear interpolation from 'a' (alpha = 0) to 'b' (alpha = 1)
+    static SimulationState interpolate(const SimulationState& a, const SimulationState& b, float alpha);
+};
+
+/* Game simulation, advanced in fixed ticks of 'tickDuration' seconds,
+ * independently of the frame rate: player movement and collisions, the cow
+ * walking on its Bézier curve, the chest lids, starvation and the end of the
+ * game. Rendering reads the state of the last two ticks and interpolates. */
+class Simulation {
+public:
+    static constexpr float tickRate = 120.0f;
+    static constexpr float tickDuration = 1.0f / tickRate;
+
+    Simulation();
+
+    // Place the chests and build the collision structures. Must be called
+    // once the models of the scene have been loaded into 'virtualScene',
+    // which gets no new objects afterwards.
+    void init(VirtualScene& virtualScene);
+
+    // Advance the simulation by one tick
+    void step(const SimulationInput& input);
+
+    const SimulationState& getState() const { return state; }
+    const SimulationState& getPreviousState() const { return previousState; }
+    uint64_t getTick() const { return tick; }
+
+    int getPlayerLife() const { return playerLife; }
+    int getMaxLife() const { return maxLife; }
+    bool isVictory() const { return victory; }
+    bool isGameOver() const { return gameOver; }
+    // True when the camera is locked on the cow
+    bool isLookingAtCow(const SimulationState& state) const;
+
+    int getNumChests() const { return numChests; }
+    const glm::vec3& getChestCoordinates(int chestIndex) const { return chestCoordinates[chestIndex]; }
+    glm::mat4 getChestBaseModel(int chestIndex) const;
+    glm::mat4 getChestLidModel(int chestIndex, float lidRotation) const;
+    glm::mat4 getCowModel(const glm::vec4& cowPosition) const;
+    // Objects of the chests placed by init()
+    ObjectHandle getChestBaseObject(int chestIndex) const { return chestBaseObjects[chestIndex]; }
+    ObjectHandle getChestLidObject(int chestIndex) const { return chestLidObjects[chestIndex]; }
+
+    // Hash of the bits of the simulation state and of the bounding volumes
+    // of every object. Equal runs give equal checksums, so two builds (or a
+    // session and its replay) can be compared.
+    uint64_t checksum() const;
+
+    // View direction of a camera with the given yaw and pitch
+    static glm::vec4 viewDirection(float yaw, float pitch);
+
+private:
+    VirtualScene* virtualScene = nullptr;
+    // Objects moved by the simulation, found once by init()
+    ObjectHandle playerObject;
+    ObjectHandle cowObject;
+    std::vector<ObjectHandle> chestBaseObjects;
+    std::vector<ObjectHandle> chestLidObjects;
+    StaticCollisionScene staticCollisionScene;
+    DynamicAABBTree dynamicTree;
+
+    SimulationState state;
+    SimulationState previousState;
+    uint64_t tick = 0;
+
+    const int maxLife = 5;
+    int playerLife = maxLife;
+    float timeStarving = 0.0f;
+    const float starvationLimit = 90.0f;
+
+    bool lookAtMode = false;
+    const float distanceCameraCowThreshold = 20.0f;
+
+    bool gameOver = false;
+    bool victory = false;
+
+    const glm::vec4 initialCameraPosition1 = glm::vec4(4.0f, 2.0f, -30.0f, 1.0f);
+    const glm::vec4 initialCameraPosition2 = glm::vec4(84.81f, 2.0f, -76.62f, 1.0f);
+
+    const float baseSpeed = 25.0f; // Units per second
+    const float speedMultiplier = 1.75f;
+
+    // Cow movement along a Bézier curve, back and forth
+    const float cowSpeed = 0.1f;   // Curve parameter per second
+    float cowCurveT = 0.0f;
+    bool cowTurn = false;
+    glm::vec2 p0, p1, p2, p3;
+
+    const std::vector<glm::vec3> chestCoordinates = {
+        glm::vec3(29.390f, 1.0f, -39.671f),
+        glm::vec3(-54.558f, 1.0f, 77.954f),
+        glm::vec3(64.719f, 1.0f, -75.398f),
+        glm::vec3(-9.232f, 1.0f, 53.063f)
+    };
+    std::vector<bool> chestOpened = {false, false, false, false};
+    const int numChests = 4;
+
+    AABB chestBaseModelAABB; // Bounding boxes of the chest models at the origin
+    AABB chestLidModelAABB;
+
+    void movePlayer(const SimulationInput& input);
+    void moveCow();
+    void openChests();
+    void updateChestLids();
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,93 @@
+#ifndef VIRTUAL_SCENE_H
+#define VIRTUAL_SCENE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/gameobject.h"
+
+/* Handle to an object of the VirtualScene: its slot and the generation of
+ * the slot when the object was created, so that the handle of a destroyed
+ * object never resolves to the object that reuses its slot */
+struct ObjectHandle {
+    static constexpr uint32_t nullSlot = UINT32_MAX;
+
+    uint32_t slot = nullSlot;
+    uint32_t generation = 0;
+
+    bool isValid() const { return slot != nullSlot; }
+    bool operator==(const ObjectHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+};
+
+/* The GameObjects of the scene, packed in a single array: destroying an
+ * object moves the last one into its place, so iterating over the scene is
+ * a linear pass over the array. Handles go through a table of slots, which
+ * keeps them valid while the objects move.
+ *
+ * Names are only meant for loading: find() returns the handle of a named
+ * object, which the per-frame code keeps instead of the name. Pointers
+ * returned by get() stay valid until the next create() or destroy(), so
+ * structures holding them (StaticCollisionScene) are built once every
+ * object has been created. Objects registered in a dynamic tree keep their
+ * proxy when they move. */
+class VirtualScene {
+public:
+    VirtualScene() = default;
+    VirtualScene(const VirtualScene&) = delete;
+    VirtualScene& operator=(const VirtualScene&) = delete;
+
+    // Add 'object' under 'name', replacing the object of that name if there
+    // is one (which keeps its handle)
+    ObjectHandle create(const std::string& name, GameObject object);
+    // Remove the object of 'handle'. Stale handles are ignored.
+    void destroy(ObjectHandle handle);
+    void clear();
+
+    // Object of 'handle', or nullptr if it was destroyed
+    GameObject* get(ObjectHandle handle) {
+        return isAlive(handle) ? &objects[slotObjects[handle.slot]] : nullptr;
+    }
+    const GameObject* get(ObjectHandle handle) const {
+        return isAlive(handle) ? &objects[slotObjects[handle.slot]] : nullptr;
+    }
+    bool isAlive(ObjectHandle handle) const {
+        return handle.slot < generations.size() && generations[handle.slot] == handle.generation
+               && slotObjects[handle.slot] != ObjectHandle::nullSlot;
+    }
+
+    // Handle of the object named 'name', or an invalid handle. Builds no
+    // string, but walks a map: for loading, not for each frame.
+    ObjectHandle find(const std::string& name) const;
+    // Handles of every object, in name order, whatever the order they were
+    // created in
+    const std::map<std::string, ObjectHandle>& getNames() const { return names; }
+
+    // The packed objects, and the name of each
+    size_t size() const { return objects.size(); }
+    GameObject* begin() { return objects.data(); }
+    GameObject* end() { return objects.data() + objects.size(); }
+    const GameObject* begin() const { return objects.data(); }
+    const GameObject* end() const { return objects.data() + objects.size(); }
+    const std::string& getName(size_t index) const { return objectNames[index]; }
+
+private:
+    std::vector<GameObject> objects;     // Packed
+    std::vector<std::string> objectNames; // Of each packed object
+    std::vector<uint32_t> objectSlots;    // Slot of each packed object
+
+    // Per slot: the packed object it refers to (nullSlot when free) and its
+    // generation, bumped each time the slot is freed
+    std::vector<uint32_t> slotObjects;
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+
+    std::map<std::string, ObjectHandle> names;
+};
+
+#endif // VIRTUAL_SCENE_H
@@ -12,8 +12,6 @@
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
-using UniformMap = std::map<std::string, GLint>;
-
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
 
 #endif // GRAPHICS_CORE_H
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "physics/bounding.h"
+#include "physics/collision_world.h"
+
+/* The six planes of a view frustum (left, right, bottom, top, near, far),
+ * facing inwards: a point p is inside when dot(plane, p) >= 0 for all of
+ * them. The planes are not normalized, which the box test does not need. */
+struct ViewFrustum {
+    glm::vec4 planes[6];
+
+    // Planes of the clip volume of 'clip' (projection * view gives them in
+    // world space), extracted from its rows (Gribb and Hartmann)
+    static ViewFrustum fromMatrix(const glm::mat4& clip);
+
+    // False when the box is entirely behind one of the planes. Same test as
+    // FrustumCuller, for a single box.
+    bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+    bool intersects(const AABB& aabb) const {
+        return intersects(glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()));
+    }
+    // False when the sphere is entirely behind one of the planes
+    bool intersects(const glm::vec3& center, float radius) const;
+};
+
+/* World space boxes tested against a view frustum, stored as a structure of
+ * arrays like CollisionWorld so that the plane tests run on 8 boxes per AVX2
+ * instruction or 4 per SSE2 instruction. Each plane is tested against the
+ * corner of the box furthest along its normal: a box is culled when that
+ * corner is behind the plane. */
+class FrustumCuller {
+public:
+    // Number of boxes tested by a single call to testRange()
+    static constexpr size_t batchSize = 16;
+
+    FrustumCuller();
+
+    size_t add(const AABB& aabb);
+    void set(size_t index, const AABB& aabb);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Bitmask of the boxes in [first, first + n) inside or crossing
+    // 'frustum', where bit i stands for box first + i and n <= batchSize.
+    // Uses the widest instruction set available.
+    uint32_t testRange(const ViewFrustum& frustum, size_t first, size_t n = batchSize) const;
+    // Same result as testRange(), one box at a time
+    uint32_t testRangeScalar(const ViewFrustum& frustum, size_t first, size_t n = batchSize) const;
+
+    // Append the indices of the boxes not culled by 'frustum' to 'visible',
+    // in increasing order. Returns how many were appended.
+    size_t cull(const ViewFrustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // Name of the instruction set used by testRange()
+    static const char* simdPath() { return CollisionWorld::simdPath(); }
+
+private:
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    size_t count;
+
+    // Keep 'batchSize' empty boxes after the last one
+    void resizeArrays(size_t numBoxes);
+
+    uint32_t testLanesScalar(const ViewFrustum& frustum, size_t first, size_t n) const;
+#if defined(COWQUEST_SIMD_AVX2)
+    uint32_t testLanesAVX2(const ViewFrustum& frustum, size_t first) const;
+#elif defined(COWQUEST_SIMD_SSE2)
+    uint32_t testLanesSSE2(const ViewFrustum& frustum, size_t first) const;
+#endif
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,68 @@
+#ifndef INSTANCED_MESH_H
+#define INSTANCED_MESH_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "graphics/mesh.h"
+#include "graphics/render_queue.h"
+#include "graphics/vertex_format.h"
+#include "core/gameobject.h"
+#include "core/virtual_scene.h"
+
+/* Mesh uploaded once and drawn many times with a single
+ * glDrawElementsInstanced (the chests). Each instance has its own model
+ * matrix, read from a per-instance buffer by "shader_vertex.glsl" when the
+ * "instanced" uniform is set. State that moves a part of an instance, such
+ * as the rotation of a chest lid, goes into its matrix. Only the instances
+ * changed since the last draw are copied to the GPU. */
+class InstancedMesh {
+public:
+    InstancedMesh() = default;
+    InstancedMesh(const InstancedMesh&) = delete;
+    InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+    // Copy 'mesh' to the GPU and add its shapes to the virtual scene, placed
+    // by 'modelMatrix', like BuildSceneTriangles()
+    void upload(VirtualScene& virtualScene, const Mesh& mesh, const glm::mat4& modelMatrix);
+
+    // Number of instances drawn. New instances start with the identity.
+    void setNumInstances(size_t numInstances);
+    size_t getNumInstances() const { return instances.size(); }
+    void setInstance(size_t index, const glm::mat4& model);
+
+    // Copy the instances changed since the last draw to the GPU and add the
+    // draw of every instance, with one call, to 'queue'. 'packet' holds the
+    // program and the draw data.
+    void draw(RenderQueue& queue, DrawPacket packet, float depth);
+
+    // Decoding of the positions, for "position_offset" and "position_scale"
+    const VertexQuantization& getQuantization() const { return quantization; }
+
+private:
+    /* Per-instance attributes, "(location = 5)" to "(location = 8)" in
+     * "shader_vertex.glsl" (one column of the matrix each) */
+    struct InstanceData {
+        glm::mat4 model;
+    };
+
+    std::vector<InstanceData> instances;
+    size_t dirtyBegin = 0; // Instances [dirtyBegin, dirtyEnd) changed since the last draw
+    size_t dirtyEnd = 0;
+    size_t instanceCapacity = 0; // Of the instance buffer
+
+    size_t numIndices = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    VertexQuantization quantization;
+
+    GLuint vertexArrayObjectId = 0;
+    GLuint instanceBufferId = 0;
+
+    void markDirty(size_t begin, size_t end);
+};
+
+#endif // INSTANCED_MESH_H
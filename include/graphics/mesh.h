@@ -0,0 +1,133 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/vec4.hpp>
+
+#include "graphics/objmodel.h"
+#include "graphics/vertex_format.h"
+#include "utils/file_utils.h"
+
+/* Vertex of a Mesh, as cooked, read on the CPU. The GPU gets the same vertex
+ * packed into a PackedVertex (see "vertex_format.h"). */
+struct MeshVertex {
+    float position[4];
+    float normal[4];
+    float texcoord[2];
+};
+
+/* Simplified version of a shape (see GenerateMeshLods()): its range of the
+ * index buffer, using the vertices of the shape, and how far it strays from
+ * the full shape, in model space units */
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float error;
+};
+
+/* Cluster of neighbouring triangles of a shape (see GenerateMeshlets()):
+ * its range of the index buffer, a sphere bounding its vertices and a cone
+ * bounding the normals of its triangles, all in model space. The cluster
+ * faces away from a camera at c when
+ * dot(center - c, coneAxis) >= coneCutoff * |center - c| + radius. */
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff; // Sine of the cone angle, 1 when the cone is too wide to cull
+};
+
+/* Range of the index buffer drawn by one shape (object) of the OBJ file */
+struct MeshShape {
+    std::string name;
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    std::vector<MeshLod> lods; // Coarser and coarser, after the full shape
+    std::vector<Meshlet> meshlets; // Covering the full shape, in order
+};
+
+/* Triangles of an OBJ file: one interleaved vertex buffer and one index
+ * buffer, read on the CPU, the same two buffers packed, ready to be copied
+ * to the GPU as they are, plus the shapes and the bounds of the model. The
+ * buffers either belong to the Mesh or point into a memory mapped cache
+ * file (see LoadMesh()). */
+struct Mesh {
+    Mesh() = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+
+    std::vector<MeshShape> shapes;
+    glm::vec4 boundsMin = glm::vec4(0.0f); // Of every vertex of the model
+    glm::vec4 boundsMax = glm::vec4(0.0f);
+    bool hasNormals = false;   // Vertex attributes found in the OBJ file
+    bool hasTexCoords = false;
+
+    const MeshVertex* vertices = nullptr;
+    size_t numVertices = 0;
+    const uint32_t* indices = nullptr;
+    size_t numIndices = 0;
+
+    // The vertices quantized against 'quantization' and the indices, 16
+    // bits wide when they can address every vertex (see PackMesh())
+    VertexQuantization quantization;
+    const PackedVertex* packedVertices = nullptr;
+    const uint8_t* packedIndices = nullptr;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    size_t packedVerticesSize() const { return numVertices * sizeof(PackedVertex); }
+    size_t packedIndicesSize() const { return numIndices * IndexSize(indexType); }
+
+    // Storage of the buffers above: owned vectors, or the cache file
+    std::vector<MeshVertex> vertexStorage;
+    std::vector<uint32_t> indexStorage;
+    std::vector<PackedVertex> packedVertexStorage;
+    std::vector<uint8_t> packedIndexStorage;
+    MappedFile mapping;
+};
+
+/* Time spent in each stage of LoadMesh(), in seconds */
+struct MeshLoadStats {
+    bool fromCache = false;
+    double readTime = 0.0;       // Mapping the cache file, or parsing the OBJ file
+    double normalsTime = 0.0;
+    double buildTime = 0.0;      // Vertex and index buffers, bounds
+    double optimizeTime = 0.0;   // Welding, vertex cache and fetch order
+    double simplifyTime = 0.0;   // Levels of detail
+    double meshletTime = 0.0;
+    double packTime = 0.0;
+    double cacheWriteTime = 0.0;
+
+    // Vertex count and cache miss ratio before and after the optimization,
+    // only when the mesh was cooked
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+// Compute normals for an ObjModel
+void ComputeNormals(ObjModel* model);
+
+// Build the triangles of an ObjModel, which must have normals
+Mesh BuildMesh(const ObjModel& model);
+
+// Load the mesh of an OBJ file. The first load parses the file, optimizes
+// it, simplifies its large shapes into levels of detail, splits them into
+// meshlets, packs it and writes a cooked copy to the mesh cache; the
+// following ones map that copy, as long as the size, the modification time
+// or the hash of the OBJ file still match.
+// Safe to call from several threads at once.
+Mesh LoadMesh(const std::string& objFilePath, MeshLoadStats* stats = nullptr);
+
+// Cache file of an OBJ file
+std::string GetMeshCachePath(const std::string& objFilePath);
+
+#endif // MESH_H
@@ -0,0 +1,42 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+/* Vertex count and average cache miss ratio (ACMR: vertex shader runs per
+ * triangle, between 0.5 and 3) of a mesh, before and after OptimizeMesh() */
+struct MeshOptimizeStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+// Merge the vertices with the same position, normal and texture coordinates,
+// so that triangles share them. Returns the new number of vertices.
+size_t WeldVertices(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+// Reorder the triangles of indices[0, numIndices) so that consecutive
+// triangles reuse the vertices still in the post-transform cache (Tom
+// Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVertices);
+
+// Renumber the vertices in the order the index buffer first uses them, so
+// that vertex fetches go through memory sequentially. Unused vertices are
+// dropped.
+void OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+// Average cache miss ratio of a triangle list, simulating a FIFO
+// post-transform cache of 'cacheSize' vertices
+float ComputeACMR(const uint32_t* indices, size_t numIndices, size_t numVertices, unsigned cacheSize = 16);
+
+// Weld the vertices of a mesh built by BuildMesh(), then optimize each shape
+// for the vertex cache and the whole mesh for vertex fetch. The shapes keep
+// their index ranges.
+void OptimizeMesh(Mesh& mesh, MeshOptimizeStats* stats = nullptr);
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,36 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "graphics/mesh.h"
+
+/* One level of SimplifyTriangles(): its triangles, and the error of the
+ * collapses that led to it, as an area weighted RMS distance to the planes
+ * of the original triangles, in the units of the positions */
+struct SimplifiedTriangles {
+    std::vector<uint32_t> indices;
+    float error = 0.0f;
+};
+
+// Simplify the triangle list indices[0, numIndices) by collapsing edges in
+// the order of their quadric error (Garland and Heckbert). A vertex always
+// moves onto one of its neighbours, so that the levels only index the
+// existing vertices. Vertices on an open border or on an attribute seam
+// (sharing their position with another vertex) never move.
+//
+// Returns one level per entry of 'targetTriangles' (decreasing counts),
+// fewer if the mesh cannot be simplified that far.
+std::vector<SimplifiedTriangles> SimplifyTriangles(const MeshVertex* vertices, size_t numVertices,
+                                                   const uint32_t* indices, size_t numIndices,
+                                                   const std::vector<size_t>& targetTriangles);
+
+// Give every shape of at least 'minTriangles' triangles 'numLods' levels of
+// detail, each with half the triangles of the one before, appended to the
+// index buffer of a mesh built by BuildMesh() and optimized by
+// OptimizeMesh(). Each level is optimized for the vertex cache.
+void GenerateMeshLods(Mesh& mesh, size_t minTriangles = 2000, size_t numLods = 3);
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,39 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "graphics/frustum.h"
+#include "graphics/mesh.h"
+
+// Split the triangle list indices[0, numIndices) into meshlets of at most
+// 'maxVertices' vertices and 'maxTriangles' triangles, reordering its
+// triangles in place so that each meshlet is a contiguous range. A meshlet
+// grows from a seed triangle by adding the neighbouring triangle that needs
+// the fewest new vertices, then whose normal is closest to the others, and
+// its triangles are optimized for the vertex cache. The ranges of the
+// meshlets are relative to 'indices'.
+std::vector<Meshlet> BuildMeshlets(const MeshVertex* vertices, size_t numVertices,
+                                   uint32_t* indices, size_t numIndices,
+                                   size_t maxVertices = 64, size_t maxTriangles = 124);
+
+// Split every shape of at least 'minTriangles' triangles of a mesh built by
+// BuildMesh() into meshlets (see BuildMeshlets())
+void GenerateMeshlets(Mesh& mesh, size_t minTriangles = 2000);
+
+// Whether a meshlet may be seen by a camera at 'cameraPosition' with the
+// view frustum 'frustum', both in model space: false when its sphere is
+// outside the frustum or when all of its triangles face away from the camera
+bool IsMeshletVisible(const Meshlet& meshlet, const ViewFrustum& frustum, const glm::vec3& cameraPosition);
+
+// Append the indices of the visible meshlets of [meshlets, meshlets +
+// numMeshlets) to 'visible', in increasing order. Returns the number of
+// triangles of the meshlets that were culled.
+size_t CullMeshlets(const Meshlet* meshlets, size_t numMeshlets, const ViewFrustum& frustum,
+                    const glm::vec3& cameraPosition, std::vector<uint32_t>& visible);
+
+#endif // MESHLETS_H
@@ -0,0 +1,164 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "graphics/frustum.h"
+#include "physics/bounding.h"
+#include "physics/collision_world.h"
+
+/* Depth buffer drawn on the CPU at a low resolution, with the NDC depth of
+ * the nearest occluder at the center of each pixel, and a hierarchy of
+ * levels keeping the maximum (furthest) depth of each 2x2 block of the
+ * level below. A box is occluded when its nearest depth is behind the
+ * furthest depth of every texel under its screen rectangle.
+ *
+ * Triangles are rasterized one row at a time, 8 pixels per AVX2
+ * instruction or 4 per SSE2 instruction. A box visible through less than
+ * one pixel of the buffer can be reported as occluded. */
+class OcclusionBuffer {
+public:
+    static constexpr int width = 256; // A multiple of 8, the widest row step
+    static constexpr int height = 144;
+
+    OcclusionBuffer();
+
+    // Reset every depth to the far plane and set the camera, 'clip' being
+    // projection * view
+    void clear(const glm::mat4& clip);
+
+    // Draw the triangles of world space 'positions' listed by 'indices'.
+    // Uses the widest instruction set available.
+    void drawTriangles(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                       size_t numIndices);
+    // Same depths as drawTriangles(), one pixel at a time
+    void drawTrianglesScalar(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                             size_t numIndices);
+
+    // Build the levels of maximum depth. Call after the last draw.
+    void buildHierarchy();
+
+    // False when the box is entirely behind the triangles drawn. Boxes
+    // crossing the near plane or outside the screen are visible.
+    bool isVisible(const glm::vec3& min, const glm::vec3& max) const;
+    bool isVisible(const AABB& aabb) const {
+        return isVisible(glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()));
+    }
+
+    const std::vector<float>& getDepths() const { return depths; }
+    size_t getNumTrianglesDrawn() const { return numTrianglesDrawn; }
+
+    // Name of the instruction set used by drawTriangles()
+    static const char* simdPath() { return CollisionWorld::simdPath(); }
+
+private:
+    /* A triangle in pixel coordinates, set up for the row kernels: edge i
+     * is edgeA[i] * x + edgeB[i] * y + edgeC[i] >= 0 inside, and the depth
+     * is depthA * x + depthB * y + depthC */
+    struct RasterTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    glm::mat4 clip = glm::mat4(1.0f);
+    std::vector<float> depths;    // width * height, row 0 at the bottom
+    std::vector<float> hierarchy; // Levels 1 and up, each half the size of the one below
+    std::vector<size_t> levelOffsets; // Into 'hierarchy', level 1 first
+    std::vector<glm::ivec2> levelSizes; // Level 0 first
+    std::vector<glm::vec4> clipPositions; // Scratch of drawTriangles()
+    size_t numTrianglesDrawn = 0;
+
+    void drawTriangles(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                       size_t numIndices, bool simd);
+    // Clip a triangle against the near plane and set up what is left
+    void drawClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, bool simd);
+    void rasterize(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, bool simd);
+
+    void rasterizeScalar(const RasterTriangle& triangle);
+#if defined(COWQUEST_SIMD_AVX2)
+    void rasterizeAVX2(const RasterTriangle& triangle);
+#elif defined(COWQUEST_SIMD_SSE2)
+    void rasterizeSSE2(const RasterTriangle& triangle);
+#endif
+
+    float getLevelDepth(int level, int x, int y) const;
+};
+
+/* Occluders drawn into an OcclusionBuffer on a worker thread. Each frame,
+ * beginFrame() hands the camera to the worker as soon as it is known, which
+ * draws the occluders inside the view frustum while the caller goes on with
+ * its own work (its frustum culling and its first draw calls). The first
+ * box tested waits for the worker, so the caller only blocks if it needs
+ * the buffer before it is ready. */
+class OcclusionCuller {
+public:
+    OcclusionCuller();
+    // Wait for the frame in progress and stop the worker
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Add an occluder, triangles of world space 'positions'. Must lie inside
+    // the object it stands for. Not while a frame is in progress.
+    void addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+    size_t getNumOccluders() const { return occluders.size(); }
+
+    // Start drawing the occluders seen through 'clip' (projection * view)
+    void beginFrame(const glm::mat4& clip);
+    // Wait for the frame started by beginFrame(). Does nothing when there
+    // is none in progress.
+    void endFrame();
+
+    // Test a box against the last frame, first waiting for the one in
+    // progress if any. Every box is visible until a first frame is finished.
+    bool isVisible(const AABB& aabb) {
+        endFrame();
+        return !hasFrame || buffer.isVisible(aabb);
+    }
+
+    // Occluders and triangles drawn by the last frame, and the time the
+    // worker took, in seconds
+    size_t getNumOccludersDrawn() const { return numOccludersDrawn; }
+    size_t getNumTrianglesDrawn() const { return buffer.getNumTrianglesDrawn(); }
+    double getFrameTime() const { return frameTime; }
+
+private:
+    struct Occluder {
+        uint32_t firstPosition, numPositions;
+        uint32_t firstIndex, numIndices; // Relative to firstPosition
+    };
+
+    std::vector<Occluder> occluders;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    FrustumCuller occluderCuller; // Bounds of the occluders
+    std::vector<uint32_t> visibleOccluders;
+
+    OcclusionBuffer buffer;
+    glm::mat4 clip = glm::mat4(1.0f);
+    size_t numOccludersDrawn = 0;
+    double frameTime = 0.0;
+    bool hasFrame = false;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable frameRequested;
+    std::condition_variable frameFinished;
+    bool framePending = false; // Set by beginFrame(), cleared by the worker
+    bool frameInProgress = false; // Between beginFrame() and endFrame()
+    bool stopping = false;
+
+    void workerLoop();
+    void drawFrame();
+};
+
+#endif // OCCLUSION_H
@@ -0,0 +1,91 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "graphics/mesh.h"
+
+/* How the cells of a PotentiallyVisibleSet are laid out and sampled */
+struct PvsSettings {
+    float cellSize = 6.0f;     // Side of a cell of the floor grid
+    uint32_t samplesPerCell = 2; // Spacing of the ray origins, per side of a cell
+    float eyeHeight = 2.0f;    // Height (y) of the camera
+    float maxDistance = 100.0f; // Nothing further is drawn (the far plane)
+    uint32_t numAzimuths = 512;  // Ray directions around each sample point...
+    uint32_t numElevations = 3;  // ...at these many heights, from -0.3 to 0.6 rad
+};
+
+/* Time spent by LoadPotentiallyVisibleSet(), in seconds */
+struct PvsLoadStats {
+    bool fromCache = false;
+    double buildTime = 0.0; // Casting the rays, when not read from the cache
+    double cacheTime = 0.0; // Reading or writing the cache file
+    uint64_t numRays = 0;
+};
+
+/* Potentially visible set of the maze pieces. The floor under the pieces is
+ * split into square cells and each cell keeps a bitset with one bit per
+ * piece, set when that piece can be seen from somewhere in the cell.
+ *
+ * Visibility is sampled: rays are cast in every direction from a lattice of
+ * points covering each cell, at eye height, against the triangles of the
+ * pieces, and the first piece each ray hits is marked visible. A piece seen
+ * only through a gap thinner than the spacing of the rays can be missed. */
+class PotentiallyVisibleSet {
+public:
+    PotentiallyVisibleSet() = default;
+
+    // Cast the rays against 'pieces', ranges of 'indices' into world space
+    // 'vertices'. Uses every hardware thread.
+    void build(const MeshVertex* vertices, const uint32_t* indices, const std::vector<MeshShape>& pieces,
+               const PvsSettings& settings, PvsLoadStats* stats = nullptr);
+
+    // Read or write the bitsets, tagged with 'key' (see HashPvsInput());
+    // reading fails when the file has another key
+    bool readCache(const std::string& path, uint64_t key);
+    bool writeCache(const std::string& path, uint64_t key) const;
+
+    bool empty() const { return bits.empty(); }
+    size_t getNumCells() const { return static_cast<size_t>(cellsX) * cellsZ; }
+    size_t getNumPieces() const { return numPieces; }
+
+    // Cell under 'position', or -1 outside the grid
+    int findCell(const glm::vec3& position) const;
+    bool isVisible(int cell, size_t piece) const {
+        return (bits[cell * wordsPerCell + piece / 64] >> (piece % 64)) & 1;
+    }
+    size_t countVisible(int cell) const;
+
+    // Remove from 'pieces' those not visible from 'cell', keeping the order.
+    // Every piece is kept outside the grid (cell -1). Returns how many were
+    // removed.
+    size_t filter(int cell, std::vector<uint32_t>& pieces) const;
+
+private:
+    glm::vec2 gridMin = glm::vec2(0.0f); // Corner of cell 0, in (x, z)
+    float cellSize = 1.0f;
+    int cellsX = 0; // Cell (i, j) is cellsX * j + i
+    int cellsZ = 0;
+    size_t numPieces = 0;
+    size_t wordsPerCell = 0;
+    std::vector<uint64_t> bits;
+};
+
+// Hash of the geometry, the piece names and the settings a
+// PotentiallyVisibleSet is built from, which tells whether its cache file is
+// still valid. Pieces must come in the same order on every run.
+uint64_t HashPvsInput(const MeshVertex* vertices, size_t numVertices, const uint32_t* indices, size_t numIndices,
+                      const std::vector<MeshShape>& pieces, const PvsSettings& settings);
+
+// Read the set of 'name' from the cache, or build it and write it there
+PotentiallyVisibleSet LoadPotentiallyVisibleSet(const std::string& name, const MeshVertex* vertices,
+                                                size_t numVertices, const uint32_t* indices, size_t numIndices,
+                                                const std::vector<MeshShape>& pieces,
+                                                const PvsSettings& settings = PvsSettings(),
+                                                PvsLoadStats* stats = nullptr);
+
+#endif // PVS_H
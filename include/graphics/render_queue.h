@@ -0,0 +1,83 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "graphics/uniforms.h"
+#include "physics/bounding.h"
+
+/* Draw call collected by a RenderQueue: the GL state it needs, its range of
+ * the index buffer (or ranges, see RenderQueue::add()) and its draw data */
+struct DrawPacket {
+    GLuint programId = 0;
+    GLuint vertexArrayObjectId = 0;
+    GLenum renderingMode = GL_TRIANGLES;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei count = 0;             // Indices of the range
+    const void* offset = nullptr;  // Of the range in the index buffer, in bytes
+    GLsizei numInstances = 0;      // 0 to draw without instancing
+    DrawUniforms uniforms;
+
+    // Filled by the queue
+    uint64_t key = 0;
+    uint32_t firstRange = 0;       // Of the ranges of a multi-draw, in the queue
+    uint32_t numRanges = 0;
+};
+
+/* Draw calls of a frame, sorted before they are made. The 64-bit key of a
+ * packet holds, from the most significant bits: the program (8 bits), the
+ * depth (24 bits), the vertex array (16 bits) and the material (16 bits,
+ * the object id, which selects the textures in the fragment shader). Opaque
+ * geometry thus goes front to back, which lets early depth testing skip the
+ * fragments behind what was drawn, and packets at the same depth are
+ * grouped by state. While flushing, the draw data of every packet is
+ * uploaded at once, then the program, the vertex array and the range of the
+ * draw data are only bound when they differ from the last packet. */
+class RenderQueue {
+public:
+    /* GL work done by the last flush() */
+    struct Stats {
+        size_t draws = 0;
+        size_t programBinds = 0;
+        size_t vertexArrayBinds = 0;
+        size_t uniformUploads = 0; // Draw data slots written, the others reuse the last one
+    };
+
+    // Start the packets of a frame drawn from 'cameraPosition'
+    void begin(const glm::vec3& cameraPosition);
+
+    // Distance from the camera to the box, 0 when the camera is inside it
+    float depthOf(const AABB& bounds) const;
+
+    // Add a draw of the range 'packet.count', 'packet.offset', at 'depth'
+    void add(const DrawPacket& packet, float depth);
+    // Add a multi-draw of the ranges counts[i], offsets[i], made with a
+    // single glMultiDrawElements()
+    void add(const DrawPacket& packet, float depth, const std::vector<GLsizei>& counts,
+             const std::vector<const void*>& offsets);
+
+    // Sort the packets, upload their draw data to the slots of 'uniforms'
+    // and make their draw calls. Leaves no vertex array bound.
+    void flush(UniformBuffers& uniforms);
+
+    size_t size() const { return packets.size(); }
+    const Stats& getStats() const { return stats; }
+
+    static uint64_t makeKey(GLuint programId, float depth, GLuint vertexArrayObjectId, int32_t material);
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<uint32_t> order;       // Of the packets, sorted by key
+    std::vector<uint32_t> slots;       // Draw data slot of each packet of 'order'
+    std::vector<GLsizei> rangeCounts;  // Of the multi-draws
+    std::vector<const void*> rangeOffsets;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    Stats stats;
+};
+
+#endif // RENDER_QUEUE_H
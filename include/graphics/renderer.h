@@ -14,22 +14,39 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "graphics/objmodel.h"
+#include "graphics/mesh.h"
 #include "graphics/core.h"
+#include "graphics/render_queue.h"
+#include "graphics/uniforms.h"
 #include "utils/math_utils.h"
 #include "core/gameobject.h"
+#include "core/virtual_scene.h"
 
 enum InterpolationType {
     GOURAUD_INTERPOLATION,
     PHONG_INTERPOLATION
 };
 
-// Draw a virtual object
-void DrawVirtualObject(UniformMap& uniforms, VirtualScene& virtualScene, const char* objectName);
-// Build triangles from an ObjModel and add to the virtual scene
-void BuildSceneTriangles(VirtualScene& virtualScene, ObjModel* model, glm::mat4 modelMatrix,
+// Add the draw of a virtual object, or of one of its levels of detail (0 is
+// the full object, 1 its first entry of SceneObject::lods, and so on), to
+// 'queue': 'packet' with the program and the draw data, plus the vertex
+// array, the bounds and the quantization of the object
+void DrawVirtualObject(RenderQueue& queue, DrawPacket packet, const GameObject& object, int lod = 0);
+// Add the draw of the meshlets of a virtual object listed in
+// 'visibleMeshlets' (indices into SceneObject::meshlets, see CullMeshlets())
+// to 'queue', as a single glMultiDrawElements() call
+void DrawVirtualObjectMeshlets(RenderQueue& queue, DrawPacket packet, const GameObject& object,
+                               const std::vector<uint32_t>& visibleMeshlets);
+// Choose the level of detail of an object drawn at 'pixelsPerUnit' pixels
+// per model space unit: the coarsest one whose error stays under
+// 'maxPixelError' pixels on screen. The level only gets coarser once its
+// error falls under 'hysteresis' times that bound, so that an object at
+// the edge between two levels does not flicker between them.
+int SelectLod(const SceneObject& sceneObject, float pixelsPerUnit, int currentLod,
+              float maxPixelError = 1.0f, float hysteresis = 0.75f);
+// Upload the triangles of a Mesh to the GPU and add its shapes to the virtual scene
+void BuildSceneTriangles(VirtualScene& virtualScene, const Mesh& mesh, glm::mat4 modelMatrix,
                          bool useBSphere=false);
-// Compute normals for an ObjModel
-void ComputeNormals(ObjModel* model);
 // Push a matrix onto the matrix stack
 void PushMatrix(std::stack<glm::mat4>& matrixStack, const glm::mat4& M);
 // Pop a matrix from the matrix stack
@@ -9,9 +9,10 @@
 #include <glm/vec4.hpp>
 
 #include "graphics/core.h"
+#include "graphics/uniforms.h"
 
 // Load vertex and fragment shaders from files
-void LoadShadersFromFiles(GLuint& gpuProgramId, UniformMap& uniforms);
+void LoadShadersFromFiles(GLuint& gpuProgramId, UniformTable& uniforms);
 
 // Load a vertex shader
 GLuint LoadShader_Vertex(const char* filename);
@@ -0,0 +1,98 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "graphics/mesh.h"
+#include "graphics/render_queue.h"
+#include "graphics/vertex_format.h"
+#include "physics/bounding.h"
+#include "core/gameobject.h"
+#include "core/virtual_scene.h"
+
+/* Piece of a StaticBatch: one shape, with its range of the shared index
+ * buffer and its bounds in world space */
+struct StaticBatchPiece {
+    std::string name;
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    AABB bounds;
+};
+
+/* Static geometry sharing one material (the maze), packed in a single
+ * vertex and index buffer so that it draws with one call. Vertices are
+ * stored in world space, in the PackedVertex format, quantized against the
+ * box of the whole batch. Each vertex also carries the bounding box of its
+ * piece, which the fragment shader uses to project the texture, since the
+ * pieces no longer get a bbox uniform each. */
+class StaticBatch {
+public:
+    StaticBatch() = default;
+    StaticBatch(const StaticBatch&) = delete;
+    StaticBatch& operator=(const StaticBatch&) = delete;
+
+    // Append the shapes of 'mesh', placed by 'modelMatrix', and add them to
+    // the virtual scene. Their SceneObjects draw their range of the batch.
+    void add(VirtualScene& virtualScene, const Mesh& mesh, const glm::mat4& modelMatrix);
+    // Pack the batch, copy it to the GPU and free the CPU copy. Call once,
+    // after the last add(). The pieces in the virtual scene get the index
+    // type and quantization of the packed buffers.
+    void upload(VirtualScene& virtualScene);
+
+    // Add the draw of every piece, with a single glDrawElements, to 'queue'.
+    // 'packet' holds the program and the draw data.
+    void draw(RenderQueue& queue, DrawPacket packet, float depth) const;
+    // Add the draw of the given pieces (indices into getPieces(), in
+    // increasing order), with a single glMultiDrawElements merging adjacent
+    // ranges, to 'queue'
+    void draw(RenderQueue& queue, DrawPacket packet, float depth, const std::vector<uint32_t>& pieces) const;
+
+    const std::vector<StaticBatchPiece>& getPieces() const { return pieces; }
+    // CPU copy of the batch, in world space, until upload() frees it
+    const std::vector<MeshVertex>& getVertices() const { return vertices; }
+    const std::vector<uint32_t>& getIndices() const { return indices; }
+    size_t getNumVertices() const { return numVertices; }
+    size_t getNumIndices() const { return numIndices; }
+    // Decoding of the positions, for "position_offset" and "position_scale"
+    const VertexQuantization& getQuantization() const { return quantization; }
+    // Size of the buffers on the GPU, and what they would take unpacked
+    size_t getSizeInBytes() const { return sizeInBytes; }
+    size_t getUnpackedSizeInBytes() const { return unpackedSizeInBytes; }
+
+private:
+    /* Bounding box of the piece of a vertex, before packing */
+    struct PieceBounds {
+        float min[3];
+        float max[3];
+    };
+
+    /* Bounding box of the piece of a vertex as copied to the GPU, quantized
+     * like the positions: "(location = 3)" and "(location = 4)" in
+     * "shader_vertex.glsl" ([3] is padding) */
+    struct PackedPieceBounds {
+        uint16_t min[4];
+        uint16_t max[4];
+    };
+
+    std::vector<StaticBatchPiece> pieces;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<PieceBounds> vertexBounds;
+    std::vector<uint32_t> indices;
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    VertexQuantization quantization;
+    size_t sizeInBytes = 0;
+    size_t unpackedSizeInBytes = 0;
+
+    GLuint vertexArrayObjectId = 0;
+};
+
+#endif // STATIC_BATCH_H
@@ -0,0 +1,41 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/thread_pool.h"
+
+/* Level of a texture: RGBA8 texels in sRGB, rows packed, bottom row first */
+struct TextureLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> texels;
+};
+
+// Number of levels of a full mip chain, down to 1x1 (as glGenerateMipmap())
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// The mip chain of 'base', 'base' included. Each level averages 2x2 texels
+// of the level above in linear light, so that dark and bright texels do not
+// blend into a too dark color as they would in sRGB. Rows are spread over
+// 'pool' when there is one.
+std::vector<TextureLevel> GenerateMipChain(TextureLevel base, ThreadPool* pool = nullptr);
+
+/* BC1 (DXT1) blocks: 8 bytes for each 4x4 texels, 2 RGB565 endpoints and a
+ * 2-bit index per texel picking one of 4 colors on the segment between
+ * them. A quarter of the size of the RGBA8 texels, alpha dropped. */
+const size_t bc1BlockSize = 8;
+
+size_t BC1LevelSize(uint32_t width, uint32_t height);
+
+// Encode 'level' into BC1LevelSize() bytes at 'blocks'. Each block takes its
+// endpoints from the principal axis of its colors, refined by least
+// squares. Rows of blocks are spread over 'pool' when there is one.
+void EncodeBC1(const TextureLevel& level, uint8_t* blocks, ThreadPool* pool = nullptr);
+
+// Decode BC1 blocks into width * height RGBA8 texels, alpha 255
+void DecodeBC1(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* texels);
+
+#endif // TEXTURE_COOKER_H
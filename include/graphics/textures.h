@@ -23,17 +23,24 @@
 #include <stb_image.h>
 
 #include "graphics/core.h"
+#include "graphics/uniforms.h"
 
-void LoadTextureImage(
-    const char* filename, 
-    GLuint& numLoadedTextures, 
-    GLint wrappingMode
-);
-
+/* Loads the images in 'texturesDirPath' as textures: the one in the i-th file
+ * (see getFiles()) goes on texture unit numLoadedTextures + i, which
+ * LoadShadersFromFiles() gives to the sampler named after the file. Images
+ * that no sampler of the GPU program reads (location -1 in 'uniforms') are
+ * skipped and keep their unit empty.
+ *
+ * Each image is cooked once into "cache/textures": its mip chain, filtered
+ * on the CPU, BC1 compressed when it is large enough. Worker threads copy
+ * the mapped cache files into pixel buffers mapped by this thread, which
+ * then creates each texture from its buffer as soon as it is ready, with
+ * trilinear filtering. */
 void LoadTexturesFromFiles(
     const std::string& texturesDirPath, 
     GLuint& numLoadedTextures, 
-    GLint wrappingMode
+    GLint wrappingMode,
+    const UniformTable& uniforms
 );
 
 #endif // TEXTURES_H
\ No newline at end of file
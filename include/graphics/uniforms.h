@@ -0,0 +1,105 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+/* Uniforms of the GPU program set one by one, outside the uniform buffers:
+ * the texture samplers of "shader_fragment.glsl" */
+enum Uniform {
+    UNIFORM_GOLD_TEXTURE,
+    UNIFORM_GRASS_TEXTURE,
+    UNIFORM_LAVA_TEXTURE,
+    UNIFORM_STONEBRICK_TEXTURE,
+    UNIFORM_GALAXY_TEXTURE,
+    UNIFORM_GLOWSTONE_TEXTURE,
+    UNIFORM_WOOD_TEXTURE,
+    UNIFORM_DIAMOND_TEXTURE,
+    UNIFORM_CHEST_TEXTURE,
+    NUM_UNIFORMS
+};
+
+// Name of a uniform in the shaders
+const char* UniformName(Uniform uniform);
+
+// Sampler of the texture in 'textureFile', named after the file ("grass.png"
+// goes to "grass_texture"), or NUM_UNIFORMS if the shaders have none
+Uniform TextureUniform(const std::string& textureFile);
+
+/* Locations of the uniforms in the GPU program, -1 for the ones it does not
+ * use, resolved once by LoadShadersFromFiles() */
+using UniformTable = std::array<GLint, NUM_UNIFORMS>;
+
+// Locations of every uniform of the table in 'programId'
+UniformTable GetUniformLocations(GLuint programId);
+
+/* The FrameData uniform block, in std140 layout: set once per frame */
+struct FrameUniforms {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec4 cameraPosition = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+};
+
+/* The DrawData uniform block, in std140 layout: set before each draw call */
+struct DrawUniforms {
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 bboxMin = glm::vec4(0.0f);
+    glm::vec4 bboxMax = glm::vec4(0.0f);
+    glm::vec4 positionOffset = glm::vec4(0.0f); // Of the quantized positions (see VertexQuantization)
+    glm::vec4 positionScale = glm::vec4(1.0f);
+    int32_t objectId = 0;
+    int32_t interpolationType = 0;
+    int32_t instanced = 0;   // 1 to use the instance_model attribute instead of 'model'
+    int32_t padding = 0;
+};
+
+static_assert(sizeof(FrameUniforms) == 144, "FrameUniforms must match the std140 layout of FrameData");
+static_assert(sizeof(DrawUniforms) == 144, "DrawUniforms must match the std140 layout of DrawData");
+
+/* The uniform buffers of the GPU program. The draw data of a frame is
+ * gathered on the CPU, one slot per block: addDraw() only copies a block to
+ * the next slot, uploadDraws() sends the slots to the GPU with a single
+ * call, and bindDraw() binds the range of a slot for the next draw call. */
+class UniformBuffers {
+public:
+    UniformBuffers() = default;
+    UniformBuffers(const UniformBuffers&) = delete;
+    UniformBuffers& operator=(const UniformBuffers&) = delete;
+
+    // Create the buffers and bind the blocks of 'programId' to them. Called
+    // again when the program is reloaded.
+    void create(GLuint programId);
+    // Delete the buffers, while the context is still current: not left to a
+    // destructor, which for the Game runs after glfwTerminate()
+    void destroy();
+
+    // Upload the frame data and start a new set of draw slots
+    void beginFrame(const FrameUniforms& frame);
+
+    // Copy 'draw' to the next slot and return the slot
+    size_t addDraw(const DrawUniforms& draw);
+    // Upload every slot of the frame, orphaning the storage the draws made
+    // so far still read
+    void uploadDraws();
+    // Bind a slot uploaded by uploadDraws() for the next draw call
+    void bindDraw(size_t slot);
+
+    size_t getNumDraws() const { return numDraws; } // Slots since beginFrame()
+
+private:
+    GLuint frameBuffer = 0;
+    GLuint drawBuffer = 0;
+    size_t drawStride = 0; // sizeof(DrawUniforms), rounded up to the offset alignment
+    size_t numDraws = 0;
+    std::vector<uint8_t> drawData; // The slots of the frame, drawStride apart
+};
+
+#endif // UNIFORMS_H
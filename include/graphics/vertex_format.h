@@ -0,0 +1,66 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct MeshVertex;
+struct Mesh;
+
+/* Box the positions of a vertex buffer are quantized against: the vertex
+ * shader decodes them as offset + scale * position, with the position in
+ * [0, 1] ("position_offset" and "position_scale" in "shader_vertex.glsl") */
+struct VertexQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+/* Vertex as copied to the GPU: 16 bytes instead of the 40 of MeshVertex */
+struct PackedVertex {
+    uint16_t position[4]; // (location = 0) unsigned normalized, [3] is padding
+    uint32_t normal;      // (location = 1) GL_INT_2_10_10_10_REV, signed normalized
+    uint16_t texcoord[2]; // (location = 2) half floats
+};
+
+/* Vertex and index buffers of a mesh in the packed format. The indices
+ * are 16 bits wide when every vertex can be addressed with them. */
+struct PackedMesh {
+    VertexQuantization quantization;
+    std::vector<PackedVertex> vertices;
+    std::vector<uint8_t> indices;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t numIndices = 0;
+
+    size_t sizeInBytes() const { return vertices.size() * sizeof(PackedVertex) + indices.size(); }
+};
+
+// IEEE 754 half float closest to 'value'
+uint16_t FloatToHalf(float value);
+// Normal in GL_INT_2_10_10_10_REV, with w = 0
+uint32_t PackNormal(float x, float y, float z);
+
+// Quantization covering the box [boundsMin, boundsMax]
+VertexQuantization ComputeVertexQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+// Position quantized against 'quantization', in the units of PackedVertex::position
+void QuantizePosition(const float position[3], const VertexQuantization& quantization, uint16_t packed[3]);
+PackedVertex PackVertex(const MeshVertex& vertex, const VertexQuantization& quantization);
+
+// Index buffer with the smallest type able to address 'numVertices'
+// vertices: GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+void PackIndices(const uint32_t* indices, size_t numIndices, size_t numVertices, PackedMesh& packed);
+// Set the packed buffers of a mesh: its vertices quantized against its
+// bounds, and its indices
+void PackMesh(Mesh& mesh);
+
+// Size in bytes of one index of type 'indexType'
+size_t IndexSize(GLenum indexType);
+
+// Point the attributes of the bound vertex array at the PackedVertex array
+// bound to GL_ARRAY_BUFFER. Not in the headless build, which has no OpenGL.
+void SetPackedVertexAttributes(bool hasNormals, bool hasTexCoords);
+
+#endif // VERTEX_FORMAT_H
@@ -84,7 +84,7 @@ public:
     // Check if this AABB intersects a BSphere
     bool intersects(const BSphere& bsphere) const;
     // Check if a line segment starting at 'a' and ending at 'b' intersects the AABB
-    bool intersects(const glm::vec4& a, const glm::vec4 b) const;
+    bool intersectsSegment(const glm::vec4& a, const glm::vec4& b) const;
     // Check if a ray starting at 'origin' and going in direction 'dir' intersects the AABB
     bool intersects(const glm::vec4& origin, const glm::vec4& dir) const;
     // Check if a sphere with center 'center' and radius 'radius' intersects the AABB
@@ -201,7 +201,7 @@ public:
     // Check if this BSphere intersects an AABB
     bool intersects(const AABB& aabb) const;
     // Check if a line segment starting at 'a' and ending at 'b' intersects the BSphere
-    bool intersects(const glm::vec4& a, const glm::vec4 b) const;
+    bool intersectsSegment(const glm::vec4& a, const glm::vec4& b) const;
     // Check if a ray starting at 'origin' and going in direction 'dir' intersects the BSphere
     bool intersects(const glm::vec4& origin, const glm::vec4& dir) const;
     // Check if a sphere with center 'center' and radius 'radius' intersects the BSphere
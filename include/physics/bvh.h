@@ -0,0 +1,183 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "physics/bounding.h"
+
+/* Bounding Volume Hierarchy (BVH) over a fixed set of AABBs. The tree is built
+ * once (e.g. after the static level geometry has been loaded) and is stored as
+ * a flat array of nodes in depth-first order, so that queries are O(log n),
+ * cache friendly and do not allocate any memory. Leaves refer to primitives by
+ * their index in the vector passed to build(). */
+class StaticBVH {
+public:
+    // Default maximum number of primitives stored in a single leaf
+    static constexpr int defaultLeafSize = 4;
+    // Size of the traversal stack used by the queries (enough for any tree
+    // built by a median split over less than 2^32 primitives)
+    static constexpr int maxStackDepth = 64;
+
+    struct Node {
+        glm::vec3 min;
+        int32_t leftOrFirst; // Index of the left child (inner node) or of the first primitive (leaf)
+        glm::vec3 max;
+        int32_t count;       // Number of primitives (leaf) or 0 (inner node)
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    StaticBVH() = default;
+
+    // Build the hierarchy over the given bounding boxes. Leaves hold up to
+    // 'maxLeafSize' primitives, or more if their centroids all coincide.
+    void build(const std::vector<AABB>& bounds, int maxLeafSize = defaultLeafSize);
+
+    // Remove every node and primitive from the hierarchy
+    void clear();
+
+    bool empty() const { return primitives.empty(); }
+    size_t size() const { return primitives.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    const std::vector<Node>& getNodes() const { return nodes; }
+    // Index, in the vector passed to build(), of the primitive stored at
+    // 'position' in leaf order
+    int32_t getPrimitive(int32_t position) const { return primitives[position]; }
+
+    // Call 'visit(index)' for every primitive whose box overlaps [min, max].
+    // The traversal stops as soon as 'visit' returns true. Returns true if
+    // the traversal was stopped by the visitor.
+    template <typename Visitor>
+    bool query(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const;
+
+    // Same as above, for an AABB
+    template <typename Visitor>
+    bool query(const AABB& aabb, Visitor&& visit) const {
+        return query(glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()), visit);
+    }
+
+    // Call 'visit(first, count)' for every leaf whose box overlaps [min, max],
+    // where the leaf holds the primitives at positions [first, first + count)
+    // in leaf order. Lets the caller test a whole leaf at once (see
+    // CollisionWorld). Early exit as in query().
+    template <typename Visitor>
+    bool queryLeaves(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const;
+
+    // Call 'visit(index)' for every primitive whose box is crossed by the
+    // segment 'origin + t * dir', with t in [0, 1]. Early exit as in query().
+    template <typename Visitor>
+    bool querySegment(const glm::vec4& origin, const glm::vec4& dir, Visitor&& visit) const;
+
+private:
+    std::vector<Node> nodes;         // Flat node array, root at index 0
+    std::vector<int32_t> primitives; // Primitive indices, grouped by leaf
+    std::vector<glm::vec3> primMin;  // Primitive boxes in leaf order
+    std::vector<glm::vec3> primMax;
+
+    static bool overlaps(const glm::vec3& aMin, const glm::vec3& aMax,
+                         const glm::vec3& bMin, const glm::vec3& bMax) {
+        return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+               aMin.y <= bMax.y && aMax.y >= bMin.y &&
+               aMin.z <= bMax.z && aMax.z >= bMin.z;
+    }
+
+    // Slab test of the segment 'origin + t * dir', t in [0, 1], against a box
+    static bool segmentOverlaps(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& invDir,
+                                const glm::vec3& min, const glm::vec3& max);
+};
+
+template <typename Visitor>
+bool StaticBVH::query(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    int32_t stack[maxStackDepth];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max, min, max)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            for (int32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                if (overlaps(primMin[i], primMax[i], min, max) && visit(primitives[i])) {
+                    return true;
+                }
+            }
+        } else {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+    return false;
+}
+
+template <typename Visitor>
+bool StaticBVH::queryLeaves(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    int32_t stack[maxStackDepth];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max, min, max)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            if (visit(node.leftOrFirst, node.count)) {
+                return true;
+            }
+        } else {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+    return false;
+}
+
+template <typename Visitor>
+bool StaticBVH::querySegment(const glm::vec4& origin, const glm::vec4& dir, Visitor&& visit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const glm::vec3 o(origin);
+    const glm::vec3 d(dir);
+    const glm::vec3 invDir = 1.0f / d;
+
+    int32_t stack[maxStackDepth];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!segmentOverlaps(o, d, invDir, node.min, node.max)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            for (int32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                if (segmentOverlaps(o, d, invDir, primMin[i], primMax[i]) && visit(primitives[i])) {
+                    return true;
+                }
+            }
+        } else {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+    return false;
+}
+
+#endif // BVH_H
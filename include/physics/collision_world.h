@@ -0,0 +1,131 @@
+#ifndef COLLISION_WORLD_H
+#define COLLISION_WORLD_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+
+#include "physics/bounding.h"
+
+// Instruction set used by the batch kernels, chosen at compile time
+// (e.g. -mavx2, or COWQUEST_ENABLE_AVX2 in CMake)
+#if defined(__AVX2__)
+#define COWQUEST_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COWQUEST_SIMD_SSE2 1
+#endif
+
+/* Bounding volume tested against the objects of a CollisionWorld. Like a
+ * GameObject, it is either a box or a sphere. */
+struct CollisionQuery {
+    bool useSphere;
+    glm::vec3 min;     // Box
+    glm::vec3 max;
+    glm::vec3 center;  // Sphere
+    float radius;
+
+    static CollisionQuery box(const glm::vec3& min, const glm::vec3& max) {
+        return {false, min, max, glm::vec3(0.0f), 0.0f};
+    }
+    static CollisionQuery box(const AABB& aabb) {
+        return box(glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()));
+    }
+    static CollisionQuery sphere(const glm::vec3& center, float radius) {
+        return {true, glm::vec3(0.0f), glm::vec3(0.0f), center, radius};
+    }
+    static CollisionQuery sphere(const BSphere& bsphere) {
+        return sphere(glm::vec3(bsphere.getCenter()), bsphere.getRadius());
+    }
+};
+
+/* Bounding volumes stored as a structure of arrays (one array per coordinate),
+ * so that one query can be tested against many objects at once with SIMD
+ * instructions: 8 objects per AVX2 instruction or 4 per SSE2 instruction. A
+ * batch of 'batchSize' objects yields a bitmask with one bit per object. The
+ * arrays are padded with empty boxes, so a batch may start at any index and
+ * run past the last object.
+ *
+ * Box-box and box-sphere tests give the same results as GameObject::intersects;
+ * sphere-sphere tests compare squared distances, without the square root. */
+class CollisionWorld {
+public:
+    // Number of objects tested by a single call to testRange()
+    static constexpr size_t batchSize = 16;
+
+    CollisionWorld();
+
+    // Add an object and return its index. 'useSphere' tells which of its two
+    // bounding volumes is tested, as in GameObject.
+    size_t add(const AABB& aabb, const BSphere& bsphere, bool useSphere);
+    void set(size_t index, const AABB& aabb, const BSphere& bsphere, bool useSphere);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Bitmask of the objects in [first, first + n) that overlap 'query', where
+    // bit i stands for object first + i and n <= batchSize. Uses the widest
+    // instruction set available.
+    uint32_t testRange(const CollisionQuery& query, size_t first, size_t n = batchSize) const;
+    // Same result as testRange(), one object at a time
+    uint32_t testRangeScalar(const CollisionQuery& query, size_t first, size_t n = batchSize) const;
+
+    // Call 'visit(index)' for every object that overlaps 'query'. The walk
+    // stops as soon as 'visit' returns true. Returns true if it was stopped.
+    template <typename Visitor>
+    bool forEachOverlap(const CollisionQuery& query, Visitor&& visit) const;
+
+    // Name of the instruction set used by testRange()
+    static const char* simdPath();
+
+    // Index of the lowest set bit of a nonzero mask
+    static uint32_t lowestBit(uint32_t mask) {
+#if defined(__GNUC__)
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#else
+        uint32_t bit = 0;
+        while (!(mask & 1u)) {
+            mask >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+private:
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<int32_t> sphereMask; // -1 for objects tested with their sphere, 0 for boxes
+    size_t count;
+
+    // Keep 'batchSize' empty boxes after the last object
+    void resizeArrays(size_t numObjects);
+    void setPadding(size_t index);
+
+    uint32_t testLanesScalar(const CollisionQuery& query, size_t first, size_t n) const;
+#if defined(COWQUEST_SIMD_AVX2)
+    uint32_t testLanesAVX2(const CollisionQuery& query, size_t first) const;
+#elif defined(COWQUEST_SIMD_SSE2)
+    uint32_t testLanesSSE2(const CollisionQuery& query, size_t first) const;
+#endif
+};
+
+template <typename Visitor>
+bool CollisionWorld::forEachOverlap(const CollisionQuery& query, Visitor&& visit) const {
+    for (size_t first = 0; first < count; first += batchSize) {
+        uint32_t mask = testRange(query, first);
+        while (mask) {
+            uint32_t bit = lowestBit(mask);
+            mask &= mask - 1;
+            if (first + bit < count && visit(first + bit)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#endif // COLLISION_WORLD_H
@@ -2,6 +2,7 @@
 #define COLLISIONS_H
 
 #include <map>
+#include <string>
 #include <vector>
 
 #include <glad/glad.h>
@@ -13,13 +14,95 @@
 
 #include "graphics/objmodel.h"
 #include "core/gameobject.h"
+#include "core/virtual_scene.h"
 #include "utils/math_utils.h"
 #include "physics/bounding.h"
+#include "physics/bvh.h"
+#include "physics/collision_world.h"
+#include "physics/dynamic_tree.h"
+#include "physics/sweep_and_prune.h"
+
+/* Static objects of the scene (maze, chests, ...) indexed by a BVH. It is built
+ * once after loading, so that the per-frame collision queries of moving objects
+ * cost O(log n) instead of a walk over the whole VirtualScene. The boxes are
+ * also stored in a CollisionWorld in BVH leaf order, so each leaf reached by a
+ * query is tested with a single SIMD batch. The objects are pointers into the
+ * VirtualScene, which must not create or destroy objects afterwards. */
+struct StaticCollisionScene {
+    StaticBVH bvh;
+    CollisionWorld world;                   // Object boxes in BVH leaf order
+    std::vector<const GameObject*> objects; // Indexed by the BVH primitive indices
+};
+
+// Build the static collision scene from every object of the virtual scene,
+// except 'dynamicObjects', taking them in name order so that the BVH does not
+// depend on the order the objects were loaded in
+void buildStaticCollisionScene(
+    StaticCollisionScene& staticScene,
+    const VirtualScene& virtualScene,
+    const std::vector<ObjectHandle>& dynamicObjects
+);
+
+// Earliest contact found by a swept (continuous) collision query
+struct SweepHit {
+    float time;               // Fraction of the displacement done before the contact, in [0, 1]
+    glm::vec3 normal;         // Normal of the face that was hit, pointing towards the moving box
+    const GameObject* object; // Object that was hit
+};
+
+// Maximum number of slides done by moveAndSlide() in a single call
+constexpr int maxSlideIterations = 4;
+// Gap kept between a moving box and the face it stopped at, so that it does
+// not start the next movement touching (or slightly inside) that face
+constexpr float collisionSkin = 1e-3f;
+
+// Time of impact of the box [min, max] moving by 'displacement' against the
+// box [otherMin, otherMax]. Returns false if the boxes do not meet during the
+// movement, or if they already overlap at its start (so that a box that ends
+// up inside another one can always get out).
+bool sweepAABB(
+    const glm::vec3& min,
+    const glm::vec3& max,
+    const glm::vec3& displacement,
+    const glm::vec3& otherMin,
+    const glm::vec3& otherMax,
+    float& time,
+    glm::vec3& normal
+);
+
+// Sweep the box [min, max] by 'displacement' against the static objects and
+// the objects of the dynamic tree (except 'movingObject' and 'ignoredObject').
+// Returns true and the earliest contact in 'hit' if there is one.
+bool sweepObjects(
+    const glm::vec3& min,
+    const glm::vec3& max,
+    const glm::vec3& displacement,
+    const StaticCollisionScene& staticScene,
+    const DynamicAABBTree& dynamicTree,
+    const GameObject* movingObject,
+    const GameObject* ignoredObject,
+    SweepHit& hit
+);
+
+// Move an object by 'displacement', stopping at the first object on its way
+// and sliding along the face that was hit with the rest of the movement, up
+// to maxSlideIterations times. The sweep cannot tunnel through thin objects,
+// however large the displacement. Returns the displacement actually done.
+glm::vec3 moveAndSlide(
+    GameObject* movingObject,
+    const glm::vec3& displacement,
+    const StaticCollisionScene& staticScene,
+    const DynamicAABBTree& dynamicTree,
+    const GameObject* ignoredObject=nullptr
+);
 
 void resolveCollision(GameObject& obj1, GameObject& obj2);
+// Resolve the collisions among 'objects', finding the candidate pairs with a
+// sweep-and-prune broadphase. Keeping 'broadphase' alive between calls lets it
+// reuse the endpoint order of the last call.
+void resolveCollisions(std::vector<GameObject>& objects, SweepAndPrune& broadphase);
 void resolveCollisions(std::vector<GameObject>& objects);
-void resolveCollisionsWithStaticObjects(GameObject* movingObject, const VirtualScene& staticObjects);
-bool checkCollisionWithStaticObjects(GameObject* movingObject, const VirtualScene& staticObjects);
+void resolveCollisionsWithStaticObjects(GameObject* movingObject, const StaticCollisionScene& staticScene);
 
 bool checkCollisionRaySphere(
     const glm::vec4& origin, 
@@ -32,4 +115,9 @@ bool checkCollisionRayAABB(
     const glm::vec4& dir, 
     const AABB& aabb
 );
+bool checkCollisionSegmentAABB(
+    const glm::vec4& a,
+    const glm::vec4& b,
+    const AABB& aabb
+);
 #endif // COLLISIONS_H
\ No newline at end of file
@@ -0,0 +1,177 @@
+#ifndef DYNAMIC_TREE_H
+#define DYNAMIC_TREE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "physics/bounding.h"
+#include "physics/bvh.h"
+
+/* Dynamic AABB tree for objects that move every frame (player, cow, chest lids).
+ * Each proxy is stored in a leaf with a fattened AABB, so that small movements
+ * only need to check if the object is still inside its fat box. Objects that
+ * leave their box are removed and reinserted, and the ancestors are refit and
+ * rebalanced with tree rotations, so nothing is ever rebuilt from scratch.
+ * Proxy ids are node indices and stay valid until destroyProxy() is called. */
+class DynamicAABBTree {
+public:
+    static constexpr int32_t nullNode = -1;
+    // Distance added to every side of a leaf AABB
+    static constexpr float aabbMargin = 0.25f;
+    // Multiple of the last displacement added in the direction of movement
+    static constexpr float displacementMultiplier = 2.0f;
+
+    struct Node {
+        glm::vec3 min;   // Fat AABB
+        glm::vec3 max;
+        void* userData;
+        int32_t parent;  // Parent node, or next free node when in the free list
+        int32_t child1;
+        int32_t child2;
+        int32_t height;  // 0 for leaves, -1 for free nodes
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    DynamicAABBTree();
+
+    // Create a proxy for 'aabb'. Returns the proxy id.
+    int32_t createProxy(const AABB& aabb, void* userData);
+    // Destroy a proxy created with createProxy()
+    void destroyProxy(int32_t proxyId);
+    // Update the proxy after its object moved by 'displacement' and now has the
+    // box 'aabb'. Returns true if the proxy had to be reinserted.
+    bool moveProxy(int32_t proxyId, const AABB& aabb, const glm::vec3& displacement);
+
+    void* getUserData(int32_t proxyId) const { return nodes[proxyId].userData; }
+    void setUserData(int32_t proxyId, void* userData) { nodes[proxyId].userData = userData; }
+    AABB getFatAABB(int32_t proxyId) const {
+        return AABB(glm::vec4(nodes[proxyId].min, 1.0f), glm::vec4(nodes[proxyId].max, 1.0f));
+    }
+
+    size_t getProxyCount() const { return proxyCount; }
+    // Height of the tree (0 when it has a single leaf, -1 when empty)
+    int32_t getHeight() const { return root == nullNode ? -1 : nodes[root].height; }
+
+    // Call 'visit(proxyId)' for every proxy whose fat AABB overlaps [min, max].
+    // The traversal stops as soon as 'visit' returns true. Returns true if
+    // the traversal was stopped by the visitor.
+    template <typename Visitor>
+    bool query(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const;
+
+    template <typename Visitor>
+    bool query(const AABB& aabb, Visitor&& visit) const {
+        return query(glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()), visit);
+    }
+
+    // Call 'visit(proxyA, proxyB)' once for every pair of proxies whose fat
+    // AABBs overlap (with proxyA < proxyB)
+    template <typename Visitor>
+    void queryPairs(Visitor&& visit) const;
+
+    // Call 'visit(proxyId, staticIndex)' for every proxy whose fat AABB
+    // overlaps a primitive of the static BVH
+    template <typename Visitor>
+    void queryStaticPairs(const StaticBVH& bvh, Visitor&& visit) const;
+
+private:
+    std::vector<Node> nodes;
+    int32_t root;
+    int32_t freeList;
+    size_t proxyCount;
+
+    int32_t allocateNode();
+    void freeNode(int32_t nodeId);
+
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+
+    // Perform a left or right rotation if node A is imbalanced. Returns the
+    // new root of the subtree.
+    int32_t balance(int32_t iA);
+
+    // Refit and rebalance every ancestor of 'index', starting at 'index'
+    void fixUpwards(int32_t index);
+
+    static bool overlaps(const glm::vec3& aMin, const glm::vec3& aMax,
+                         const glm::vec3& bMin, const glm::vec3& bMax) {
+        return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+               aMin.y <= bMax.y && aMax.y >= bMin.y &&
+               aMin.z <= bMax.z && aMax.z >= bMin.z;
+    }
+
+    static float area(const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+template <typename Visitor>
+bool DynamicAABBTree::query(const glm::vec3& min, const glm::vec3& max, Visitor&& visit) const {
+    if (root == nullNode) {
+        return false;
+    }
+
+    // The tree is kept balanced, so its height is logarithmic in the number of
+    // proxies; fall back to the heap only for absurdly deep trees.
+    int32_t fixedStack[128];
+    std::vector<int32_t> heapStack;
+    int32_t* stack = fixedStack;
+    if (nodes[root].height + 2 > 128) {
+        heapStack.resize(nodes[root].height + 2);
+        stack = heapStack.data();
+    }
+
+    int top = 0;
+    stack[top++] = root;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max, min, max)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            if (visit(static_cast<int32_t>(&node - nodes.data()))) {
+                return true;
+            }
+        } else {
+            stack[top++] = node.child1;
+            stack[top++] = node.child2;
+        }
+    }
+    return false;
+}
+
+template <typename Visitor>
+void DynamicAABBTree::queryPairs(Visitor&& visit) const {
+    for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i) {
+        if (nodes[i].height != 0) {
+            continue; // Inner or free node
+        }
+        query(nodes[i].min, nodes[i].max, [&](int32_t other) {
+            if (other > i) {
+                visit(i, other);
+            }
+            return false;
+        });
+    }
+}
+
+template <typename Visitor>
+void DynamicAABBTree::queryStaticPairs(const StaticBVH& bvh, Visitor&& visit) const {
+    for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i) {
+        if (nodes[i].height != 0) {
+            continue;
+        }
+        bvh.query(nodes[i].min, nodes[i].max, [&](int staticIndex) {
+            visit(i, staticIndex);
+            return false;
+        });
+    }
+}
+
+#endif // DYNAMIC_TREE_H
@@ -0,0 +1,89 @@
+#ifndef SWEEP_AND_PRUNE_H
+#define SWEEP_AND_PRUNE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+
+#include "physics/bounding.h"
+
+// Pair of overlapping boxes, identified by their indices (a < b)
+struct CollisionPair {
+    uint32_t a;
+    uint32_t b;
+};
+
+/* Sort-and-sweep broadphase for many moving boxes. The box endpoints along the
+ * sweep axis are kept in a persistent sorted array; since objects move little
+ * between frames, the array is almost sorted and insertion sort restores the
+ * order in nearly linear time. The sweep then reports every pair of boxes that
+ * overlap on all three axes. */
+class SweepAndPrune {
+public:
+    SweepAndPrune() = default;
+
+    // Set the number of boxes. Changing it resets the endpoint order and
+    // chooses the sweep axis again on the next findPairs().
+    void resize(size_t numBoxes);
+    size_t size() const { return minX.size(); }
+
+    // Set the bounds of box 'index'
+    void setBox(size_t index, const glm::vec3& min, const glm::vec3& max) {
+        minX[index] = min.x; minY[index] = min.y; minZ[index] = min.z;
+        maxX[index] = max.x; maxY[index] = max.y; maxZ[index] = max.z;
+    }
+    void setBox(size_t index, const AABB& aabb) {
+        setBox(index, glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()));
+    }
+
+    // Sort the endpoints and sweep them. The returned list is sorted by (a, b)
+    // and stays valid until the next call.
+    const std::vector<CollisionPair>& findPairs();
+
+    int getSweepAxis() const { return axis; }
+    // Number of endpoint swaps done by the insertion sort in the last findPairs()
+    size_t getLastSwapCount() const { return lastSwapCount; }
+
+private:
+    // Endpoint of a box along the sweep axis. 'box' holds the box index in the
+    // upper bits and a flag telling if it is a maximum in the lowest bit.
+    struct Endpoint {
+        float value;
+        uint32_t box;
+
+        uint32_t index() const { return box >> 1; }
+        bool isMax() const { return box & 1u; }
+    };
+
+    // Box open during the sweep, with its bounds on the two other axes copied
+    // next to it so that the inner loop of the sweep reads contiguous memory
+    struct ActiveBox {
+        uint32_t index;
+        float minU, maxU;
+        float minV, maxV;
+    };
+
+    // Box bounds, one array per coordinate
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    std::vector<Endpoint> endpoints;      // Sorted along 'axis'
+    std::vector<ActiveBox> active;        // Boxes whose interval contains the sweep position
+    std::vector<uint32_t> activePosition; // Position of each box in 'active'
+    std::vector<uint32_t> candidates;     // Scratch buffer of the sweep
+    std::vector<CollisionPair> pairs;
+
+    int axis = 0;
+    bool needsReset = true;
+    size_t lastSwapCount = 0;
+
+    const std::vector<float>& minOf(int a) const { return a == 0 ? minX : (a == 1 ? minY : minZ); }
+    const std::vector<float>& maxOf(int a) const { return a == 0 ? maxX : (a == 1 ? maxY : maxZ); }
+
+    // Choose the axis with the largest spread of box centers and rebuild the endpoints
+    void reset();
+};
+
+#endif // SWEEP_AND_PRUNE_H
@@ -1,10 +1,63 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 
 std::vector<std::string> getFiles(const std::string& folderPath);
 
+/* Size and modification time of the source of a cache file, stored in the
+ * cache file to tell when the source changed */
+struct SourceInfo {
+    uint64_t size;
+    int64_t time;
+};
+
+bool getSourceInfo(const std::string& path, SourceInfo& info);
+
+// FNV-1a hash of the contents of a file
+uint64_t hashFile(const std::string& path);
+
+// Overwrite 'size' bytes at 'offset' of the existing file at 'path'.
+// Returns false if the file cannot be opened or written.
+bool patchFile(const std::string& path, uint64_t offset, const void* data, size_t size);
+
+// Path of a temporary file next to 'path', to write before renaming it over
+// 'path'. Unique to the process and the call, so that two processes (or
+// threads) writing the same file never truncate each other's.
+std::string makeTempPath(const std::string& path);
+
+/* Read-only memory mapping of a whole file. The pages are loaded by the
+ * system on first access, so nothing is copied or parsed up front. */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map the file at 'path'. Returns false if it does not exist, is empty
+    // or cannot be mapped.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return mappedData != nullptr; }
+    const uint8_t* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+
+private:
+    const uint8_t* mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;    // HANDLE
+    void* mappingHandle = nullptr; // HANDLE
+#endif
+};
+
 #endif // FILE_UTILS_H
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads running jobs in submission order. Used for
+ * the CPU work done while loading (parsing and processing models), never by
+ * code that touches the OpenGL context. */
+class ThreadPool {
+public:
+    // Start 'numThreads' workers (defaultThreadCount() when 0)
+    explicit ThreadPool(unsigned numThreads = 0);
+    // Finish the jobs already submitted and stop the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a job. Jobs must not throw.
+    void submit(std::function<void()> job);
+    // Block until every submitted job has finished
+    void wait();
+
+    // Call job(i) for i in [0, count), spread over the workers, and wait
+    void parallelFor(size_t count, const std::function<void(size_t)>& job);
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // One worker per hardware thread
+    static unsigned defaultThreadCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    size_t numPending = 0; // Jobs queued or running
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+#endif // THREAD_POOL_H
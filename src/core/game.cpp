@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
 #include <cmath>
 #include <iostream>
 #include <string>
@@ -20,12 +22,14 @@
 #include "graphics/shaders.h"
 #include "graphics/core.h"
 #include "graphics/textures.h"
+#include "graphics/meshlets.h"
 #include "physics/bounding.h"
 #include "physics/collisions.h"
 #include "physics/animations.h"
 #include "utils/file_utils.h"
 #include "utils/textrendering.h"
 
+#include "core/scene.h"
 #include "core/game.h"
 
 void Game::createWindow(const std::string& title, int width, int height) {
@@ -65,110 +69,53 @@ void Game::keyCallback(int key, int scancode, int actions, int mods) {
     if (key == GLFW_KEY_ESCAPE && actions == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
-    if (actions == GLFW_PRESS || actions == GLFW_REPEAT) {
-        if (mods & GLFW_MOD_SHIFT) {
-            currentSpeed = baseSpeed * speedMultiplier;
-        } else {
-            currentSpeed = baseSpeed;
-        }
 
-        if (key == GLFW_KEY_W) {
-            float speed;
-            if (actions == GLFW_REPEAT) {
-                speed = currentSpeed * deltaTime;
-            } else {
-                speed = deltaTime;
-            }
-            glm::vec4 offset = speed * cameraView;
-            offset.y = 0;
-            cameraPosition += offset;
-            virtualScene["Cube"]->translate(offset.x, offset.y, offset.z);
-            if (checkCollisionWithStaticObjects(virtualScene["Cube"], virtualScene)) {
-                cameraPosition -= offset;
-                virtualScene["Cube"]->translate(-offset.x, -offset.y, -offset.z);
-            }
+    // Movement keys are held states, read by every simulation tick, so that
+    // the speed does not depend on the key repeat rate of the system
+    if (actions == GLFW_PRESS || actions == GLFW_RELEASE) {
+        bool pressed = actions == GLFW_PRESS;
+        switch (key) {
+            case GLFW_KEY_W: input.moveForward = pressed; break;
+            case GLFW_KEY_S: input.moveBackward = pressed; break;
+            case GLFW_KEY_A: input.moveLeft = pressed; break;
+            case GLFW_KEY_D: input.moveRight = pressed; break;
+            case GLFW_KEY_LEFT_SHIFT:
+            case GLFW_KEY_RIGHT_SHIFT: input.sprint = pressed; break;
+            default: break;
         }
-        if (key == GLFW_KEY_S) {
-            float speed;
-            if (actions == GLFW_REPEAT) {
-                speed = currentSpeed * deltaTime;
-            } else {
-                speed = deltaTime;
-            }
-            glm::vec4 offset = -speed * cameraView;
-            offset.y = 0;
-            cameraPosition += offset;
-            virtualScene["Cube"]->translate(offset.x, offset.y, offset.z);
-            if (checkCollisionWithStaticObjects(virtualScene["Cube"], virtualScene)) {
-                cameraPosition -= offset;
-                virtualScene["Cube"]->translate(-offset.x, -offset.y, -offset.z);
-            }
-        }
-        if (key == GLFW_KEY_A) {
-            float speed;
-            if (actions == GLFW_REPEAT) {
-                speed = currentSpeed * deltaTime;
+    }
+
+    if (actions == GLFW_PRESS) {
+        // F11 key toggles full screen
+        if (key == GLFW_KEY_F11) {
+            fullScreen = !fullScreen;
+            if (fullScreen) {
+                glfwSetWindowMonitor(window, glfwGetPrimaryMonitor(), 0, 0,
+                                    screenWidth, screenHeight, GLFW_DONT_CARE);
             } else {
-                speed = deltaTime;
-            }
-            glm::vec4 offset = -speed * cameraRight;
-            offset.y = 0;
-            cameraPosition += offset;
-            virtualScene["Cube"]->translate(offset.x, offset.y, offset.z);
-            if (checkCollisionWithStaticObjects(virtualScene["Cube"], virtualScene)) {
-                cameraPosition -= offset;
-                virtualScene["Cube"]->translate(-offset.x, -offset.y, -offset.z);
+                glfwSetWindowMonitor(window, nullptr, windowX, windowY,
+                                    windowWidth, windowHeight, GLFW_DONT_CARE);
             }
         }
-        if (key == GLFW_KEY_D) {
-            float speed;
-            if (actions == GLFW_REPEAT) {
-                speed = currentSpeed * deltaTime;
-            } else {
-                speed = deltaTime;
-            }
-            glm::vec4 offset = speed * cameraRight;
-            offset.y = 0;
-            cameraPosition += offset;
-            virtualScene["Cube"]->translate(offset.x, offset.y, offset.z);
-            if (checkCollisionWithStaticObjects(virtualScene["Cube"], virtualScene)) {
-                cameraPosition -= offset;
-                virtualScene["Cube"]->translate(-offset.x, -offset.y, -offset.z);
-            }
+
+        // F3 key shows how many objects the view frustum culls
+        if (key == GLFW_KEY_F3) {
+            showCullingStats = !showCullingStats;
         }
 
-        if (actions == GLFW_PRESS) {
-            // F11 key toggles full screen
-            if (key == GLFW_KEY_F11) {
-                fullScreen = !fullScreen;
-                if (fullScreen) {
-                    glfwSetWindowMonitor(window, glfwGetPrimaryMonitor(), 0, 0,
-                                        screenWidth, screenHeight, GLFW_DONT_CARE);
-                } else {
-                    glfwSetWindowMonitor(window, nullptr, windowX, windowY,
-                                        windowWidth, windowHeight, GLFW_DONT_CARE);
-                }
-            }
+        // F4 key turns the occlusion culling on and off
+        if (key == GLFW_KEY_F4) {
+            occlusionCulling = !occlusionCulling;
+        }
 
-            // L key toggles look at mode
-            if (key == GLFW_KEY_L) {
-                lookAtMode = !lookAtMode;
-                cameraLookAt = cowPosition;
-                distanceCameraCow = glm::distance(cameraPosition, cowPosition);
-            }
+        // L key toggles look at mode
+        if (key == GLFW_KEY_L) {
+            input.toggleLookAt = true;
+        }
 
-            // Space key opens the chest (if the player is close enough)
-            if (key == GLFW_KEY_SPACE) {
-                for (int i = 0; i < chestCoordinates.size(); i++) {
-                    if (glm::distance(glm::vec3(cameraPosition), chestCoordinates[i]) < 5.0f) {
-                        chestOpened[i] = true;
-                        if (playerLife < maxLife) {
-                            playerLife++;
-                        }
-                        timeStarving = 0.0f;
-                    }
-                }
-            }
+        // Space key opens the chest (if the player is close enough)
+        if (key == GLFW_KEY_SPACE) {
+            input.openChest = true;
         }
     }
 }
@@ -206,110 +153,198 @@ void Game::cursorPosCallback(double xpos, double ypos) {
     if (cameraYaw > 2 * M_PI) cameraYaw -= 2 * M_PI;
     if (cameraYaw < 0) cameraYaw += 2 * M_PI;
 
-    if (lookAtMode && distanceCameraCow < distanceCameraCowThreshold) {
-        cameraView = normalize(cowPosition - cameraPosition);
-    } else {
-        // Compute new camera view direction
-        double viewX = std::cos(cameraPitch) * std::sin(cameraYaw);
-        double viewY = std::sin(cameraPitch);
-        double viewZ = std::cos(cameraPitch) * std::cos(cameraYaw);
-
-        // Update camera view vector and look at point
-        cameraView = glm::vec4(viewX, viewY, viewZ, 0.0f);
-        cameraLookAt = cameraPosition + cameraView;
-    }
-    // Recompute camera right and up vector
-    cameraRight = normalize(crossproduct(cameraView, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)));
-    cameraUp = normalize(crossproduct(cameraRight, cameraView));
+    input.cameraYaw = cameraYaw;
+    input.cameraPitch = cameraPitch;
 }
 
 void Game::framebufferSizeCallback(int width, int height) {
     glViewport(0, 0, width, height);
     screenRatio = (float)width / height;
+    framebufferHeight = height;
+}
+
+void Game::updateCamera(const SimulationState& state) {
+    cameraPosition = state.playerPosition;
+    if (simulation.isLookingAtCow(state)) {
+        cameraView = normalize(state.cowPosition - cameraPosition);
+    } else {
+        cameraView = Simulation::viewDirection(cameraYaw, cameraPitch);
+    }
+    // Recompute camera right and up vector
+    cameraRight = normalize(crossproduct(cameraView, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)));
+    cameraUp = normalize(crossproduct(cameraRight, cameraView));
 }
 
 void Game::setCameraView() {
-    glm::mat4 view = Matrix_Camera_View(cameraPosition, cameraView, cameraUp);
-    glUniformMatrix4fv(uniforms.at("view"), 1, GL_FALSE, glm::value_ptr(view));
+    viewMatrix = Matrix_Camera_View(cameraPosition, cameraView, cameraUp);
 }
 
 void Game::setProjection() {
-    glm::mat4 projection = Matrix_Perspective(fov, screenRatio, nearPlane, farPlane);
-    glUniformMatrix4fv(uniforms.at("projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    projectionMatrix = Matrix_Perspective(fov, screenRatio, nearPlane, farPlane);
 }
 
-void Game::createModel(const std::string& objFilePath, glm::mat4 model) {
-    if (objFilePath.find("maze") != std::string::npos) {
-        const std::string& mazeModelFolder = objFilePath;
+void Game::createModel(const std::string& objFilePath, const glm::mat4& model, const Mesh& mesh) {
+    printf("Creating model: %s\n", objFilePath.c_str());
 
-        std::vector<std::string> mazeModelFiles = getFiles(mazeModelFolder);
-
-        for (const auto& mazeModelFile : mazeModelFiles) {
-            std::string mazeModelFilePath = mazeModelFolder + mazeModelFile;
-            ObjModel mazeModel(mazeModelFilePath.c_str());
-
-            ComputeNormals(&mazeModel);
-            BuildSceneTriangles(virtualScene, &mazeModel, Matrix_Identity());
-        }
+    // The maze pieces are static and share their material, so they go to
+    // the maze batch instead of having buffers of their own
+    bool isMazePart = true;
+    for (const MeshShape& shape : mesh.shapes) {
+        isMazePart = isMazePart && shape.name.find("maze") != std::string::npos;
     }
-    else {
-        ObjModel objModel(objFilePath.c_str());
-        ComputeNormals(&objModel);
-
-        printf("Creating model: %s\n", objFilePath.c_str());
 
-        if (objFilePath.find("cow") != std::string::npos) {
-            BuildSceneTriangles(virtualScene, &objModel, model, true);
-        } else {
-            BuildSceneTriangles(virtualScene, &objModel, model);
-        }
+    if (isMazePart && !mesh.shapes.empty()) {
+        mazeBatch.add(virtualScene, mesh, model);
+    } else if (objFilePath.find("chest_lid") != std::string::npos) {
+        chestLids.upload(virtualScene, mesh, model);
+    } else if (objFilePath.find("chest") != std::string::npos) {
+        chestBases.upload(virtualScene, mesh, model);
+    } else if (objFilePath.find("cow") != std::string::npos) {
+        BuildSceneTriangles(virtualScene, mesh, model, true);
+        cowModelBounds = AABB(mesh.boundsMin, mesh.boundsMax);
+    } else {
+        BuildSceneTriangles(virtualScene, mesh, model);
     }
 }
 
 void Game::drawCow(glm::mat4 model) {
-    glUniformMatrix4fv(uniforms.at("model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniform1i(uniforms.at("object_id"), COW);
-    glUniform1i(uniforms.at("interpolation_type"), GOURAUD_INTERPOLATION);
-    DrawVirtualObject(const_cast<UniformMap&>(uniforms), virtualScene, "the_cow");
+    DrawPacket packet;
+    packet.programId = gpuProgramId;
+    packet.uniforms.model = model;
+    packet.uniforms.objectId = COW;
+    packet.uniforms.interpolationType = GOURAUD_INTERPOLATION;
+
+    // Pixels covered by one model space unit at the distance of the cow
+    float scale = glm::length(glm::vec3(model[0]));
+    float distance = std::max(norm(model[3] - cameraPosition), -nearPlane);
+    float pixelsPerUnit = scale * framebufferHeight / (2.0f * std::tan(fov / 2.0f) * distance);
+    const GameObject& cow = *virtualScene.get(cowObject);
+    const SceneObject& sceneObject = cow.getSceneObject();
+    cowLod = SelectLod(sceneObject, pixelsPerUnit, cowLod);
+
+    // At full detail, only the meshlets in the view frustum and facing the
+    // camera are drawn
+    if (cowLod == 0 && !sceneObject.meshlets.empty()) {
+        ViewFrustum modelFrustum = ViewFrustum::fromMatrix(projectionMatrix * viewMatrix * model);
+        glm::vec3 modelCamera = glm::vec3(glm::inverse(model) * cameraPosition);
+        visibleMeshlets.clear();
+        cullingStats.trianglesCulled += CullMeshlets(sceneObject.meshlets.data(), sceneObject.meshlets.size(),
+                                                     modelFrustum, modelCamera, visibleMeshlets);
+        DrawVirtualObjectMeshlets(renderQueue, packet, cow, visibleMeshlets);
+        return;
+    }
+
+    DrawVirtualObject(renderQueue, packet, cow, cowLod);
 }
 
 void Game::drawPlane(glm::mat4 model) {
-    glUniformMatrix4fv(uniforms.at("model"), 1 , GL_FALSE , glm::value_ptr(model));
-    glUniform1i(uniforms.at("object_id"), PLANE);
-    glUniform1i(uniforms.at("interpolation_type"), PHONG_INTERPOLATION);
-    DrawVirtualObject(const_cast<UniformMap&>(uniforms), virtualScene, "the_plane");
+    DrawPacket packet;
+    packet.programId = gpuProgramId;
+    packet.uniforms.model = model;
+    packet.uniforms.objectId = PLANE;
+    packet.uniforms.interpolationType = PHONG_INTERPOLATION;
+    DrawVirtualObject(renderQueue, packet, *virtualScene.get(planeObject));
+}
+
+void Game::cullMaze(const ViewFrustum& frustum) {
+    visibleMazePieces.clear();
+    size_t numVisible = mazeCuller.cull(frustum, visibleMazePieces);
+    cullingStats.culled += mazeCuller.size() - numVisible;
+
+    // Of those, only the pieces that can be seen from the camera cell
+    size_t numHidden = mazePvs.filter(mazePvs.findCell(glm::vec3(cameraPosition)), visibleMazePieces);
+    cullingStats.hidden += numHidden;
 }
 
 void Game::drawMaze(glm::mat4 model) {
-    for (const auto& [name, obj] : virtualScene) {
-        bool isMazePart = name.find("maze") != std::string::npos;
-
-        if (isMazePart) {
-            glUniformMatrix4fv(uniforms.at("model"), 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(uniforms.at("object_id"), MAZE);
-            glUniform1i(uniforms.at("interpolation_type"), PHONG_INTERPOLATION);
-            DrawVirtualObject(const_cast<UniformMap&>(uniforms), virtualScene, name.c_str());
+    // Of the pieces kept by cullMaze(), those behind the occluders
+    size_t numVisible = visibleMazePieces.size();
+    size_t numKept = 0;
+    for (uint32_t piece : visibleMazePieces) {
+        if (!isOccluded(mazeBatch.getPieces()[piece].bounds)) {
+            visibleMazePieces[numKept++] = piece;
         }
     }
-}
+    cullingStats.occluded += numVisible - numKept;
+    numVisible = numKept;
+    visibleMazePieces.resize(numVisible);
+    cullingStats.drawn += numVisible;
+    if (numVisible == 0) {
+        return;
+    }
 
-void Game::drawChestBase(glm::mat4 model, int chestIndex) {
-    // Draw the chest base
-    glUniformMatrix4fv(uniforms.at("model"), 1 , GL_FALSE , glm::value_ptr(model));
-    glUniform1i(uniforms.at("object_id"), CHEST);
-    glUniform1i(uniforms.at("interpolation_type"), PHONG_INTERPOLATION);
+    // The batch is in world space already
+    DrawPacket packet;
+    packet.programId = gpuProgramId;
+    packet.uniforms.model = model;
+    packet.uniforms.objectId = MAZE;
+    packet.uniforms.interpolationType = PHONG_INTERPOLATION;
+    packet.uniforms.positionOffset = glm::vec4(mazeBatch.getQuantization().offset, 0.0f);
+    packet.uniforms.positionScale = glm::vec4(mazeBatch.getQuantization().scale, 0.0f);
+
+    // At the depth of the nearest visible piece
+    float depth = FLT_MAX;
+    for (uint32_t piece : visibleMazePieces) {
+        depth = std::min(depth, renderQueue.depthOf(mazeBatch.getPieces()[piece].bounds));
+    }
+    mazeBatch.draw(renderQueue, packet, depth, visibleMazePieces);
+}
 
-    std::string chestName = "the_chest" + std::to_string(chestIndex);
-    DrawVirtualObject(const_cast<UniformMap&>(uniforms), virtualScene, chestName.c_str());
+void Game::cullChests(const ViewFrustum& frustum) {
+    // A chest is culled when the box around its base and its lid is
+    chestBounds.resize(chestBaseObjects.size());
+    for (size_t i = 0; i < chestBaseObjects.size(); i++) {
+        const AABB& base = virtualScene.get(chestBaseObjects[i])->getAABB();
+        const AABB& lid = virtualScene.get(chestLidObjects[i])->getAABB();
+        chestBounds[i] = AABB(glm::min(base.getMin(), lid.getMin()), glm::max(base.getMax(), lid.getMax()));
+        chestCuller.set(i, chestBounds[i]);
+    }
+    visibleChests.clear();
+    size_t numVisible = chestCuller.cull(frustum, visibleChests);
+    cullingStats.culled += 2 * (chestCuller.size() - numVisible);
 }
 
-void Game::drawChestLid(glm::mat4 model, int chestIndex) {
-    glUniformMatrix4fv(uniforms.at("model"), 1 , GL_FALSE , glm::value_ptr(model));
-    glUniform1i(uniforms.at("object_id"), CHEST_LID);
-    glUniform1i(uniforms.at("interpolation_type"), PHONG_INTERPOLATION);
+void Game::drawChests(const SimulationState& state) {
+    // Of the chests kept by cullChests(), those behind the occluders
+    size_t numVisible = visibleChests.size();
+    size_t numKept = 0;
+    for (uint32_t chest : visibleChests) {
+        if (!isOccluded(chestBounds[chest])) {
+            visibleChests[numKept++] = chest;
+        }
+    }
+    cullingStats.occluded += 2 * (numVisible - numKept);
+    numVisible = numKept;
+    cullingStats.drawn += 2 * numVisible;
+
+    // Every visible base, then every visible lid, each with one instanced draw
+    chestBases.setNumInstances(numVisible);
+    chestLids.setNumInstances(numVisible);
+    float depth = FLT_MAX; // Of the nearest visible chest
+    for (size_t j = 0; j < numVisible; j++) {
+        int i = static_cast<int>(visibleChests[j]);
+        chestBases.setInstance(j, simulation.getChestBaseModel(i));
+        chestLids.setInstance(j, simulation.getChestLidModel(i, state.chestLidRotation[i]));
+        depth = std::min(depth, renderQueue.depthOf(chestBounds[i]));
+    }
+    if (numVisible == 0) {
+        return;
+    }
+
+    DrawPacket packet;
+    packet.programId = gpuProgramId;
+    packet.uniforms.instanced = 1;
+    packet.uniforms.interpolationType = PHONG_INTERPOLATION;
+
+    packet.uniforms.objectId = CHEST;
+    packet.uniforms.positionOffset = glm::vec4(chestBases.getQuantization().offset, 0.0f);
+    packet.uniforms.positionScale = glm::vec4(chestBases.getQuantization().scale, 0.0f);
+    chestBases.draw(renderQueue, packet, depth);
 
-    std::string chestLidName = "the_chest_lid" + std::to_string(chestIndex);
-    DrawVirtualObject(const_cast<UniformMap&>(uniforms), virtualScene, chestLidName.c_str());
+    packet.uniforms.objectId = CHEST_LID;
+    packet.uniforms.positionOffset = glm::vec4(chestLids.getQuantization().offset, 0.0f);
+    packet.uniforms.positionScale = glm::vec4(chestLids.getQuantization().scale, 0.0f);
+    chestLids.draw(renderQueue, packet, depth);
 }
 
 void Game::renderPlayerLife(GLFWwindow* window) const {
@@ -317,10 +352,10 @@ void Game::renderPlayerLife(GLFWwindow* window) const {
 
     std::string buffer = "[";
 
-    for (int i = 0; i < playerLife; i++) {
+    for (int i = 0; i < simulation.getPlayerLife(); i++) {
         buffer += "+++";
     }
-    for (int i = 0; i < maxLife - playerLife; i++) {
+    for (int i = 0; i < simulation.getMaxLife() - simulation.getPlayerLife(); i++) {
         buffer += "   ";
     }
     buffer += "]";
@@ -427,164 +462,206 @@ void Game::renderGameOver(GLFWwindow* window) const {
     );
 }
 
-glm::vec4 bezierCurve2D(glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, float t) {
-    float x = pow(1-t,3) * p0.x 
-              + 3 * t * pow(1-t,2) * p1.x 
-              + 3 * (1-t) * pow(t,2) * p2.x 
-              + pow(t,3) * p3.x;
-    float z = pow(1-t,3) * p0.y 
-              + 3 * t * pow(1-t,2) * p1.y 
-              + 3 * (1-t) * pow(t,2) * p2.y 
-              + pow(t,3)*p3.y;
-
-    return {x, 1.2f, z, 1.0f};
-}
-
-void Game::gameLoop() {
-    float scallingFactor = 0.1f;
-    float t = 0.0f;     // Parâmetro "t" da curva de Bézier
-    bool turn = false;  // Controle do sentido (ida ou volta)
+void Game::renderCullingStats(GLFWwindow* window) const {
+    const float scale = 1.5f;
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "Drawn %zu, culled %zu, hidden %zu, occluded %zu%s",
+             cullingStats.drawn, cullingStats.culled, cullingStats.hidden, cullingStats.occluded,
+             occlusionCulling ? "" : " (off)");
 
-    glm::vec2 p0(0.0f, -90.0f); // Ponto inicial
-    glm::vec2 p1(1.5f, -91.5f); // Primeiro ponto de controle (mudança gradual)
-    glm::vec2 p2(3.5f, -93.0f); // Segundo ponto de controle (mais alinhado com p1 e p3)
-    glm::vec2 p3(5.0f, -94.5f); // Ponto final (um pouco mais distante para suavizar)
+    float lineheight = TextRendering_LineHeight(window, scale);
+    TextRendering_PrintString(window, buffer, -1.0f, 1.0f - lineheight, scale);
 
-    double lastTime = glfwGetTime();
-    double currentTime = lastTime;
+    snprintf(buffer, sizeof(buffer), "Cow LOD %d, %zu triangles culled", cowLod, cullingStats.trianglesCulled);
+    TextRendering_PrintString(window, buffer, -1.0f, 1.0f - 2.0f * lineheight, scale);
 
-    glm::vec4 lastCowPosition = cowPosition;
+    const RenderQueue::Stats& queueStats = renderQueue.getStats();
+    snprintf(buffer, sizeof(buffer), "Draws %zu, programs %zu, vertex arrays %zu, uniforms %zu",
+             queueStats.draws, queueStats.programBinds, queueStats.vertexArrayBinds, queueStats.uniformUploads);
+    TextRendering_PrintString(window, buffer, -1.0f, 1.0f - 3.0f * lineheight, scale);
+}
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+void Game::renderScene(const SimulationState& state) {
+    updateCamera(state);
+    setCameraView();
+    setProjection();
 
-        if (victory) {
-            renderVictory(window);
-            glfwSwapBuffers(window);
-            continue;
-        }
-        if (gameOver) {
-            renderGameOver(window);
-            glfwSwapBuffers(window);
-            continue;
-        }
-
-        // Update time
-        currentTime = glfwGetTime();
-        deltaTime = currentTime - lastTime;
-        lastTime = currentTime;
-
-        // Update the control points of the Bézier curve (Cow movement)
-        if (t >= 1.0f) {
-            t = 0.0f;
-
-            if (!turn) {
-                // Forward path
-                p0 = glm::vec2(0.0f, -90.0f);
-                p1 = glm::vec2(1.5f, -91.5f);
-                p2 = glm::vec2(3.5f, -93.0f);
-                p3 = glm::vec2(5.0f, -94.5f);
-            } else {
-                // Backwards path
-                p0 = glm::vec2(5.0f, -94.5f);
-                p1 = glm::vec2(3.5f, -93.0f);
-                p2 = glm::vec2(1.5f, -91.5f);
-                p3 = glm::vec2(0.0f, -90.0f);
-            }
-            turn = !turn; // Changes direction
-        }
+    // The occluders are drawn on the worker thread from now on, while the
+    // frame is cleared and set up and everything is frustum culled. The
+    // first isOccluded() waits for it.
+    if (occlusionCulling) {
+        occlusionCuller.beginFrame(projectionMatrix * viewMatrix);
+    }
 
-        // Atualiza a posição da vaca
-        lastCowPosition = cowPosition;
-        cowPosition = bezierCurve2D(p0, p1, p2, p3, t);
+    // Sets the background color
+    initialRendering(0.0f, 0.0f, 0.1f);
 
-        // Atualiza AABB e bounding sphere da vaca
-        glm::vec4 cowTranslation = cowPosition - lastCowPosition;
-        virtualScene["the_cow"]->translate(cowTranslation.x, cowTranslation.y, cowTranslation.z);
+    FrameUniforms frame;
+    frame.view = viewMatrix;
+    frame.projection = projectionMatrix;
+    frame.cameraPosition = cameraPosition;
+    uniformBuffers.beginFrame(frame);
+    renderQueue.begin(glm::vec3(cameraPosition));
 
-        // Atualiza o parâmetro "t" da curva de Bézier
-        t += scallingFactor * deltaTime;
+    glm::mat4 model = Matrix_Identity();
 
-        distanceCameraCow = glm::distance(cameraPosition, cowPosition);
+    // Objects entirely outside the view are not drawn
+    ViewFrustum frustum = ViewFrustum::fromMatrix(projectionMatrix * viewMatrix);
+    cullingStats = CullingStats();
 
-        if (lookAtMode && distanceCameraCow < distanceCameraCowThreshold) {
-            cameraView = normalize(cowPosition - cameraPosition);
-        }
+    // The plane is never occluded
+    bool planeVisible = frustum.intersects(planeBounds);
+    cullingStats.drawn += planeVisible ? 1 : 0;
+    cullingStats.culled += planeVisible ? 0 : 1;
+    if (planeVisible) {
+        drawPlane(model);
+    }
 
-        if (virtualScene["Cube"]->intersects(*virtualScene["the_cow"])) {
-            victory = true;
-            continue;
-        }
+    cullChests(frustum);
+    cullMaze(frustum);
+    glm::mat4 cowModel = simulation.getCowModel(state.cowPosition);
+    AABB cowBounds = cowModelBounds;
+    cowBounds.transform(cowModel);
+    bool cowInFrustum = frustum.intersects(cowBounds);
+
+    // Then the occlusion tests, against the buffer of the worker
+    drawChests(state);
+    bool cowVisible = cowInFrustum && !isOccluded(cowBounds);
+    cullingStats.drawn += cowVisible ? 1 : 0;
+    cullingStats.culled += cowInFrustum ? 0 : 1;
+    cullingStats.occluded += cowInFrustum && !cowVisible ? 1 : 0;
+    if (cowVisible) {
+        drawCow(cowModel);
+    }
+    drawMaze(model);
 
-        // Sets the background color
-        initialRendering(0.0f, 0.0f, 0.1f);
-        glUseProgram(gpuProgramId);
+    // Front to back, whatever the order they were queued in
+    renderQueue.flush(uniformBuffers);
 
-        setCameraView();
-        setProjection();
+    renderPlayerLife(window);
+    if (showCullingStats) {
+        renderCullingStats(window);
+    }
+}
 
-        timeStarving += deltaTime;
-        if (timeStarving > starvationLimit) {
-            playerLife--;
-            timeStarving = 0.0f;
-            if (playerLife == 0) {
-                gameOver = true;
-            }
+void Game::receiveInput(InputEvent event) {
+    if (inputReplay.isOpen()) {
+        // Only the escape key still works during a replay
+        if (event.type == InputEvent::Key && event.code == GLFW_KEY_ESCAPE && event.action == GLFW_PRESS) {
+            glfwSetWindowShouldClose(window, GL_TRUE);
         }
+        return;
+    }
 
-        glm::mat4 model = Matrix_Identity();
+    // Events arrive between ticks, and are seen by the next one
+    event.tick = simulation.getTick();
+    inputRecorder.record(event);
+    dispatchInput(event);
+}
 
-        glm::mat4 cowModel = Matrix_Translate(cowPosition.x, cowPosition.y, cowPosition.z)
-                             * Matrix_Scale(2.0f, 2.0f, 2.0f);
+void Game::dispatchInput(const InputEvent& event) {
+    switch (event.type) {
+        case InputEvent::Key: keyCallback(event.code, 0, event.action, event.mods); break;
+        case InputEvent::MouseButton: mouseButtonCallback(event.code, event.action, event.mods); break;
+        case InputEvent::Cursor: cursorPosCallback(event.x, event.y); break;
+        case InputEvent::Frame: break;
+    }
+}
 
-        // Draws the chests
-        for (int i = 1; i <= numChests; i++) {
-            glm::vec3 coord = chestCoordinates[i-1];
+bool Game::replayFrame(float& alpha) {
+    InputEvent event;
+    while (inputReplay.next(event)) {
+        // Simulate up to the tick the event was received at
+        while (simulation.getTick() < event.tick && !simulation.isVictory() && !simulation.isGameOver()) {
+            simulation.step(input);
+            input.clearActions();
+        }
 
-            glm::mat4 chestBaseModel = Matrix_Translate(coord.x, coord.y, coord.z);
-            glm::mat4 chestLidModel;
+        if (event.type == InputEvent::Frame) {
+            alpha = event.alpha;
+            return true;
+        }
+        dispatchInput(event);
+    }
+    return false;
+}
 
-            if (chestOpened[i-1]) {
-                GameObject* chest = virtualScene["the_chest" + std::to_string(i)];
-                GameObject* chestLid = virtualScene["the_chest_lid" + std::to_string(i)];
+void Game::printInputSessionSummary() const {
+    printf("Tick %llu, simulation checksum %016llx, camera yaw %a, pitch %a\n",
+           static_cast<unsigned long long>(simulation.getTick()),
+           static_cast<unsigned long long>(simulation.checksum()),
+           cameraYaw, cameraPitch);
+}
 
-                glm::vec4 chestBaseAABBMin = chest->getAABB().getMin();
-                glm::vec4 chestBaseAABBMax = chest->getAABB().getMax();
-                
-                glm::vec4 chestLidAABBMin = chestLid->getAABB().getMin();
-                glm::vec4 chestLidAABBMax = chestLid->getAABB().getMax();
+void Game::gameLoop() {
+    double lastTime = glfwGetTime();
+    double accumulator = 0.0;
 
-                float chestDepth = chestBaseAABBMax.z - chestBaseAABBMin.z;
-                float chestBaseHeight = chestBaseAABBMax.y - chestBaseAABBMin.y;
-                float chestLidHeight = chestLidAABBMax.y - chestLidAABBMin.y;
+    while (!glfwWindowShouldClose(window)) {
+        glfwPollEvents();
 
-                // Desloca o baú de modo que a dobradiça fique no centro
-                float chestLidOffsetX = chestDepth / 2.0f;
-                float chestLidOffsetY = (chestBaseHeight - 2.0f * chestLidHeight) / 2.0f;
+        if (simulation.isVictory()) {
+            renderVictory(window);
+            glfwSwapBuffers(window);
+            continue;
+        }
+        if (simulation.isGameOver()) {
+            renderGameOver(window);
+            glfwSwapBuffers(window);
+            continue;
+        }
 
-                if (chestLidRotation[i-1] < M_PI_2) {   // Abrir até 90 graus
-                    chestLidRotation[i-1] += deltaTime;
-                }
-                chestLidModel = Matrix_Translate(coord.x, coord.y, coord.z)
-                                * Matrix_Translate(-chestLidOffsetX, -chestLidOffsetY, 0.0f)
-                                * Matrix_Rotate_Z(chestLidRotation[i-1])
-                                * Matrix_Translate(chestLidOffsetX, chestLidOffsetY, 0.0f);
-            } else {
-                chestLidModel = Matrix_Translate(coord.x, coord.y, coord.z);
+        float alpha;
+        if (inputReplay.isOpen()) {
+            // The recorded frames, whatever the time they take now
+            if (!replayFrame(alpha)) {
+                printf("Replay finished\n");
+                glfwSetWindowShouldClose(window, GL_TRUE);
+                continue;
+            }
+        } else {
+            // Update time
+            double currentTime = glfwGetTime();
+            accumulator += std::min(currentTime - lastTime, maxFrameTime);
+            lastTime = currentTime;
+
+            // Advance the simulation in fixed ticks, whatever the frame rate
+            while (accumulator >= Simulation::tickDuration) {
+                simulation.step(input);
+                input.clearActions();
+                accumulator -= Simulation::tickDuration;
             }
 
-            drawChestBase(chestBaseModel, i);
-            drawChestLid(chestLidModel, i);
+            // Render between the last two ticks, the time left in the accumulator
+            // being the fraction of a tick that has already passed
+            alpha = static_cast<float>(accumulator / Simulation::tickDuration);
+            inputRecorder.record({InputEvent::Frame, simulation.getTick(), 0, 0, 0, 0.0, 0.0, alpha});
+        }
+        if (simulation.isVictory() || simulation.isGameOver()) {
+            continue;
         }
 
-        drawCow(cowModel);
-        drawPlane(model);
-        drawMaze(model);
-
-        renderPlayerLife(window);
+        renderScene(SimulationState::interpolate(simulation.getPreviousState(), simulation.getState(), alpha));
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
+    }
+
+    if (inputRecorder.isOpen() || inputReplay.isOpen()) {
+        printInputSessionSummary();
+    }
+    inputRecorder.close();
+}
+
+void Game::recordInput(const std::string& path) {
+    inputRecorder.open(path, static_cast<uint16_t>(Simulation::tickRate));
+}
+
+void Game::replayInput(const std::string& path) {
+    inputReplay.open(path);
+    if (inputReplay.getTickRate() != static_cast<uint16_t>(Simulation::tickRate)) {
+        fprintf(stderr, "ERROR: input log \"%s\" was recorded at %u ticks per second, the game runs at %u.\n",
+                path.c_str(), inputReplay.getTickRate(), static_cast<unsigned>(Simulation::tickRate));
+        std::exit(EXIT_FAILURE);
     }
 }
 
@@ -595,62 +672,90 @@ void Game::run() {
     }
 
     LoadShadersFromFiles(gpuProgramId, uniforms);
+    uniformBuffers.create(gpuProgramId);
 
+    // After the shaders: only the images their samplers read are loaded
     LoadTexturesFromFiles(
         "../../assets/textures", 
         numLoadedTextures, 
-        GL_REPEAT
+        GL_REPEAT,
+        uniforms
     );
 
-    glm::mat4 model = Matrix_Identity();
-
                          /* Loading the OBJ models */
 
-    // ----------------------------- COW ----------------------------- //
-    model = Matrix_Translate(4.0f,1.2f,-90.0f)
-            * Matrix_Scale(-5.0f,2.0f,2.0f);
-
-    createModel("../../assets/models/cow.obj", model);
-
-
-    // ----------------------------- MAZE ----------------------------- //
-    model = Matrix_Identity();
-
-    createModel("../../assets/models/maze/", model);
-
-    // ----------------------------- CHEST ----------------------------- //
-    model = Matrix_Identity();
-
-    createModel("../../assets/models/chest.obj", model);
-    createModel("../../assets/models/chest_lid.obj", model);
-
-    GameObject* chest = virtualScene["the_chest"];
-    GameObject* chestLid = virtualScene["the_chest_lid"];
-
-    // Place the chests at the specified coordinates
-    for (int i = 1; i <= numChests; i++) {
-        glm::vec3 coord = chestCoordinates[i-1];
-
-        std::string chestName = "the_chest" + std::to_string(i);
-        std::string chestLidName = "the_chest_lid" + std::to_string(i);
-
-        virtualScene[chestName] = new GameObject(*chest);
-        virtualScene[chestName]->translate(coord.x, coord.y, coord.z);
+    // Parsed by worker threads, uploaded here in file order as they are ready
+    LoadSceneMeshes(
+        GetSceneModels(simulation.getState().playerPosition, cameraYaw),
+        [this](const std::string& file, const glm::mat4& model, Mesh& mesh) {
+            createModel(file, model, mesh);
+        }
+    );
 
-        virtualScene[chestLidName] = new GameObject(*chestLid);
-        virtualScene[chestLidName]->translate(coord.x, coord.y, coord.z);
+    // Visibility between the cells of the floor and the maze pieces, cast
+    // against the batch before upload() frees its CPU copy
+    std::vector<MeshShape> mazePieces;
+    for (const StaticBatchPiece& piece : mazeBatch.getPieces()) {
+        mazePieces.push_back({piece.name, piece.firstIndex, piece.numIndices});
+    }
+    PvsLoadStats pvsStats;
+    mazePvs = LoadPotentiallyVisibleSet(
+        "maze",
+        mazeBatch.getVertices().data(), mazeBatch.getVertices().size(),
+        mazeBatch.getIndices().data(), mazeBatch.getIndices().size(),
+        mazePieces, PvsSettings(), &pvsStats
+    );
+    size_t pvsVisible = 0;
+    for (size_t cell = 0; cell < mazePvs.getNumCells(); cell++) {
+        pvsVisible += mazePvs.countVisible(static_cast<int>(cell));
     }
+    printf("Maze PVS: %zu cells, %.1f of %zu pieces visible per cell, %s in %.3f s\n",
+           mazePvs.getNumCells(), mazePvs.getNumCells() > 0 ? double(pvsVisible) / mazePvs.getNumCells() : 0.0,
+           mazePvs.getNumPieces(), pvsStats.fromCache ? "read from cache" : "built",
+           pvsStats.buildTime + pvsStats.cacheTime);
+
+    // The largest pieces hide the objects behind them
+    for (const StaticBatchPiece& piece : mazeBatch.getPieces()) {
+        glm::vec4 size = piece.bounds.getMax() - piece.bounds.getMin();
+        if (std::max(size.x, size.z) < minOccluderSize) {
+            continue;
+        }
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        std::map<uint32_t, uint32_t> remap;
+        for (uint32_t i = 0; i < piece.numIndices; i++) {
+            uint32_t index = mazeBatch.getIndices()[piece.firstIndex + i];
+            auto inserted = remap.emplace(index, static_cast<uint32_t>(positions.size()));
+            if (inserted.second) {
+                positions.push_back(glm::make_vec3(mazeBatch.getVertices()[index].position));
+            }
+            indices.push_back(inserted.first->second);
+        }
+        occlusionCuller.addOccluder(positions, indices);
+    }
+    printf("Occlusion culling: %zu of %zu maze pieces are occluders\n",
+           occlusionCuller.getNumOccluders(), mazeBatch.getPieces().size());
 
-    virtualScene.erase("the_chest");
-    virtualScene.erase("the_chest_lid");
-    delete chest;
-    delete chestLid;
+    mazeBatch.upload(virtualScene);
+    printf("Maze batch: %zu pieces, %zu vertices, %zu indices: %zu bytes packed, %zu saved\n",
+           mazeBatch.getPieces().size(), mazeBatch.getNumVertices(), mazeBatch.getNumIndices(),
+           mazeBatch.getSizeInBytes(), mazeBatch.getUnpackedSizeInBytes() - mazeBatch.getSizeInBytes());
 
-    // ----------------------------- CUBE (PLAYER) ----------------------------- //
-    model = Matrix_Translate(cameraPosition.x, cameraPosition.y, cameraPosition.z)
-            * Matrix_Rotate_Y(-cameraYaw);
+    // Places the chests and builds the collision structures
+    simulation.init(virtualScene);
 
-    createModel("../../assets/models/cube.obj", model);
+    // Bounds culled against the view frustum
+    for (const StaticBatchPiece& piece : mazeBatch.getPieces()) {
+        mazeCuller.add(piece.bounds);
+    }
+    for (int i = 0; i < simulation.getNumChests(); i++) {
+        chestBaseObjects.push_back(simulation.getChestBaseObject(i));
+        chestLidObjects.push_back(simulation.getChestLidObject(i));
+        chestCuller.add(virtualScene.get(chestBaseObjects.back())->getAABB());
+    }
+    cowObject = virtualScene.find("the_cow");
+    planeObject = virtualScene.find("the_plane");
+    planeBounds = virtualScene.get(planeObject)->getAABB();
 
     setRenderConfig();
 
@@ -658,13 +763,12 @@ void Game::run() {
 
     gameLoop();
 
+    uniformBuffers.destroy();
     glfwTerminate();
 }
 
 Game::~Game() {
     glfwDestroyWindow(window);
-    for (auto& obj : virtualScene) {
-        delete obj.second;
-    }
+    // Before the dynamic tree of the simulation, which the objects leave
     virtualScene.clear();
 }
\ No newline at end of file
@@ -5,14 +5,49 @@
 #include <map>
 
 #include <glad/glad.h>
-#include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
+void GameObject::setAABB(const AABB& aabb) {
+    this->aabb = aabb;
+    updateProxy(glm::vec3(0.0f));
+}
+
+void GameObject::attachToTree(DynamicAABBTree* tree) {
+    detachFromTree();
+    this->tree = tree;
+    proxyId = tree->createProxy(getBounds(), this);
+}
+
+void GameObject::detachFromTree() {
+    if (tree) {
+        tree->destroyProxy(proxyId);
+        tree = nullptr;
+        proxyId = DynamicAABBTree::nullNode;
+    }
+}
+
+void GameObject::takeProxy(GameObject& other) {
+    tree = other.tree;
+    proxyId = other.proxyId;
+    other.tree = nullptr;
+    other.proxyId = DynamicAABBTree::nullNode;
+    if (tree) {
+        tree->setUserData(proxyId, this);
+    }
+}
+
+void GameObject::updateProxy(const glm::vec3& displacement) {
+    if (tree) {
+        tree->moveProxy(proxyId, getBounds(), displacement);
+    }
+}
+
 void GameObject::rotate(float angle, const glm::vec4& axis) {
     aabb.rotate(angle, axis);
+    updateProxy(glm::vec3(0.0f));
 }
 
 void GameObject::translate(float tx, float ty, float tz) {
@@ -20,11 +55,13 @@ void GameObject::translate(float tx, float ty, float tz) {
     bsphere.translate(tx, ty, tz);
     lastMove = glm::vec3(tx, ty, tz);
     updateMoveTime();
+    updateProxy(lastMove);
 }
 
 void GameObject::scale(float sx, float sy, float sz) {
     aabb.scale(sx, sy, sz);
     bsphere.scale(sx, sy, sz);
+    updateProxy(glm::vec3(0.0f));
 }
 
 // Check if a point (in homogeneous coordinates) is inside the GameObject
@@ -47,6 +84,8 @@ bool GameObject::intersects(const GameObject& other) const {
     return aabb.intersects(other.aabb);
 }
 
+static uint64_t moveClock = 0;
+
 void GameObject::updateMoveTime() {
-    lastMoveTime = glfwGetTime();
+    lastMoveTime = ++moveClock;
 }
\ No newline at end of file
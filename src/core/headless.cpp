@@ -0,0 +1,91 @@
+#include "core/headless.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "core/input_script.h"
+#include "core/scene.h"
+#include "core/simulation.h"
+#include "graphics/mesh.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [--headless] [--ticks N] [--script PATH]\n", program);
+}
+
+} // namespace
+
+int RunHeadless(int argc, char** argv) {
+    uint64_t numTicks = 36000;
+    std::string scriptPath;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            continue;
+        } else if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            numTicks = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    InputScript script = scriptPath.empty() ? InputScript::defaultScript()
+                                            : InputScript::fromFile(scriptPath);
+
+    Simulation simulation;
+    SimulationInput input;
+    VirtualScene virtualScene;
+
+    // Only the bounding volumes are needed, so nothing goes to the GPU
+    Clock::time_point loadStart = Clock::now();
+    LoadSceneMeshes(
+        GetSceneModels(simulation.getState().playerPosition, input.cameraYaw),
+        [&](const std::string&, const glm::mat4& model, Mesh& mesh) {
+            AddSceneObjects(virtualScene, mesh, model, 0);
+        }
+    );
+    simulation.init(virtualScene);
+    double loadTime = secondsSince(loadStart);
+
+    Clock::time_point runStart = Clock::now();
+    for (uint64_t tick = 0; tick < numTicks; ++tick) {
+        if (simulation.isVictory() || simulation.isGameOver()) {
+            break;
+        }
+        script.apply(tick, input);
+        simulation.step(input);
+        input.clearActions();
+    }
+    double runTime = secondsSince(runStart);
+
+    const SimulationState& state = simulation.getState();
+    uint64_t ticks = simulation.getTick();
+
+    printf("\nHeadless run\n");
+    printf("  script:         %s (%zu events)\n", scriptPath.empty() ? "default" : scriptPath.c_str(), script.size());
+    printf("  objects:        %zu\n", virtualScene.size());
+    printf("  load time:      %.3f s\n", loadTime);
+    printf("  ticks:          %llu (%.1f s simulated)\n", static_cast<unsigned long long>(ticks), ticks * Simulation::tickDuration);
+    printf("  wall time:      %.3f s\n", runTime);
+    printf("  ticks/s:        %.0f\n", runTime > 0.0 ? ticks / runTime : 0.0);
+    printf("  player:         (%.4f, %.4f, %.4f)\n", state.playerPosition.x, state.playerPosition.y, state.playerPosition.z);
+    printf("  cow:            (%.4f, %.4f, %.4f)\n", state.cowPosition.x, state.cowPosition.y, state.cowPosition.z);
+    printf("  life:           %d/%d\n", simulation.getPlayerLife(), simulation.getMaxLife());
+    printf("  checksum:       %016llx\n", static_cast<unsigned long long>(simulation.checksum()));
+    printf("  result:         %s\n", simulation.isVictory() ? "victory" : simulation.isGameOver() ? "game over" : "running");
+
+    return EXIT_SUCCESS;
+}
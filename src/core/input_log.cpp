@@ -0,0 +1,206 @@
+#include "core/input_log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+const char magic[4] = {'C', 'Q', 'I', 'N'};
+const uint16_t version = 1;
+const size_t headerSize = 8;
+// Events are written in blocks, not one small write per callback
+const size_t flushSize = 4096;
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void putLittleEndian(std::vector<uint8_t>& out, uint64_t value, int numBytes) {
+    for (int i = 0; i < numBytes; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void putDouble(std::vector<uint8_t>& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(out, bits, 8);
+}
+
+void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(out, bits, 4);
+}
+
+} // namespace
+
+void InputRecorder::open(const std::string& logPath, uint16_t tickRate) {
+    close();
+
+    path = logPath;
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        fprintf(stderr, "ERROR: could not create input log \"%s\".\n", path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+
+    buffer.assign(magic, magic + sizeof(magic));
+    putLittleEndian(buffer, version, 2);
+    putLittleEndian(buffer, tickRate, 2);
+    lastTick = 0;
+    numEvents = 0;
+    numBytes = 0;
+}
+
+void InputRecorder::close() {
+    if (!file.is_open()) {
+        return;
+    }
+
+    numBytes += buffer.size();
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    buffer.clear();
+    file.close();
+
+    printf("Recorded %zu input events in \"%s\" (%zu bytes)\n", numEvents, path.c_str(), numBytes);
+}
+
+void InputRecorder::record(const InputEvent& event) {
+    if (!file.is_open()) {
+        return;
+    }
+
+    buffer.push_back(event.type);
+    putVarint(buffer, event.tick - lastTick);
+    lastTick = event.tick;
+
+    switch (event.type) {
+        case InputEvent::Key:
+            putVarint(buffer, static_cast<uint32_t>(event.code));
+            buffer.push_back(static_cast<uint8_t>(event.action));
+            buffer.push_back(static_cast<uint8_t>(event.mods));
+            break;
+        case InputEvent::MouseButton:
+            buffer.push_back(static_cast<uint8_t>(event.code));
+            buffer.push_back(static_cast<uint8_t>(event.action));
+            buffer.push_back(static_cast<uint8_t>(event.mods));
+            break;
+        case InputEvent::Cursor:
+            putDouble(buffer, event.x);
+            putDouble(buffer, event.y);
+            break;
+        case InputEvent::Frame:
+            putFloat(buffer, event.alpha);
+            break;
+    }
+    ++numEvents;
+
+    if (buffer.size() >= flushSize) {
+        numBytes += buffer.size();
+        file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        buffer.clear();
+    }
+}
+
+void InputReplay::open(const std::string& logPath) {
+    path = logPath;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "ERROR: could not open input log \"%s\".\n", path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (data.size() < headerSize || std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+        fprintf(stderr, "ERROR: \"%s\" is not an input log.\n", path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    uint16_t logVersion = data[4] | (data[5] << 8);
+    if (logVersion != version) {
+        fprintf(stderr, "ERROR: input log \"%s\" has version %u, expected %u.\n",
+                path.c_str(), logVersion, version);
+        std::exit(EXIT_FAILURE);
+    }
+    tickRate = data[6] | (data[7] << 8);
+
+    position = headerSize;
+    lastTick = 0;
+    loaded = true;
+}
+
+bool InputReplay::next(InputEvent& event) {
+    if (position >= data.size()) {
+        return false;
+    }
+
+    auto fail = [&]() {
+        fprintf(stderr, "ERROR: input log \"%s\" is truncated or corrupted at byte %zu.\n",
+                path.c_str(), position);
+        std::exit(EXIT_FAILURE);
+    };
+    auto getByte = [&]() -> uint8_t {
+        if (position >= data.size()) {
+            fail();
+        }
+        return data[position++];
+    };
+    auto getVarint = [&]() -> uint64_t {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = getByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        fail();
+        return 0;
+    };
+    auto getLittleEndian = [&](int numBytes) -> uint64_t {
+        uint64_t value = 0;
+        for (int i = 0; i < numBytes; ++i) {
+            value |= static_cast<uint64_t>(getByte()) << (8 * i);
+        }
+        return value;
+    };
+
+    event = InputEvent();
+    event.type = static_cast<InputEvent::Type>(getByte());
+    lastTick += getVarint();
+    event.tick = lastTick;
+
+    switch (event.type) {
+        case InputEvent::Key:
+            event.code = static_cast<int>(getVarint());
+            event.action = getByte();
+            event.mods = getByte();
+            break;
+        case InputEvent::MouseButton:
+            event.code = getByte();
+            event.action = getByte();
+            event.mods = getByte();
+            break;
+        case InputEvent::Cursor: {
+            uint64_t x = getLittleEndian(8);
+            uint64_t y = getLittleEndian(8);
+            std::memcpy(&event.x, &x, sizeof(x));
+            std::memcpy(&event.y, &y, sizeof(y));
+            break;
+        }
+        case InputEvent::Frame: {
+            uint32_t alpha = static_cast<uint32_t>(getLittleEndian(4));
+            std::memcpy(&event.alpha, &alpha, sizeof(alpha));
+            break;
+        }
+        default:
+            fail();
+    }
+    return true;
+}
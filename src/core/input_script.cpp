@@ -0,0 +1,164 @@
+#include "core/input_script.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Keys that can be held by a script
+enum ScriptKey { KEY_W, KEY_A, KEY_S, KEY_D, KEY_SHIFT };
+
+int parseKey(const std::string& name) {
+    if (name == "W") return KEY_W;
+    if (name == "A") return KEY_A;
+    if (name == "S") return KEY_S;
+    if (name == "D") return KEY_D;
+    if (name == "SHIFT") return KEY_SHIFT;
+    return -1;
+}
+
+void setKey(SimulationInput& input, int key, bool pressed) {
+    switch (key) {
+        case KEY_W: input.moveForward = pressed; break;
+        case KEY_A: input.moveLeft = pressed; break;
+        case KEY_S: input.moveBackward = pressed; break;
+        case KEY_D: input.moveRight = pressed; break;
+        case KEY_SHIFT: input.sprint = pressed; break;
+    }
+}
+
+const char* const defaultScriptText = R"(
+# Walk out of the start position and around the maze, in a loop of 60 s
+0     yaw 3.1416
+0     press W
+240   press SHIFT
+480   release SHIFT
+480   yaw 4.7124
+720   press D
+960   release D
+960   yaw 1.5708
+1200  space
+1440  yaw 0.0
+1440  press SHIFT
+1920  release SHIFT
+1920  press A
+2160  release A
+2160  yaw 3.1416
+2400  lookat
+2880  lookat
+2880  yaw 2.3562
+3360  space
+3600  release W
+3600  press S
+4080  release S
+4080  press W
+5760  release W
+5760  pitch 0.3
+6000  pitch 0.0
+7200  loop
+)";
+
+} // namespace
+
+InputScript InputScript::fromFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "ERROR: could not open input script \"%s\".\n", path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    return fromStream(file, path);
+}
+
+InputScript InputScript::defaultScript() {
+    std::istringstream in(defaultScriptText);
+    return fromStream(in, "default script");
+}
+
+InputScript InputScript::fromStream(std::istream& in, const std::string& sourceName) {
+    InputScript script;
+    std::string line;
+    int lineNumber = 0;
+
+    auto fail = [&](const char* message) {
+        fprintf(stderr, "ERROR: %s:%d: %s\n", sourceName.c_str(), lineNumber, message);
+        std::exit(EXIT_FAILURE);
+    };
+
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        uint64_t tick;
+        std::string command;
+        if (!(fields >> tick)) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                fail("expected a tick number");
+            }
+            continue;
+        }
+        if (!(fields >> command)) {
+            fail("expected a command");
+        }
+        if (!script.events.empty() && tick < script.events.back().tick) {
+            fail("events are not sorted by tick");
+        }
+        if (script.loopLength != 0) {
+            fail("event after loop");
+        }
+
+        Event event = {tick, Command::Press, -1, 0.0f};
+        if (command == "press" || command == "release") {
+            std::string keyName;
+            fields >> keyName;
+            event.command = command == "press" ? Command::Press : Command::Release;
+            event.key = parseKey(keyName);
+            if (event.key < 0) {
+                fail("unknown key (expected W, A, S, D or SHIFT)");
+            }
+        } else if (command == "space") {
+            event.command = Command::Space;
+        } else if (command == "lookat") {
+            event.command = Command::LookAt;
+        } else if (command == "yaw" || command == "pitch") {
+            event.command = command == "yaw" ? Command::Yaw : Command::Pitch;
+            if (!(fields >> event.value)) {
+                fail("expected an angle in radians");
+            }
+        } else if (command == "loop") {
+            if (tick == 0) {
+                fail("loop at tick 0");
+            }
+            script.loopLength = tick;
+            continue;
+        } else {
+            fail("unknown command");
+        }
+        script.events.push_back(event);
+    }
+
+    return script;
+}
+
+void InputScript::apply(uint64_t tick, SimulationInput& input) {
+    if (loopLength != 0) {
+        tick %= loopLength;
+        if (tick == 0) {
+            nextEvent = 0;
+        }
+    }
+
+    while (nextEvent < events.size() && events[nextEvent].tick <= tick) {
+        const Event& event = events[nextEvent++];
+        switch (event.command) {
+            case Command::Press: setKey(input, event.key, true); break;
+            case Command::Release: setKey(input, event.key, false); break;
+            case Command::Space: input.openChest = true; break;
+            case Command::LookAt: input.toggleLookAt = true; break;
+            case Command::Yaw: input.cameraYaw = event.value; break;
+            case Command::Pitch: input.cameraPitch = event.value; break;
+        }
+    }
+}
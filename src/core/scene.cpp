@@ -0,0 +1,209 @@
+#include "core/scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+
+#include "utils/math_utils.h"
+#include "utils/file_utils.h"
+#include "utils/thread_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Mesh loaded by a worker, waiting to be uploaded
+struct LoadedMesh {
+    Mesh mesh;
+    MeshLoadStats stats;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+std::vector<SceneModel> GetSceneModels(const glm::vec4& playerPosition, float playerYaw) {
+    std::vector<SceneModel> models;
+
+    // ----------------------------- COW ----------------------------- //
+    models.push_back({"../../assets/models/cow.obj",
+                      Matrix_Translate(4.0f,1.2f,-90.0f)
+                      * Matrix_Scale(-5.0f,2.0f,2.0f)});
+
+    // ----------------------------- MAZE ----------------------------- //
+    models.push_back({"../../assets/models/maze/", Matrix_Identity()});
+
+    // ----------------------------- CHEST ----------------------------- //
+    models.push_back({"../../assets/models/chest.obj", Matrix_Identity()});
+    models.push_back({"../../assets/models/chest_lid.obj", Matrix_Identity()});
+
+    // ----------------------------- CUBE (PLAYER) ----------------------------- //
+    models.push_back({"../../assets/models/cube.obj",
+                      Matrix_Translate(playerPosition.x, playerPosition.y, playerPosition.z)
+                      * Matrix_Rotate_Y(-playerYaw)});
+
+    return models;
+}
+
+std::vector<std::string> GetModelFiles(const std::string& path) {
+    if (path.empty() || path.back() != '/') {
+        return {path};
+    }
+
+    // Sorted, not in directory order: the maze batch, and the piece indices
+    // of its PVS, follow the order of the files
+    std::vector<std::string> files;
+    for (const auto& file : getFiles(path)) {
+        files.push_back(path + file);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+void LoadSceneMeshes(
+    const std::vector<SceneModel>& sceneModels,
+    const std::function<void(const std::string& file, const glm::mat4& model, Mesh& mesh)>& upload
+) {
+    Clock::time_point start = Clock::now();
+
+    struct Job {
+        std::string file;
+        const SceneModel* sceneModel;
+    };
+    std::vector<Job> jobs;
+    for (const SceneModel& sceneModel : sceneModels) {
+        for (const std::string& file : GetModelFiles(sceneModel.path)) {
+            jobs.push_back({file, &sceneModel});
+        }
+    }
+
+    // One slot per job, filled by the workers in any order
+    std::mutex mutex;
+    std::condition_variable meshReady;
+    std::vector<LoadedMesh> loadedMeshes(jobs.size());
+    std::vector<char> meshLoaded(jobs.size(), 0);
+
+    ThreadPool pool(static_cast<unsigned>(std::min<size_t>(ThreadPool::defaultThreadCount(), jobs.size())));
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        pool.submit([&, i] {
+            LoadedMesh& loaded = loadedMeshes[i];
+            try {
+                loaded.mesh = LoadMesh(jobs[i].file, &loaded.stats);
+            } catch (...) {
+                loaded.error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                meshLoaded[i] = 1;
+            }
+            meshReady.notify_one();
+        });
+    }
+
+    // Upload the meshes in job order, each as soon as it and the ones before
+    // it are loaded: the objects and batches of the scene come out the same
+    // whatever the number of threads and the order they finish in
+    MeshLoadStats total;
+    size_t numFromCache = 0;
+    double uploadTime = 0.0;
+    std::exception_ptr error;
+    for (size_t index = 0; index < jobs.size(); ++index) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            meshReady.wait(lock, [&] { return meshLoaded[index] != 0; });
+        }
+        LoadedMesh loaded = std::move(loadedMeshes[index]);
+        if (loaded.error) {
+            // Wait for the other workers before leaving
+            error = loaded.error;
+            continue;
+        }
+        if (error) {
+            continue;
+        }
+
+        Clock::time_point uploadStart = Clock::now();
+        const Job& job = jobs[index];
+        upload(job.file, job.sceneModel->model, loaded.mesh);
+        uploadTime += millisecondsSince(uploadStart);
+
+        if (!loaded.stats.fromCache) {
+            printf("Cooked \"%s\": %zu -> %zu vertices, ACMR %.3f -> %.3f\n", job.file.c_str(),
+                   loaded.stats.verticesBefore, loaded.stats.verticesAfter,
+                   loaded.stats.acmrBefore, loaded.stats.acmrAfter);
+            for (const MeshShape& shape : loaded.mesh.shapes) {
+                for (const MeshLod& lod : shape.lods) {
+                    printf("  \"%s\" LOD: %u triangles, error %.4f\n", shape.name.c_str(), lod.numIndices / 3,
+                           lod.error);
+                }
+                if (!shape.meshlets.empty()) {
+                    printf("  \"%s\": %zu meshlets\n", shape.name.c_str(), shape.meshlets.size());
+                }
+            }
+        }
+
+        numFromCache += loaded.stats.fromCache ? 1 : 0;
+        total.readTime += loaded.stats.readTime;
+        total.normalsTime += loaded.stats.normalsTime;
+        total.buildTime += loaded.stats.buildTime;
+        total.optimizeTime += loaded.stats.optimizeTime;
+        total.simplifyTime += loaded.stats.simplifyTime;
+        total.meshletTime += loaded.stats.meshletTime;
+        total.packTime += loaded.stats.packTime;
+        total.cacheWriteTime += loaded.stats.cacheWriteTime;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    printf("Loaded %zu meshes (%zu from cache) in %.1f ms on %u threads\n",
+           jobs.size(), numFromCache, millisecondsSince(start), pool.size());
+    printf("  read %.1f ms, normals %.1f ms, buffers %.1f ms, optimize %.1f ms, simplify %.1f ms,"
+           " meshlets %.1f ms, pack %.1f ms, cache write %.1f ms (summed over threads)\n",
+           total.readTime * 1000.0, total.normalsTime * 1000.0, total.buildTime * 1000.0,
+           total.optimizeTime * 1000.0, total.simplifyTime * 1000.0, total.meshletTime * 1000.0,
+           total.packTime * 1000.0, total.cacheWriteTime * 1000.0);
+    printf("  upload %.1f ms\n", uploadTime);
+}
+
+void AddSceneObjects(
+    VirtualScene& virtualScene,
+    const Mesh& mesh,
+    const glm::mat4& modelMatrix,
+    GLuint vertexArrayObjectId,
+    size_t baseIndex,
+    GLenum indexType,
+    const VertexQuantization& quantization
+) {
+    // Every shape is bounded by the whole model, the box in world space and
+    // the sphere in model space
+    AABB aabb(mesh.boundsMin, mesh.boundsMax);
+    aabb.transform(modelMatrix);
+    BSphere bsphere(AABB(mesh.boundsMin, mesh.boundsMax));
+
+    for (const MeshShape& shape : mesh.shapes) {
+        SceneObject sceneObject;
+        sceneObject.name = shape.name;
+        sceneObject.baseIndex = baseIndex + shape.firstIndex;
+        sceneObject.numIndices = shape.numIndices;
+        sceneObject.renderingMode = GL_TRIANGLES;
+        sceneObject.vertexArrayObjectId = vertexArrayObjectId;
+        sceneObject.indexType = indexType;
+        sceneObject.quantization = quantization;
+        for (const MeshLod& lod : shape.lods) {
+            sceneObject.lods.push_back({baseIndex + lod.firstIndex, lod.numIndices, lod.error});
+        }
+        for (Meshlet meshlet : shape.meshlets) {
+            meshlet.firstIndex += static_cast<uint32_t>(baseIndex);
+            sceneObject.meshlets.push_back(meshlet);
+        }
+
+        virtualScene.create(shape.name, GameObject(aabb, bsphere, sceneObject));
+    }
+}
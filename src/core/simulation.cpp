@@ -0,0 +1,287 @@
+#include <cmath>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "utils/math_utils.h"
+#include "core/simulation.h"
+
+SimulationState SimulationState::interpolate(const SimulationState& a, const SimulationState& b, float alpha) {
+    SimulationState result = b;
+    result.playerPosition = glm::mix(a.playerPosition, b.playerPosition, alpha);
+    result.cowPosition = glm::mix(a.cowPosition, b.cowPosition, alpha);
+    for (size_t i = 0; i < result.chestLidRotation.size(); ++i) {
+        result.chestLidRotation[i] = glm::mix(a.chestLidRotation[i], b.chestLidRotation[i], alpha);
+    }
+    return result;
+}
+
+static glm::vec4 bezierCurve2D(glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, float t) {
+    float x = pow(1-t,3) * p0.x
+              + 3 * t * pow(1-t,2) * p1.x
+              + 3 * (1-t) * pow(t,2) * p2.x
+              + pow(t,3) * p3.x;
+    float z = pow(1-t,3) * p0.y
+              + 3 * t * pow(1-t,2) * p1.y
+              + 3 * (1-t) * pow(t,2) * p2.y
+              + pow(t,3)*p3.y;
+
+    return {x, 1.2f, z, 1.0f};
+}
+
+Simulation::Simulation()
+    : p0(0.0f, -90.0f),  // Ponto inicial
+      p1(1.5f, -91.5f),  // Primeiro ponto de controle (mudança gradual)
+      p2(3.5f, -93.0f),  // Segundo ponto de controle (mais alinhado com p1 e p3)
+      p3(5.0f, -94.5f) { // Ponto final (um pouco mais distante para suavizar)
+    state.playerPosition = initialCameraPosition2;
+    state.cowPosition = glm::vec4(0.0f, 1.2f, -90.0f, 1.0f);
+    state.chestLidRotation.assign(numChests, 0.0f);
+    previousState = state;
+}
+
+void Simulation::init(VirtualScene& scene) {
+    virtualScene = &scene;
+    playerObject = scene.find("Cube");
+    cowObject = scene.find("the_cow");
+
+    ObjectHandle chest = scene.find("the_chest");
+    ObjectHandle chestLid = scene.find("the_chest_lid");
+
+    chestBaseModelAABB = scene.get(chest)->getAABB();
+    chestLidModelAABB = scene.get(chestLid)->getAABB();
+
+    // Objects that move after loading, tracked by the dynamic tree
+    std::vector<ObjectHandle> dynamicObjects = {playerObject, cowObject};
+
+    // Place the chests at the specified coordinates
+    chestBaseObjects.clear();
+    chestLidObjects.clear();
+    for (int i = 1; i <= numChests; i++) {
+        glm::vec3 coord = chestCoordinates[i-1];
+
+        ObjectHandle chestBase = scene.create("the_chest" + std::to_string(i), *scene.get(chest));
+        scene.get(chestBase)->translate(coord.x, coord.y, coord.z);
+
+        ObjectHandle chestLidCopy = scene.create("the_chest_lid" + std::to_string(i), *scene.get(chestLid));
+        scene.get(chestLidCopy)->translate(coord.x, coord.y, coord.z);
+
+        chestBaseObjects.push_back(chestBase);
+        chestLidObjects.push_back(chestLidCopy);
+        dynamicObjects.push_back(chestLidCopy);
+    }
+
+    scene.destroy(chest);
+    scene.destroy(chestLid);
+
+    for (ObjectHandle handle : dynamicObjects) {
+        scene.get(handle)->attachToTree(&dynamicTree);
+    }
+
+    // Everything else but the floor is static from now on
+    dynamicObjects.push_back(scene.find("the_plane"));
+    buildStaticCollisionScene(staticCollisionScene, scene, dynamicObjects);
+}
+
+void Simulation::step(const SimulationInput& input) {
+    if (victory || gameOver) {
+        return;
+    }
+
+    previousState = state;
+    ++tick;
+
+    if (input.toggleLookAt) {
+        lookAtMode = !lookAtMode;
+    }
+    movePlayer(input);
+    if (input.openChest) {
+        openChests();
+    }
+    moveCow();
+
+    if (virtualScene->get(playerObject)->intersects(*virtualScene->get(cowObject))) {
+        victory = true;
+        return;
+    }
+
+    timeStarving += tickDuration;
+    if (timeStarving > starvationLimit) {
+        playerLife--;
+        timeStarving = 0.0f;
+        if (playerLife == 0) {
+            gameOver = true;
+        }
+    }
+
+    updateChestLids();
+}
+
+bool Simulation::isLookingAtCow(const SimulationState& s) const {
+    return lookAtMode && glm::distance(s.playerPosition, s.cowPosition) < distanceCameraCowThreshold;
+}
+
+namespace {
+
+// FNV-1a over the bytes of 'value'
+template <typename T>
+void hashBytes(uint64_t& hash, const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+} // namespace
+
+uint64_t Simulation::checksum() const {
+    uint64_t hash = 14695981039346656037ULL;
+    hashBytes(hash, tick);
+    hashBytes(hash, state.playerPosition);
+    hashBytes(hash, state.cowPosition);
+    for (float rotation : state.chestLidRotation) {
+        hashBytes(hash, rotation);
+    }
+    hashBytes(hash, playerLife);
+    hashBytes(hash, timeStarving);
+    hashBytes(hash, cowCurveT);
+
+    // In name order, whatever the order the objects were loaded in
+    if (virtualScene) {
+        for (const auto& [name, handle] : virtualScene->getNames()) {
+            const GameObject* object = virtualScene->get(handle);
+            const AABB& aabb = object->getAABB();
+            const BSphere& bsphere = object->getBSphere();
+            hashBytes(hash, aabb.getMin());
+            hashBytes(hash, aabb.getMax());
+            hashBytes(hash, bsphere.getCenter());
+            hashBytes(hash, bsphere.getRadius());
+        }
+    }
+    return hash;
+}
+
+glm::vec4 Simulation::viewDirection(float yaw, float pitch) {
+    double viewX = std::cos(pitch) * std::sin(yaw);
+    double viewY = std::sin(pitch);
+    double viewZ = std::cos(pitch) * std::cos(yaw);
+    return glm::vec4(viewX, viewY, viewZ, 0.0f);
+}
+
+void Simulation::movePlayer(const SimulationInput& input) {
+    float forward = static_cast<float>(input.moveForward) - static_cast<float>(input.moveBackward);
+    float sideways = static_cast<float>(input.moveRight) - static_cast<float>(input.moveLeft);
+    if (forward == 0.0f && sideways == 0.0f) {
+        return;
+    }
+
+    glm::vec4 view = isLookingAtCow(state)
+        ? normalize(state.cowPosition - state.playerPosition)
+        : viewDirection(input.cameraYaw, input.cameraPitch);
+    glm::vec4 right = normalize(crossproduct(view, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)));
+
+    float speed = input.sprint ? baseSpeed * speedMultiplier : baseSpeed;
+    glm::vec4 offset = speed * tickDuration * (forward * view + sideways * right);
+    offset.y = 0;
+
+    // Swept movement: the player stops at the first object on its way and
+    // slides along it, instead of undoing the whole step
+    glm::vec3 moved = moveAndSlide(virtualScene->get(playerObject), glm::vec3(offset),
+                                   staticCollisionScene, dynamicTree, virtualScene->get(cowObject));
+    state.playerPosition += glm::vec4(moved, 0.0f);
+}
+
+void Simulation::moveCow() {
+    // Update the control points of the Bézier curve (Cow movement)
+    if (cowCurveT >= 1.0f) {
+        cowCurveT = 0.0f;
+
+        if (!cowTurn) {
+            // Forward path
+            p0 = glm::vec2(0.0f, -90.0f);
+            p1 = glm::vec2(1.5f, -91.5f);
+            p2 = glm::vec2(3.5f, -93.0f);
+            p3 = glm::vec2(5.0f, -94.5f);
+        } else {
+            // Backwards path
+            p0 = glm::vec2(5.0f, -94.5f);
+            p1 = glm::vec2(3.5f, -93.0f);
+            p2 = glm::vec2(1.5f, -91.5f);
+            p3 = glm::vec2(0.0f, -90.0f);
+        }
+        cowTurn = !cowTurn; // Changes direction
+    }
+
+    // Atualiza a posição da vaca
+    glm::vec4 lastCowPosition = state.cowPosition;
+    state.cowPosition = bezierCurve2D(p0, p1, p2, p3, cowCurveT);
+
+    // Atualiza AABB e bounding sphere da vaca
+    glm::vec4 cowTranslation = state.cowPosition - lastCowPosition;
+    virtualScene->get(cowObject)->translate(cowTranslation.x, cowTranslation.y, cowTranslation.z);
+
+    // Atualiza o parâmetro "t" da curva de Bézier
+    cowCurveT += cowSpeed * tickDuration;
+}
+
+void Simulation::openChests() {
+    // Space key opens the chest (if the player is close enough)
+    for (int i = 0; i < numChests; i++) {
+        if (glm::distance(glm::vec3(state.playerPosition), chestCoordinates[i]) < 5.0f) {
+            chestOpened[i] = true;
+            if (playerLife < maxLife) {
+                playerLife++;
+            }
+            timeStarving = 0.0f;
+        }
+    }
+}
+
+void Simulation::updateChestLids() {
+    for (int i = 0; i < numChests; i++) {
+        if (!chestOpened[i] || state.chestLidRotation[i] >= M_PI_2) {
+            continue;
+        }
+        // Abrir até 90 graus
+        state.chestLidRotation[i] += tickDuration;
+
+        AABB chestLidAABB = chestLidModelAABB;
+        chestLidAABB.transform(getChestLidModel(i, state.chestLidRotation[i]));
+        virtualScene->get(chestLidObjects[i])->setAABB(chestLidAABB);
+    }
+}
+
+glm::mat4 Simulation::getChestBaseModel(int chestIndex) const {
+    glm::vec3 coord = chestCoordinates[chestIndex];
+    return Matrix_Translate(coord.x, coord.y, coord.z);
+}
+
+glm::mat4 Simulation::getChestLidModel(int chestIndex, float lidRotation) const {
+    glm::vec3 coord = chestCoordinates[chestIndex];
+
+    // The lid AABB rotates with the lid, so the hinge is computed from the
+    // boxes of the models at rest
+    glm::vec4 chestBaseAABBMin = chestBaseModelAABB.getMin();
+    glm::vec4 chestBaseAABBMax = chestBaseModelAABB.getMax();
+
+    glm::vec4 chestLidAABBMin = chestLidModelAABB.getMin();
+    glm::vec4 chestLidAABBMax = chestLidModelAABB.getMax();
+
+    float chestDepth = chestBaseAABBMax.z - chestBaseAABBMin.z;
+    float chestBaseHeight = chestBaseAABBMax.y - chestBaseAABBMin.y;
+    float chestLidHeight = chestLidAABBMax.y - chestLidAABBMin.y;
+
+    // Desloca o baú de modo que a dobradiça fique no centro
+    float chestLidOffsetX = chestDepth / 2.0f;
+    float chestLidOffsetY = (chestBaseHeight - 2.0f * chestLidHeight) / 2.0f;
+
+    return Matrix_Translate(coord.x, coord.y, coord.z)
+           * Matrix_Translate(-chestLidOffsetX, -chestLidOffsetY, 0.0f)
+           * Matrix_Rotate_Z(lidRotation)
+           * Matrix_Translate(chestLidOffsetX, chestLidOffsetY, 0.0f);
+}
+
+glm::mat4 Simulation::getCowModel(const glm::vec4& cowPosition) const {
+    return Matrix_Translate(cowPosition.x, cowPosition.y, cowPosition.z)
+           * Matrix_Scale(2.0f, 2.0f, 2.0f);
+}
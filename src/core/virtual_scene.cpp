@@ -0,0 +1,73 @@
+#include "core/virtual_scene.h"
+
+#include <utility>
+
+ObjectHandle VirtualScene::create(const std::string& name, GameObject object) {
+    auto found = names.find(name);
+    if (found != names.end()) {
+        objects[slotObjects[found->second.slot]] = std::move(object);
+        return found->second;
+    }
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slotObjects.size());
+        slotObjects.push_back(ObjectHandle::nullSlot);
+        generations.push_back(0);
+    }
+
+    slotObjects[slot] = static_cast<uint32_t>(objects.size());
+    objects.push_back(std::move(object));
+    objectNames.push_back(name);
+    objectSlots.push_back(slot);
+
+    ObjectHandle handle;
+    handle.slot = slot;
+    handle.generation = generations[slot];
+    names.emplace(name, handle);
+    return handle;
+}
+
+void VirtualScene::destroy(ObjectHandle handle) {
+    if (!isAlive(handle)) {
+        return;
+    }
+    uint32_t index = slotObjects[handle.slot];
+    names.erase(objectNames[index]);
+
+    // The last object fills the hole
+    uint32_t last = static_cast<uint32_t>(objects.size() - 1);
+    if (index != last) {
+        objects[index] = std::move(objects[last]);
+        objectNames[index] = std::move(objectNames[last]);
+        objectSlots[index] = objectSlots[last];
+        slotObjects[objectSlots[index]] = index;
+    }
+    objects.pop_back();
+    objectNames.pop_back();
+    objectSlots.pop_back();
+
+    slotObjects[handle.slot] = ObjectHandle::nullSlot;
+    ++generations[handle.slot];
+    freeSlots.push_back(handle.slot);
+}
+
+void VirtualScene::clear() {
+    for (uint32_t slot : objectSlots) {
+        slotObjects[slot] = ObjectHandle::nullSlot;
+        ++generations[slot];
+        freeSlots.push_back(slot);
+    }
+    objects.clear();
+    objectNames.clear();
+    objectSlots.clear();
+    names.clear();
+}
+
+ObjectHandle VirtualScene::find(const std::string& name) const {
+    auto found = names.find(name);
+    return found != names.end() ? found->second : ObjectHandle();
+}
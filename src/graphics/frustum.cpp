@@ -0,0 +1,178 @@
+#include "graphics/frustum.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(COWQUEST_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(COWQUEST_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+ViewFrustum ViewFrustum::fromMatrix(const glm::mat4& clip) {
+    // glm matrices are indexed by column: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&clip](int i) { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+    glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+    // -w <= x, y, z <= w inside the clip volume
+    ViewFrustum frustum;
+    frustum.planes[0] = w + x;
+    frustum.planes[1] = w - x;
+    frustum.planes[2] = w + y;
+    frustum.planes[3] = w - y;
+    frustum.planes[4] = w + z;
+    frustum.planes[5] = w - z;
+    return frustum;
+}
+
+// The kernels below must do the same float operations in the same order, so
+// that every instruction set returns exactly the same bits: for each plane,
+// nx*px + ny*py + nz*pz + d < 0 culls the box, p being its corner furthest
+// along the normal of the plane.
+
+bool ViewFrustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+    for (const glm::vec4& plane : planes) {
+        float px = plane.x >= 0.0f ? max.x : min.x;
+        float py = plane.y >= 0.0f ? max.y : min.y;
+        float pz = plane.z >= 0.0f ? max.z : min.z;
+        if (plane.x * px + plane.y * py + plane.z * pz + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ViewFrustum::intersects(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        // The planes are not normalized: scale the radius instead
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FrustumCuller::FrustumCuller() : count(0) {
+    resizeArrays(0);
+}
+
+void FrustumCuller::resizeArrays(size_t numBoxes) {
+    // New entries are empty boxes (min > max), behind every plane: their
+    // furthest corner is made of -FLT_MAX and FLT_MAX coordinates that push
+    // each term of the plane equation down
+    const size_t n = numBoxes + batchSize;
+    minX.resize(n, FLT_MAX); minY.resize(n, FLT_MAX); minZ.resize(n, FLT_MAX);
+    maxX.resize(n, -FLT_MAX); maxY.resize(n, -FLT_MAX); maxZ.resize(n, -FLT_MAX);
+}
+
+size_t FrustumCuller::add(const AABB& aabb) {
+    size_t index = count++;
+    resizeArrays(count);
+    set(index, aabb);
+    return index;
+}
+
+void FrustumCuller::set(size_t index, const AABB& aabb) {
+    glm::vec4 min = aabb.getMin();
+    glm::vec4 max = aabb.getMax();
+    minX[index] = min.x; minY[index] = min.y; minZ[index] = min.z;
+    maxX[index] = max.x; maxY[index] = max.y; maxZ[index] = max.z;
+}
+
+void FrustumCuller::clear() {
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    count = 0;
+    resizeArrays(0);
+}
+
+uint32_t FrustumCuller::testRange(const ViewFrustum& frustum, size_t first, size_t n) const {
+#if defined(COWQUEST_SIMD_AVX2)
+    uint32_t laneMask = n >= batchSize ? (1u << batchSize) - 1u : (1u << n) - 1u;
+    return testLanesAVX2(frustum, first) & laneMask;
+#elif defined(COWQUEST_SIMD_SSE2)
+    uint32_t laneMask = n >= batchSize ? (1u << batchSize) - 1u : (1u << n) - 1u;
+    return testLanesSSE2(frustum, first) & laneMask;
+#else
+    return testLanesScalar(frustum, first, std::min(n, batchSize));
+#endif
+}
+
+uint32_t FrustumCuller::testRangeScalar(const ViewFrustum& frustum, size_t first, size_t n) const {
+    return testLanesScalar(frustum, first, std::min(n, batchSize));
+}
+
+size_t FrustumCuller::cull(const ViewFrustum& frustum, std::vector<uint32_t>& visible) const {
+    size_t numVisible = 0;
+    for (size_t first = 0; first < count; first += batchSize) {
+        uint32_t mask = testRange(frustum, first, count - first);
+        while (mask) {
+            uint32_t bit = CollisionWorld::lowestBit(mask);
+            mask &= mask - 1;
+            visible.push_back(static_cast<uint32_t>(first + bit));
+            ++numVisible;
+        }
+    }
+    return numVisible;
+}
+
+uint32_t FrustumCuller::testLanesScalar(const ViewFrustum& frustum, size_t first, size_t n) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < n; ++lane) {
+        size_t i = first + lane;
+        bool inside = frustum.intersects(glm::vec3(minX[i], minY[i], minZ[i]),
+                                         glm::vec3(maxX[i], maxY[i], maxZ[i]));
+        mask |= static_cast<uint32_t>(inside) << lane;
+    }
+    return mask;
+}
+
+#if defined(COWQUEST_SIMD_AVX2)
+
+uint32_t FrustumCuller::testLanesAVX2(const ViewFrustum& frustum, size_t first) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < batchSize; lane += 8) {
+        const size_t i = first + lane;
+        __m256 outside = _mm256_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            // The furthest corner is the same for every box: pick the arrays
+            const __m256 px = _mm256_loadu_ps(plane.x >= 0.0f ? &maxX[i] : &minX[i]);
+            const __m256 py = _mm256_loadu_ps(plane.y >= 0.0f ? &maxY[i] : &minY[i]);
+            const __m256 pz = _mm256_loadu_ps(plane.z >= 0.0f ? &maxZ[i] : &minZ[i]);
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), px),
+                                            _mm256_mul_ps(_mm256_set1_ps(plane.y), py)),
+                              _mm256_mul_ps(_mm256_set1_ps(plane.z), pz)),
+                _mm256_set1_ps(plane.w));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        mask |= (~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu) << lane;
+    }
+    return mask;
+}
+
+#elif defined(COWQUEST_SIMD_SSE2)
+
+uint32_t FrustumCuller::testLanesSSE2(const ViewFrustum& frustum, size_t first) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < batchSize; lane += 4) {
+        const size_t i = first + lane;
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            // The furthest corner is the same for every box: pick the arrays
+            const __m128 px = _mm_loadu_ps(plane.x >= 0.0f ? &maxX[i] : &minX[i]);
+            const __m128 py = _mm_loadu_ps(plane.y >= 0.0f ? &maxY[i] : &minY[i]);
+            const __m128 pz = _mm_loadu_ps(plane.z >= 0.0f ? &maxZ[i] : &minZ[i]);
+            const __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), px),
+                                      _mm_mul_ps(_mm_set1_ps(plane.y), py)),
+                           _mm_mul_ps(_mm_set1_ps(plane.z), pz)),
+                _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+        mask |= (~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu) << lane;
+    }
+    return mask;
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "graphics/instanced_mesh.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+#include "core/scene.h"
+
+void InstancedMesh::upload(VirtualScene& virtualScene, const Mesh& mesh, const glm::mat4& modelMatrix) {
+    glGenVertexArrays(1, &vertexArrayObjectId);
+    glBindVertexArray(vertexArrayObjectId);
+
+    numIndices = mesh.numIndices;
+    indexType = mesh.indexType;
+    quantization = mesh.quantization;
+
+    AddSceneObjects(virtualScene, mesh, modelMatrix, vertexArrayObjectId, 0, indexType, quantization);
+
+    GLuint VBO_vertices_id;
+    glGenBuffers(1, &VBO_vertices_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_vertices_id);
+    glBufferData(GL_ARRAY_BUFFER, mesh.packedVerticesSize(), mesh.packedVertices, GL_STATIC_DRAW);
+    SetPackedVertexAttributes(mesh.hasNormals, mesh.hasTexCoords);
+
+    // A mat4 attribute takes four locations, one per column, advancing once
+    // per instance
+    glGenBuffers(1, &instanceBufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+    for (GLuint column = 0; column < 4; ++column) {
+        GLuint location = 5 + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLuint indices_id;
+    glGenBuffers(1, &indices_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.packedIndicesSize(), mesh.packedIndices, GL_STATIC_DRAW);
+
+    size_t packedSize = mesh.packedVerticesSize() + mesh.packedIndicesSize();
+    size_t unpackedSize = mesh.numVertices * sizeof(MeshVertex) + mesh.numIndices * sizeof(uint32_t);
+    printf("  %zu vertices, %zu indices: %zu bytes packed, %zu saved (instanced)\n", mesh.numVertices,
+           mesh.numIndices, packedSize, unpackedSize - packedSize);
+
+    glBindVertexArray(0);
+}
+
+void InstancedMesh::setNumInstances(size_t numInstances) {
+    size_t oldNumInstances = instances.size();
+    instances.resize(numInstances, InstanceData{glm::mat4(1.0f)});
+    if (numInstances > oldNumInstances) {
+        markDirty(oldNumInstances, numInstances);
+    }
+}
+
+void InstancedMesh::setInstance(size_t index, const glm::mat4& model) {
+    if (instances[index].model != model) {
+        instances[index].model = model;
+        markDirty(index, index + 1);
+    }
+}
+
+void InstancedMesh::markDirty(size_t begin, size_t end) {
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = begin;
+        dirtyEnd = end;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, begin);
+        dirtyEnd = std::max(dirtyEnd, end);
+    }
+}
+
+void InstancedMesh::draw(RenderQueue& queue, DrawPacket packet, float depth) {
+    if (numIndices == 0 || instances.empty()) {
+        return;
+    }
+
+    if (dirtyBegin < dirtyEnd) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+        if (instances.size() > instanceCapacity) {
+            // Too small: reallocate it with every instance
+            instanceCapacity = instances.size();
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), instances.data(),
+                         GL_DYNAMIC_DRAW);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(InstanceData),
+                            (dirtyEnd - dirtyBegin) * sizeof(InstanceData), &instances[dirtyBegin]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        dirtyBegin = dirtyEnd = 0;
+    }
+
+    packet.vertexArrayObjectId = vertexArrayObjectId;
+    packet.indexType = indexType;
+    packet.count = static_cast<GLsizei>(numIndices);
+    packet.offset = (void*)0;
+    packet.numInstances = static_cast<GLsizei>(instances.size());
+    queue.add(packet, depth);
+}
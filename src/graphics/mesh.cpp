@@ -0,0 +1,502 @@
+#include "graphics/mesh.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "graphics/mesh_optimizer.h"
+#include "graphics/mesh_simplifier.h"
+#include "graphics/meshlets.h"
+#include "utils/math_utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const meshCacheFolder = "../../cache/meshes/";
+
+// Bump when the layout or the processing of the cooked meshes change
+const uint32_t meshCacheVersion = 5;
+const char meshCacheMagic[8] = {'C', 'Q', 'M', 'E', 'S', 'H', '\0', '\0'};
+
+enum MeshCacheFlags : uint32_t {
+    MESH_HAS_NORMALS = 1,
+    MESH_HAS_TEXCOORDS = 2
+};
+
+/* Layout of a cache file, in native byte order: the header, the shape
+ * table, the level of detail table, the meshlet table, the shape names, the
+ * vertices and the indices, then the packed vertices and the packed indices
+ * as glBufferData() takes them, each section starting at a multiple of 16
+ * bytes */
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t sourceSize;  // Size, modification time and hash of the OBJ file
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint32_t numShapes;
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t namesSize;
+    uint32_t numLods;
+    uint32_t numMeshlets;
+    uint32_t indexType;   // Of the packed indices
+    uint32_t padding;
+    float boundsMin[4];
+    float boundsMax[4];
+    float quantizationOffset[4]; // Of the packed vertices, [3] is padding
+    float quantizationScale[4];
+    uint64_t shapesOffset;
+    uint64_t lodsOffset;
+    uint64_t meshletsOffset;
+    uint64_t namesOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t packedVerticesOffset;
+    uint64_t packedIndicesOffset;
+    uint64_t fileSize;
+};
+
+struct MeshCacheShape {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstIndex;
+    uint32_t numIndices;
+};
+
+struct MeshCacheLod {
+    uint32_t shape;
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float error;
+};
+
+struct MeshCacheMeshlet {
+    uint32_t shape;
+    Meshlet meshlet;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t alignOffset(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// Map a cache file and point 'mesh' at its buffers. Returns false if the
+// file is missing, invalid or out of date.
+bool readMeshCache(const std::string& cachePath, const std::string& objFilePath,
+                   const SourceInfo& source, Mesh& mesh) {
+    MappedFile mapping;
+    if (!mapping.open(cachePath) || mapping.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0
+        || header.version != meshCacheVersion
+        || header.fileSize != mapping.size()
+        || header.sourceSize != source.size) {
+        return false;
+    }
+    // A new modification time alone (a checkout, a copy) does not make the
+    // cache stale: only a different content does
+    bool timeChanged = header.sourceTime != source.time;
+    if (timeChanged && header.sourceHash != hashFile(objFilePath)) {
+        return false;
+    }
+
+    uint64_t shapesEnd = header.shapesOffset + uint64_t(header.numShapes) * sizeof(MeshCacheShape);
+    uint64_t lodsEnd = header.lodsOffset + uint64_t(header.numLods) * sizeof(MeshCacheLod);
+    uint64_t meshletsEnd = header.meshletsOffset + uint64_t(header.numMeshlets) * sizeof(MeshCacheMeshlet);
+    uint64_t verticesEnd = header.verticesOffset + uint64_t(header.numVertices) * sizeof(MeshVertex);
+    uint64_t indicesEnd = header.indicesOffset + uint64_t(header.numIndices) * sizeof(uint32_t);
+    // The index type that PackIndices() gives this many vertices
+    GLenum indexType = header.numVertices <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    uint64_t packedVerticesEnd = header.packedVerticesOffset + uint64_t(header.numVertices) * sizeof(PackedVertex);
+    uint64_t packedIndicesEnd = header.packedIndicesOffset + uint64_t(header.numIndices) * IndexSize(indexType);
+    if (shapesEnd > mapping.size() || lodsEnd > mapping.size() || meshletsEnd > mapping.size()
+        || header.namesOffset + header.namesSize > mapping.size()
+        || verticesEnd > mapping.size() || indicesEnd > mapping.size()
+        || packedVerticesEnd > mapping.size() || packedIndicesEnd > mapping.size()
+        || header.indexType != indexType
+        || header.verticesOffset % 16 != 0 || header.indicesOffset % 16 != 0
+        || header.packedVerticesOffset % 16 != 0 || header.packedIndicesOffset % 16 != 0) {
+        return false;
+    }
+
+    const uint8_t* data = mapping.data();
+
+    // Every index must name a vertex of the file: the PVS, the occluders and
+    // the GPU read the vertices through them unchecked. The packed indices
+    // are the same, narrowed or not.
+    const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + header.indicesOffset);
+    const uint8_t* packedIndices = data + header.packedIndicesOffset;
+    const uint16_t* shortIndices = reinterpret_cast<const uint16_t*>(packedIndices);
+    const uint32_t* intIndices = reinterpret_cast<const uint32_t*>(packedIndices);
+    for (uint32_t i = 0; i < header.numIndices; ++i) {
+        uint32_t packedIndex = indexType == GL_UNSIGNED_SHORT ? shortIndices[i] : intIndices[i];
+        if (indices[i] >= header.numVertices || packedIndex != indices[i]) {
+            return false;
+        }
+    }
+
+    const char* names = reinterpret_cast<const char*>(data + header.namesOffset);
+    mesh.shapes.resize(header.numShapes);
+    for (uint32_t i = 0; i < header.numShapes; ++i) {
+        MeshCacheShape shape;
+        std::memcpy(&shape, data + header.shapesOffset + i * sizeof(MeshCacheShape), sizeof(shape));
+        if (uint64_t(shape.nameOffset) + shape.nameLength > header.namesSize
+            || uint64_t(shape.firstIndex) + shape.numIndices > header.numIndices) {
+            return false;
+        }
+        mesh.shapes[i].name.assign(names + shape.nameOffset, shape.nameLength);
+        mesh.shapes[i].firstIndex = shape.firstIndex;
+        mesh.shapes[i].numIndices = shape.numIndices;
+    }
+    for (uint32_t i = 0; i < header.numLods; ++i) {
+        MeshCacheLod lod;
+        std::memcpy(&lod, data + header.lodsOffset + i * sizeof(MeshCacheLod), sizeof(lod));
+        if (lod.shape >= header.numShapes || uint64_t(lod.firstIndex) + lod.numIndices > header.numIndices) {
+            return false;
+        }
+        mesh.shapes[lod.shape].lods.push_back({lod.firstIndex, lod.numIndices, lod.error});
+    }
+    for (uint32_t i = 0; i < header.numMeshlets; ++i) {
+        MeshCacheMeshlet meshlet;
+        std::memcpy(&meshlet, data + header.meshletsOffset + i * sizeof(MeshCacheMeshlet), sizeof(meshlet));
+        if (meshlet.shape >= header.numShapes
+            || uint64_t(meshlet.meshlet.firstIndex) + meshlet.meshlet.numIndices > header.numIndices) {
+            return false;
+        }
+        mesh.shapes[meshlet.shape].meshlets.push_back(meshlet.meshlet);
+    }
+
+    mesh.boundsMin = glm::vec4(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2], header.boundsMin[3]);
+    mesh.boundsMax = glm::vec4(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2], header.boundsMax[3]);
+    mesh.hasNormals = (header.flags & MESH_HAS_NORMALS) != 0;
+    mesh.hasTexCoords = (header.flags & MESH_HAS_TEXCOORDS) != 0;
+
+    mesh.vertices = reinterpret_cast<const MeshVertex*>(data + header.verticesOffset);
+    mesh.numVertices = header.numVertices;
+    mesh.indices = indices;
+    mesh.numIndices = header.numIndices;
+
+    mesh.quantization.offset = glm::vec3(header.quantizationOffset[0], header.quantizationOffset[1],
+                                         header.quantizationOffset[2]);
+    mesh.quantization.scale = glm::vec3(header.quantizationScale[0], header.quantizationScale[1],
+                                        header.quantizationScale[2]);
+    mesh.packedVertices = reinterpret_cast<const PackedVertex*>(data + header.packedVerticesOffset);
+    mesh.packedIndices = packedIndices;
+    mesh.indexType = indexType;
+    mesh.mapping = std::move(mapping);
+
+    // Same content under a new time: store the time, so that the next starts
+    // do not hash the file again
+    if (timeChanged && !patchFile(cachePath, offsetof(MeshCacheHeader, sourceTime), &source.time,
+                                  sizeof(source.time))) {
+        fprintf(stderr, "WARNING: could not update mesh cache \"%s\".\n", cachePath.c_str());
+    }
+    return true;
+}
+
+// Write the cooked mesh next to the other cache files. Failures only cost
+// the next start a parse, so they are reported and ignored.
+void writeMeshCache(const std::string& cachePath, const std::string& objFilePath,
+                    const SourceInfo& source, const Mesh& mesh) {
+    std::error_code error;
+    fs::create_directories(fs::path(cachePath).parent_path(), error);
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+    header.version = meshCacheVersion;
+    header.flags = (mesh.hasNormals ? MESH_HAS_NORMALS : 0) | (mesh.hasTexCoords ? MESH_HAS_TEXCOORDS : 0);
+    header.sourceSize = source.size;
+    header.sourceTime = source.time;
+    header.sourceHash = hashFile(objFilePath);
+    header.numShapes = static_cast<uint32_t>(mesh.shapes.size());
+    header.numVertices = static_cast<uint32_t>(mesh.numVertices);
+    header.numIndices = static_cast<uint32_t>(mesh.numIndices);
+    header.indexType = mesh.indexType;
+    for (int i = 0; i < 4; ++i) {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsMax[i] = mesh.boundsMax[i];
+    }
+    for (int i = 0; i < 3; ++i) {
+        header.quantizationOffset[i] = mesh.quantization.offset[i];
+        header.quantizationScale[i] = mesh.quantization.scale[i];
+    }
+
+    std::vector<MeshCacheShape> shapes;
+    std::vector<MeshCacheLod> lods;
+    std::vector<MeshCacheMeshlet> meshlets;
+    std::string names;
+    for (const MeshShape& shape : mesh.shapes) {
+        for (const MeshLod& lod : shape.lods) {
+            lods.push_back({static_cast<uint32_t>(shapes.size()), lod.firstIndex, lod.numIndices, lod.error});
+        }
+        for (const Meshlet& meshlet : shape.meshlets) {
+            meshlets.push_back({static_cast<uint32_t>(shapes.size()), meshlet});
+        }
+        shapes.push_back({static_cast<uint32_t>(names.size()), static_cast<uint32_t>(shape.name.size()),
+                          shape.firstIndex, shape.numIndices});
+        names += shape.name;
+    }
+    header.namesSize = static_cast<uint32_t>(names.size());
+    header.numLods = static_cast<uint32_t>(lods.size());
+    header.numMeshlets = static_cast<uint32_t>(meshlets.size());
+
+    header.shapesOffset = alignOffset(sizeof(header));
+    header.lodsOffset = header.shapesOffset + shapes.size() * sizeof(MeshCacheShape);
+    header.meshletsOffset = header.lodsOffset + lods.size() * sizeof(MeshCacheLod);
+    header.namesOffset = header.meshletsOffset + meshlets.size() * sizeof(MeshCacheMeshlet);
+    header.verticesOffset = alignOffset(header.namesOffset + names.size());
+    header.indicesOffset = alignOffset(header.verticesOffset + mesh.numVertices * sizeof(MeshVertex));
+    header.packedVerticesOffset = alignOffset(header.indicesOffset + mesh.numIndices * sizeof(uint32_t));
+    header.packedIndicesOffset = alignOffset(header.packedVerticesOffset + mesh.packedVerticesSize());
+    header.fileSize = header.packedIndicesOffset + mesh.packedIndicesSize();
+
+    std::vector<uint8_t> data(header.fileSize, 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    if (!shapes.empty()) {
+        std::memcpy(data.data() + header.shapesOffset, shapes.data(), shapes.size() * sizeof(MeshCacheShape));
+    }
+    if (!lods.empty()) {
+        std::memcpy(data.data() + header.lodsOffset, lods.data(), lods.size() * sizeof(MeshCacheLod));
+    }
+    if (!meshlets.empty()) {
+        std::memcpy(data.data() + header.meshletsOffset, meshlets.data(),
+                    meshlets.size() * sizeof(MeshCacheMeshlet));
+    }
+    std::memcpy(data.data() + header.namesOffset, names.data(), names.size());
+    if (mesh.numVertices > 0) {
+        std::memcpy(data.data() + header.verticesOffset, mesh.vertices, mesh.numVertices * sizeof(MeshVertex));
+    }
+    if (mesh.numIndices > 0) {
+        std::memcpy(data.data() + header.indicesOffset, mesh.indices, mesh.numIndices * sizeof(uint32_t));
+    }
+    if (mesh.numVertices > 0) {
+        std::memcpy(data.data() + header.packedVerticesOffset, mesh.packedVertices, mesh.packedVerticesSize());
+    }
+    if (mesh.numIndices > 0) {
+        std::memcpy(data.data() + header.packedIndicesOffset, mesh.packedIndices, mesh.packedIndicesSize());
+    }
+
+    // Write a temporary file and rename it, so that a cache file is never
+    // seen half written
+    std::string tempPath = makeTempPath(cachePath);
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            fprintf(stderr, "WARNING: could not write mesh cache \"%s\".\n", tempPath.c_str());
+            return;
+        }
+    }
+    fs::rename(tempPath, cachePath, error);
+    if (error) {
+        fprintf(stderr, "WARNING: could not write mesh cache \"%s\": %s.\n", cachePath.c_str(), error.message().c_str());
+        fs::remove(tempPath, error);
+    }
+}
+
+} // namespace
+
+void ComputeNormals(ObjModel* model) {
+    if ( !model->attrib.normals.empty() ) {
+        return;
+    }
+    // Using Goraud model for normals
+    size_t num_vertices = model->attrib.vertices.size() / 3;
+
+    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
+    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape) {
+        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle) {
+            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            glm::vec4  vertices[3];
+            for (size_t vertex = 0; vertex < 3; ++vertex) {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
+                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
+                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
+                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
+            }
+
+            const glm::vec4  a = vertices[0];
+            const glm::vec4  b = vertices[1];
+            const glm::vec4  c = vertices[2];
+
+            // a, b, c defined in counterclockwise order
+            const glm::vec4 n = ComputeTriangleNormal(a, c, b);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex) {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+                num_triangles_per_vertex[idx.vertex_index] += 1;
+                vertex_normals[idx.vertex_index] += n;
+                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
+            }
+        }
+    }
+    model->attrib.normals.resize( 3*num_vertices );
+
+    for (size_t i = 0; i < vertex_normals.size(); ++i) {
+        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
+        n /= norm(n);
+        model->attrib.normals[3*i + 0] = n.x;
+        model->attrib.normals[3*i + 1] = n.y;
+        model->attrib.normals[3*i + 2] = n.z;
+    }
+}
+
+Mesh BuildMesh(const ObjModel& model) {
+    Mesh mesh;
+    bool firstVertex = true;
+
+    for (size_t shape = 0; shape < model.shapes.size(); ++shape) {
+        const tinyobj::mesh_t& shapeMesh = model.shapes[shape].mesh;
+        size_t firstIndex = mesh.indexStorage.size();
+        size_t numTriangles = shapeMesh.num_face_vertices.size();
+
+        for (size_t triangle = 0; triangle < numTriangles; ++triangle) {
+            assert(shapeMesh.num_face_vertices[triangle] == 3);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex) {
+                tinyobj::index_t idx = shapeMesh.indices[3*triangle + vertex];
+                MeshVertex meshVertex = {};
+
+                meshVertex.position[0] = model.attrib.vertices[3*idx.vertex_index + 0];
+                meshVertex.position[1] = model.attrib.vertices[3*idx.vertex_index + 1];
+                meshVertex.position[2] = model.attrib.vertices[3*idx.vertex_index + 2];
+                meshVertex.position[3] = 1.0f;
+
+                if (idx.normal_index != -1) {
+                    meshVertex.normal[0] = model.attrib.normals[3*idx.normal_index + 0];
+                    meshVertex.normal[1] = model.attrib.normals[3*idx.normal_index + 1];
+                    meshVertex.normal[2] = model.attrib.normals[3*idx.normal_index + 2];
+                    mesh.hasNormals = true;
+                }
+
+                if (idx.texcoord_index != -1) {
+                    meshVertex.texcoord[0] = model.attrib.texcoords[2*idx.texcoord_index + 0];
+                    meshVertex.texcoord[1] = model.attrib.texcoords[2*idx.texcoord_index + 1];
+                    mesh.hasTexCoords = true;
+                }
+
+                glm::vec4 position(meshVertex.position[0], meshVertex.position[1], meshVertex.position[2], 1.0f);
+                if (firstVertex) {
+                    mesh.boundsMin = position;
+                    mesh.boundsMax = position;
+                    firstVertex = false;
+                }
+                mesh.boundsMin = glm::min(mesh.boundsMin, position);
+                mesh.boundsMax = glm::max(mesh.boundsMax, position);
+
+                mesh.indexStorage.push_back(static_cast<uint32_t>(mesh.vertexStorage.size()));
+                mesh.vertexStorage.push_back(meshVertex);
+            }
+        }
+
+        MeshShape meshShape;
+        meshShape.name = model.shapes[shape].name;
+        meshShape.firstIndex = static_cast<uint32_t>(firstIndex);
+        meshShape.numIndices = static_cast<uint32_t>(mesh.indexStorage.size() - firstIndex);
+        mesh.shapes.push_back(meshShape);
+    }
+
+    mesh.vertices = mesh.vertexStorage.data();
+    mesh.numVertices = mesh.vertexStorage.size();
+    mesh.indices = mesh.indexStorage.data();
+    mesh.numIndices = mesh.indexStorage.size();
+    return mesh;
+}
+
+std::string GetMeshCachePath(const std::string& objFilePath) {
+    // "../../assets/models/maze/maze1.obj" -> "assets_models_maze_maze1.obj.mesh"
+    std::string name = objFilePath;
+    while (name.compare(0, 3, "../") == 0 || name.compare(0, 3, "..\\") == 0) {
+        name.erase(0, 3);
+    }
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') {
+            c = '_';
+        }
+    }
+    return meshCacheFolder + name + ".mesh";
+}
+
+Mesh LoadMesh(const std::string& objFilePath, MeshLoadStats* stats) {
+    std::string cachePath = GetMeshCachePath(objFilePath);
+    MeshLoadStats localStats;
+    if (stats == nullptr) {
+        stats = &localStats;
+    }
+    *stats = MeshLoadStats();
+
+    SourceInfo source;
+    if (!getSourceInfo(objFilePath, source)) {
+        fprintf(stderr, "ERROR: could not find model \"%s\".\n", objFilePath.c_str());
+        throw std::runtime_error("Erro ao carregar modelo.");
+    }
+
+    Mesh mesh;
+    Clock::time_point start = Clock::now();
+    if (readMeshCache(cachePath, objFilePath, source, mesh)) {
+        stats->fromCache = true;
+        stats->readTime = secondsSince(start);
+        return mesh;
+    }
+
+    ObjModel model(objFilePath.c_str());
+    stats->readTime = secondsSince(start);
+
+    start = Clock::now();
+    ComputeNormals(&model);
+    stats->normalsTime = secondsSince(start);
+
+    start = Clock::now();
+    mesh = BuildMesh(model);
+    stats->buildTime = secondsSince(start);
+
+    start = Clock::now();
+    MeshOptimizeStats optimizeStats;
+    OptimizeMesh(mesh, &optimizeStats);
+    stats->optimizeTime = secondsSince(start);
+    stats->verticesBefore = optimizeStats.verticesBefore;
+    stats->verticesAfter = optimizeStats.verticesAfter;
+    stats->acmrBefore = optimizeStats.acmrBefore;
+    stats->acmrAfter = optimizeStats.acmrAfter;
+
+    start = Clock::now();
+    GenerateMeshLods(mesh);
+    stats->simplifyTime = secondsSince(start);
+
+    start = Clock::now();
+    GenerateMeshlets(mesh);
+    stats->meshletTime = secondsSince(start);
+
+    // Once here rather than at every upload, which copies the cached
+    // buffers as they are
+    start = Clock::now();
+    PackMesh(mesh);
+    stats->packTime = secondsSince(start);
+
+    start = Clock::now();
+    writeMeshCache(cachePath, objFilePath, source, mesh);
+    stats->cacheWriteTime = secondsSince(start);
+    return mesh;
+}
@@ -0,0 +1,251 @@
+#include "graphics/mesh_optimizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Hash and equality of the bytes of a vertex: only vertices that are
+// exactly the same are merged
+struct VertexHash {
+    size_t operator()(const MeshVertex& vertex) const {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < sizeof(MeshVertex); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const MeshVertex& a, const MeshVertex& b) const {
+        return std::memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+    }
+};
+
+// Parameters of the Forsyth vertex score, from the original article
+const int forsythCacheSize = 32;
+const float cacheDecayPower = 1.5f;
+const float lastTriangleScore = 0.75f;
+const float valenceBoostScale = 2.0f;
+const float valenceBoostPower = 0.5f;
+
+// Score of a vertex at 'cachePosition' (-1 when not in the cache) still
+// used by 'numActiveTriangles' triangles not emitted yet
+float vertexScore(int cachePosition, uint32_t numActiveTriangles) {
+    if (numActiveTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Vertices of the last triangle: a fixed score, so that the
+            // next triangle does not simply reuse the same edge
+            score = lastTriangleScore;
+        } else {
+            float scaler = 1.0f / (forsythCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+        }
+    }
+
+    // Vertices with few triangles left are finished first
+    score += valenceBoostScale * std::pow(static_cast<float>(numActiveTriangles), -valenceBoostPower);
+    return score;
+}
+
+} // namespace
+
+size_t WeldVertices(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    std::unordered_map<MeshVertex, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<MeshVertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto inserted = uniqueVertices.emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+        if (inserted.second) {
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for (uint32_t& index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVertices) {
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    // Triangles of each vertex, in one array: vertex v owns the range
+    // [adjacencyOffset[v], adjacencyOffset[v] + numActive[v]), and emitted
+    // triangles are moved out of the range
+    std::vector<uint32_t> numActive(numVertices, 0);
+    for (size_t i = 0; i < numIndices; ++i) {
+        numActive[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffset(numVertices + 1, 0);
+    for (size_t v = 0; v < numVertices; ++v) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + numActive[v];
+    }
+    std::vector<uint32_t> adjacency(numIndices);
+    {
+        std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < numIndices; ++i) {
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> score(numVertices);
+    for (size_t v = 0; v < numVertices; ++v) {
+        score[v] = vertexScore(-1, numActive[v]);
+    }
+    std::vector<float> triangleScore(numTriangles);
+    for (size_t t = 0; t < numTriangles; ++t) {
+        triangleScore[t] = score[indices[3*t]] + score[indices[3*t + 1]] + score[indices[3*t + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(numIndices);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<uint32_t> cache;    // Most recently used first
+    std::vector<uint32_t> newCache;
+    size_t scanPosition = 0;        // Triangles before it were all emitted
+    int64_t bestTriangle = -1;
+
+    for (size_t numEmitted = 0; numEmitted < numTriangles; ++numEmitted) {
+        if (bestTriangle < 0) {
+            // Nothing left around the cache: start again from the first
+            // triangle not emitted yet
+            while (emitted[scanPosition]) {
+                ++scanPosition;
+            }
+            bestTriangle = static_cast<int64_t>(scanPosition);
+        }
+
+        size_t triangle = static_cast<size_t>(bestTriangle);
+        emitted[triangle] = true;
+        const uint32_t* corners = &indices[3*triangle];
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = corners[k];
+            result.push_back(v);
+
+            // Remove the triangle from the ones left for the vertex
+            uint32_t* first = &adjacency[adjacencyOffset[v]];
+            uint32_t* last = first + numActive[v] - 1;
+            for (uint32_t* it = first; it <= last; ++it) {
+                if (*it == triangle) {
+                    std::swap(*it, *last);
+                    break;
+                }
+            }
+            numActive[v]--;
+        }
+
+        // The vertices of the triangle go to the front of the cache
+        newCache.assign(corners, corners + 3);
+        for (uint32_t v : cache) {
+            if (v != corners[0] && v != corners[1] && v != corners[2]) {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < static_cast<size_t>(forsythCacheSize) ? static_cast<int>(i) : -1;
+            score[v] = vertexScore(cachePosition[v], numActive[v]);
+        }
+
+        // Rescore the triangles around the cache and pick the best one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : newCache) {
+            for (uint32_t i = 0; i < numActive[v]; ++i) {
+                uint32_t t = adjacency[adjacencyOffset[v] + i];
+                triangleScore[t] = score[indices[3*t]] + score[indices[3*t + 1]] + score[indices[3*t + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (newCache.size() > static_cast<size_t>(forsythCacheSize)) {
+            newCache.resize(forsythCacheSize);
+        }
+        cache.swap(newCache);
+    }
+
+    std::memcpy(indices, result.data(), numIndices * sizeof(uint32_t));
+}
+
+void OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<MeshVertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+float ComputeACMR(const uint32_t* indices, size_t numIndices, size_t numVertices, unsigned cacheSize) {
+    if (numIndices < 3) {
+        return 0.0f;
+    }
+
+    // A vertex is still in the FIFO if it was inserted less than
+    // 'cacheSize' insertions ago
+    std::vector<uint64_t> insertedAt(numVertices, 0);
+    uint64_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < numIndices; ++i) {
+        uint32_t v = indices[i];
+        if (time - insertedAt[v] > cacheSize) {
+            insertedAt[v] = time++;
+            ++misses;
+        }
+    }
+    return static_cast<float>(misses) / (numIndices / 3);
+}
+
+void OptimizeMesh(Mesh& mesh, MeshOptimizeStats* stats) {
+    std::vector<MeshVertex>& vertices = mesh.vertexStorage;
+    std::vector<uint32_t>& indices = mesh.indexStorage;
+
+    if (stats) {
+        stats->verticesBefore = vertices.size();
+        stats->acmrBefore = ComputeACMR(indices.data(), indices.size(), vertices.size());
+    }
+
+    WeldVertices(vertices, indices);
+    for (const MeshShape& shape : mesh.shapes) {
+        OptimizeVertexCache(&indices[shape.firstIndex], shape.numIndices, vertices.size());
+    }
+    OptimizeVertexFetch(vertices, indices);
+
+    if (stats) {
+        stats->verticesAfter = vertices.size();
+        stats->acmrAfter = ComputeACMR(indices.data(), indices.size(), vertices.size());
+    }
+
+    mesh.vertices = vertices.data();
+    mesh.numVertices = vertices.size();
+    mesh.indices = indices.data();
+    mesh.numIndices = indices.size();
+}
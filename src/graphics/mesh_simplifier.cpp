@@ -0,0 +1,352 @@
+#include "graphics/mesh_simplifier.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "graphics/mesh_optimizer.h"
+
+namespace {
+
+// Collapses that turn a triangle further than this (cosine of the angle
+// between its normals before and after) would fold the surface
+const double maxNormalTurn = 0.2;
+
+/* Sum of squared distances to a set of planes, each weighted by the area of
+ * its triangle: Q(p) = p^T A p + 2 b.p + c, A symmetric */
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(const glm::dvec3& normal, double distance, double weight) {
+        Quadric q;
+        q.a00 = weight * normal.x * normal.x;
+        q.a01 = weight * normal.x * normal.y;
+        q.a02 = weight * normal.x * normal.z;
+        q.a11 = weight * normal.y * normal.y;
+        q.a12 = weight * normal.y * normal.z;
+        q.a22 = weight * normal.z * normal.z;
+        q.b0 = weight * normal.x * distance;
+        q.b1 = weight * normal.y * distance;
+        q.b2 = weight * normal.z * distance;
+        q.c = weight * distance * distance;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02;
+        a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // Area weighted RMS distance of 'p' to the planes
+    double error(const glm::dvec3& p) const {
+        double sum = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                   + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                   + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0.0 ? std::sqrt(std::max(sum, 0.0) / weight) : 0.0;
+    }
+};
+
+Quadric operator+(Quadric a, const Quadric& b) {
+    return a += b;
+}
+
+/* Collapse of 'vertex' onto 'target', valid while the vertex keeps its
+ * version */
+struct Collapse {
+    double error;
+    uint32_t vertex;
+    uint32_t target;
+    uint32_t version;
+
+    bool operator>(const Collapse& other) const { return error > other.error; }
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        // -0.0 and 0.0 compare equal, so they must hash the same: adding
+        // 0.0 turns the former into the latter
+        glm::vec3 key = p + glm::vec3(0.0f);
+        uint32_t bits[3];
+        std::memcpy(bits, &key, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+} // namespace
+
+std::vector<SimplifiedTriangles> SimplifyTriangles(const MeshVertex* vertices, size_t numVertices,
+                                                   const uint32_t* indices, size_t numIndices,
+                                                   const std::vector<size_t>& targetTriangles) {
+    std::vector<SimplifiedTriangles> levels;
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0 || targetTriangles.empty()) {
+        return levels;
+    }
+
+    std::vector<glm::dvec3> positions(numVertices);
+    for (size_t i = 0; i < numVertices; ++i) {
+        positions[i] = glm::dvec3(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
+    }
+
+    // Vertices used by these triangles that share their position with
+    // another one, across an attribute seam
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positionIds;
+    std::vector<uint32_t> positionId(numVertices, 0);
+    std::vector<uint32_t> positionUsers;
+    std::vector<uint32_t> used(numVertices, 0);
+    for (size_t i = 0; i < numIndices; ++i) {
+        uint32_t v = indices[i];
+        if (used[v]++ > 0) {
+            continue;
+        }
+        glm::vec3 position(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+        auto inserted = positionIds.emplace(position, static_cast<uint32_t>(positionUsers.size()));
+        if (inserted.second) {
+            positionUsers.push_back(0);
+        }
+        positionId[v] = inserted.first->second;
+        ++positionUsers[positionId[v]];
+    }
+
+    // Edges of a single triangle, by position so that seams are not borders
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t t = 0; t < numTriangles; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            uint64_t a = positionId[indices[3 * t + k]];
+            uint64_t b = positionId[indices[3 * t + (k + 1) % 3]];
+            ++edgeUses[std::min(a, b) << 32 | std::max(a, b)];
+        }
+    }
+    std::vector<bool> borderPosition(positionUsers.size(), false);
+    for (const auto& edge : edgeUses) {
+        if (edge.second == 1) {
+            borderPosition[edge.first >> 32] = true;
+            borderPosition[edge.first & 0xFFFFFFFFu] = true;
+        }
+    }
+    std::vector<bool> seam(numVertices, false);
+    std::vector<bool> locked(numVertices, false);
+    for (size_t v = 0; v < numVertices; ++v) {
+        if (used[v] > 0) {
+            seam[v] = positionUsers[positionId[v]] > 1;
+            locked[v] = seam[v] || borderPosition[positionId[v]];
+        }
+    }
+
+    // Triangles, the triangles around each vertex and the quadric of the
+    // planes of those triangles
+    std::vector<uint32_t> triangles(indices, indices + numTriangles * 3);
+    std::vector<bool> aliveTriangle(numTriangles, true);
+    std::vector<std::vector<uint32_t>> vertexTriangles(numVertices);
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t t = 0; t < numTriangles; ++t) {
+        const glm::dvec3& a = positions[triangles[3 * t]];
+        const glm::dvec3& b = positions[triangles[3 * t + 1]];
+        const glm::dvec3& c = positions[triangles[3 * t + 2]];
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double length = glm::length(normal);
+        if (length > 0.0) {
+            normal /= length;
+            Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, a), 0.5 * length);
+            for (int k = 0; k < 3; ++k) {
+                quadrics[triangles[3 * t + k]] += plane;
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            vertexTriangles[triangles[3 * t + k]].push_back(static_cast<uint32_t>(t));
+        }
+    }
+
+    std::vector<uint32_t> versions(numVertices, 0);
+    std::vector<bool> removed(numVertices, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    // Cheapest collapse of a free vertex onto one of its neighbours
+    auto pushCollapse = [&](uint32_t u) {
+        if (locked[u] || removed[u]) {
+            return;
+        }
+        double best = std::numeric_limits<double>::max();
+        uint32_t target = u;
+        for (uint32_t t : vertexTriangles[u]) {
+            if (!aliveTriangle[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                uint32_t w = triangles[3 * t + k];
+                if (w == u || seam[w]) {
+                    continue;
+                }
+                double error = (quadrics[u] + quadrics[w]).error(positions[w]);
+                if (error < best) {
+                    best = error;
+                    target = w;
+                }
+            }
+        }
+        if (target != u) {
+            queue.push({best, u, target, ++versions[u]});
+        }
+    };
+    for (size_t v = 0; v < numVertices; ++v) {
+        if (used[v] > 0) {
+            pushCollapse(static_cast<uint32_t>(v));
+        }
+    }
+
+    std::vector<uint32_t> neighbourStamp(numVertices, 0);
+    uint32_t stamp = 0;
+    size_t numAlive = numTriangles;
+    double maxError = 0.0;
+    size_t level = 0;
+
+    auto takeLevel = [&]() {
+        SimplifiedTriangles simplified;
+        simplified.error = static_cast<float>(maxError);
+        for (size_t t = 0; t < numTriangles; ++t) {
+            if (aliveTriangle[t]) {
+                simplified.indices.insert(simplified.indices.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+            }
+        }
+        levels.push_back(std::move(simplified));
+    };
+
+    while (level < targetTriangles.size() && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+        uint32_t u = collapse.vertex;
+        uint32_t v = collapse.target;
+        if (removed[u] || removed[v] || collapse.version != versions[u]) {
+            continue;
+        }
+
+        // Keep the surface a manifold: the edge must be shared by at most
+        // two triangles, the only ones the collapse removes
+        ++stamp;
+        for (uint32_t t : vertexTriangles[u]) {
+            if (aliveTriangle[t]) {
+                for (int k = 0; k < 3; ++k) {
+                    neighbourStamp[triangles[3 * t + k]] = stamp;
+                }
+            }
+        }
+        size_t numShared = 0;
+        ++stamp;
+        for (uint32_t t : vertexTriangles[v]) {
+            if (!aliveTriangle[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                uint32_t w = triangles[3 * t + k];
+                if (w != u && w != v && neighbourStamp[w] == stamp - 1) {
+                    neighbourStamp[w] = stamp;
+                    ++numShared;
+                }
+            }
+        }
+        if (numShared > 2) {
+            continue;
+        }
+
+        // Nor fold it over
+        bool folds = false;
+        for (uint32_t t : vertexTriangles[u]) {
+            const uint32_t* corners = &triangles[3 * t];
+            if (!aliveTriangle[t] || corners[0] == v || corners[1] == v || corners[2] == v) {
+                continue;
+            }
+            glm::dvec3 before[3], after[3];
+            for (int k = 0; k < 3; ++k) {
+                before[k] = positions[corners[k]];
+                after[k] = corners[k] == u ? positions[v] : before[k];
+            }
+            glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            double lengths = glm::length(normalBefore) * glm::length(normalAfter);
+            if (!(glm::dot(normalBefore, normalAfter) > maxNormalTurn * lengths)) {
+                folds = true;
+                break;
+            }
+        }
+        if (folds) {
+            continue;
+        }
+
+        for (uint32_t t : vertexTriangles[u]) {
+            if (!aliveTriangle[t]) {
+                continue;
+            }
+            uint32_t* corners = &triangles[3 * t];
+            if (corners[0] == v || corners[1] == v || corners[2] == v) {
+                aliveTriangle[t] = false;
+                --numAlive;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (corners[k] == u) {
+                    corners[k] = v;
+                }
+            }
+            vertexTriangles[v].push_back(t);
+        }
+        removed[u] = true;
+        quadrics[v] += quadrics[u];
+        maxError = std::max(maxError, collapse.error);
+
+        // The collapses around the target changed
+        pushCollapse(v);
+        for (uint32_t t : vertexTriangles[v]) {
+            if (aliveTriangle[t]) {
+                for (int k = 0; k < 3; ++k) {
+                    if (triangles[3 * t + k] != v) {
+                        pushCollapse(triangles[3 * t + k]);
+                    }
+                }
+            }
+        }
+
+        while (level < targetTriangles.size() && numAlive <= targetTriangles[level]) {
+            takeLevel();
+            ++level;
+        }
+    }
+    return levels;
+}
+
+void GenerateMeshLods(Mesh& mesh, size_t minTriangles, size_t numLods) {
+    std::vector<uint32_t>& indices = mesh.indexStorage;
+    for (MeshShape& shape : mesh.shapes) {
+        size_t numTriangles = shape.numIndices / 3;
+        if (numTriangles < minTriangles) {
+            continue;
+        }
+
+        std::vector<size_t> targets;
+        for (size_t i = 1; i <= numLods; ++i) {
+            targets.push_back(numTriangles >> i);
+        }
+        std::vector<SimplifiedTriangles> levels = SimplifyTriangles(
+            mesh.vertexStorage.data(), mesh.vertexStorage.size(),
+            &indices[shape.firstIndex], shape.numIndices, targets);
+
+        for (SimplifiedTriangles& level : levels) {
+            OptimizeVertexCache(level.indices.data(), level.indices.size(), mesh.vertexStorage.size());
+            shape.lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.indices.size()),
+                                  level.error});
+            indices.insert(indices.end(), level.indices.begin(), level.indices.end());
+        }
+    }
+
+    mesh.indices = indices.data();
+    mesh.numIndices = indices.size();
+}
@@ -0,0 +1,261 @@
+#include "graphics/meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "graphics/mesh_optimizer.h"
+
+namespace {
+
+// Weights of the normal of a candidate triangle and of the triangles left
+// around its vertices, against the number of new vertices it brings, which
+// they never outweigh
+const float normalCost = 0.25f;
+const float liveCost = 0.05f;
+const uint32_t maxLiveCount = 9;
+
+glm::vec3 vertexPosition(const MeshVertex& vertex) {
+    return glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+}
+
+// Bounding sphere and normal cone of the triangles of a meshlet
+void computeBounds(const MeshVertex* vertices, const uint32_t* indices, size_t numIndices,
+                   const std::vector<glm::vec3>& normals, const uint32_t* triangles, Meshlet& meshlet) {
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (size_t i = 0; i < numIndices; ++i) {
+        glm::vec3 p = vertexPosition(vertices[indices[i]]);
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    glm::vec3 center = 0.5f * (min + max);
+    float radius = 0.0f;
+    for (size_t i = 0; i < numIndices; ++i) {
+        radius = std::max(radius, glm::length(vertexPosition(vertices[indices[i]]) - center));
+    }
+
+    size_t numTriangles = numIndices / 3;
+    glm::vec3 axis(0.0f);
+    for (size_t t = 0; t < numTriangles; ++t) {
+        axis += normals[triangles[t]];
+    }
+    float coneCutoff = 1.0f;
+    if (glm::length(axis) > 0.0f) {
+        axis = glm::normalize(axis);
+        float minDot = 1.0f;
+        for (size_t t = 0; t < numTriangles; ++t) {
+            const glm::vec3& normal = normals[triangles[t]];
+            if (normal != glm::vec3(0.0f)) {
+                minDot = std::min(minDot, glm::dot(axis, normal));
+            }
+        }
+        // Cones of 90 degrees or more never face away entirely
+        if (minDot > 0.0f) {
+            coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        meshlet.center[k] = center[k];
+        meshlet.coneAxis[k] = axis[k];
+    }
+    meshlet.radius = radius;
+    meshlet.coneCutoff = coneCutoff;
+}
+
+} // namespace
+
+std::vector<Meshlet> BuildMeshlets(const MeshVertex* vertices, size_t numVertices,
+                                   uint32_t* indices, size_t numIndices,
+                                   size_t maxVertices, size_t maxTriangles) {
+    std::vector<Meshlet> meshlets;
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+        return meshlets;
+    }
+
+    // Triangles around each vertex, and the unit normal of each triangle
+    std::vector<uint32_t> firstTriangle(numVertices + 1, 0);
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        ++firstTriangle[indices[i] + 1];
+    }
+    for (size_t v = 0; v < numVertices; ++v) {
+        firstTriangle[v + 1] += firstTriangle[v];
+    }
+    std::vector<uint32_t> vertexTriangles(numTriangles * 3);
+    std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    std::vector<glm::vec3> normals(numTriangles);
+    for (size_t t = 0; t < numTriangles; ++t) {
+        glm::vec3 a = vertexPosition(vertices[indices[3 * t]]);
+        glm::vec3 b = vertexPosition(vertices[indices[3 * t + 1]]);
+        glm::vec3 c = vertexPosition(vertices[indices[3 * t + 2]]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        for (int k = 0; k < 3; ++k) {
+            vertexTriangles[fill[indices[3 * t + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<uint32_t> liveTriangles(numVertices); // Not emitted yet, around each vertex
+    for (size_t v = 0; v < numVertices; ++v) {
+        liveTriangles[v] = firstTriangle[v + 1] - firstTriangle[v];
+    }
+    auto liveCount = [&](uint32_t t) {
+        uint32_t count = liveTriangles[indices[3 * t]] + liveTriangles[indices[3 * t + 1]]
+                       + liveTriangles[indices[3 * t + 2]];
+        return std::min(count, maxLiveCount);
+    };
+
+    std::vector<uint32_t> vertexMeshlet(numVertices, UINT32_MAX); // Last meshlet using each vertex
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> meshletTriangles;
+    std::vector<uint32_t> previousVertices;
+    std::vector<uint32_t> reordered;
+    reordered.reserve(numTriangles * 3);
+    glm::vec3 normalSum(0.0f);
+    size_t seed = 0;
+
+    auto flush = [&]() {
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+        meshlet.numIndices = static_cast<uint32_t>(meshletTriangles.size() * 3);
+        for (uint32_t t : meshletTriangles) {
+            reordered.insert(reordered.end(), &indices[3 * t], &indices[3 * t] + 3);
+        }
+        computeBounds(vertices, &reordered[meshlet.firstIndex], meshlet.numIndices, normals,
+                      meshletTriangles.data(), meshlet);
+        OptimizeVertexCache(&reordered[meshlet.firstIndex], meshlet.numIndices, numVertices);
+        meshlets.push_back(meshlet);
+
+        previousVertices.swap(meshletVertices);
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        normalSum = glm::vec3(0.0f);
+    };
+
+    auto add = [&](uint32_t t) {
+        uint32_t id = static_cast<uint32_t>(meshlets.size());
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[3 * t + k];
+            if (vertexMeshlet[v] != id) {
+                vertexMeshlet[v] = id;
+                meshletVertices.push_back(v);
+            }
+            --liveTriangles[v];
+        }
+        meshletTriangles.push_back(t);
+        normalSum += normals[t];
+        emitted[t] = true;
+    };
+
+    while (true) {
+        if (meshletTriangles.empty()) {
+            // Start next to the last meshlet, from the triangle with the
+            // fewest triangles left around it, so that no islands of a few
+            // triangles are left behind
+            uint32_t next = UINT32_MAX;
+            uint32_t fewest = UINT32_MAX;
+            for (uint32_t v : previousVertices) {
+                for (uint32_t i = firstTriangle[v]; i < firstTriangle[v + 1]; ++i) {
+                    uint32_t t = vertexTriangles[i];
+                    if (!emitted[t] && liveCount(t) < fewest) {
+                        fewest = liveCount(t);
+                        next = t;
+                    }
+                }
+            }
+            if (next == UINT32_MAX) {
+                while (seed < numTriangles && emitted[seed]) {
+                    ++seed;
+                }
+                if (seed == numTriangles) {
+                    break;
+                }
+                next = static_cast<uint32_t>(seed);
+            }
+            add(next);
+            continue;
+        }
+
+        // Best triangle sharing a vertex with the meshlet
+        uint32_t id = static_cast<uint32_t>(meshlets.size());
+        glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+        float bestCost = FLT_MAX;
+        uint32_t best = UINT32_MAX;
+        size_t bestNewVertices = 0;
+        for (uint32_t v : meshletVertices) {
+            for (uint32_t i = firstTriangle[v]; i < firstTriangle[v + 1]; ++i) {
+                uint32_t t = vertexTriangles[i];
+                if (emitted[t]) {
+                    continue;
+                }
+                size_t newVertices = 0;
+                for (int k = 0; k < 3; ++k) {
+                    newVertices += vertexMeshlet[indices[3 * t + k]] != id ? 1 : 0;
+                }
+                float cost = newVertices + normalCost * (1.0f - glm::dot(axis, normals[t]))
+                           + liveCost * liveCount(t);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    best = t;
+                    bestNewVertices = newVertices;
+                }
+            }
+        }
+
+        // The cheapest triangle needs the fewest vertices, so if it does
+        // not fit, no other one does
+        if (best == UINT32_MAX || meshletVertices.size() + bestNewVertices > maxVertices) {
+            flush();
+        } else {
+            add(best);
+            if (meshletTriangles.size() == maxTriangles) {
+                flush();
+            }
+        }
+    }
+    if (!meshletTriangles.empty()) {
+        flush();
+    }
+
+    std::copy(reordered.begin(), reordered.end(), indices);
+    return meshlets;
+}
+
+void GenerateMeshlets(Mesh& mesh, size_t minTriangles) {
+    for (MeshShape& shape : mesh.shapes) {
+        if (shape.numIndices / 3 < minTriangles) {
+            continue;
+        }
+        shape.meshlets = BuildMeshlets(mesh.vertexStorage.data(), mesh.vertexStorage.size(),
+                                       &mesh.indexStorage[shape.firstIndex], shape.numIndices);
+        for (Meshlet& meshlet : shape.meshlets) {
+            meshlet.firstIndex += shape.firstIndex;
+        }
+    }
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const ViewFrustum& frustum, const glm::vec3& cameraPosition) {
+    glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+    if (!frustum.intersects(center, meshlet.radius)) {
+        return false;
+    }
+    glm::vec3 toCenter = center - cameraPosition;
+    glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+    return glm::dot(toCenter, axis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+size_t CullMeshlets(const Meshlet* meshlets, size_t numMeshlets, const ViewFrustum& frustum,
+                    const glm::vec3& cameraPosition, std::vector<uint32_t>& visible) {
+    size_t numCulled = 0;
+    for (size_t i = 0; i < numMeshlets; ++i) {
+        if (IsMeshletVisible(meshlets[i], frustum, cameraPosition)) {
+            visible.push_back(static_cast<uint32_t>(i));
+        } else {
+            numCulled += meshlets[i].numIndices / 3;
+        }
+    }
+    return numCulled;
+}
@@ -0,0 +1,426 @@
+#include "graphics/occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(COWQUEST_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(COWQUEST_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Rows are walked in steps of this many pixels, from a multiple of it, by
+// every kernel: the scalar one tests exactly the same pixels as the others
+const int rowStep = 8;
+
+// Pixel coordinates and NDC depth of a clip space point in front of the
+// near plane
+glm::vec3 toPixel(const glm::vec4& position) {
+    float invW = 1.0f / position.w;
+    return glm::vec3((position.x * invW * 0.5f + 0.5f) * OcclusionBuffer::width,
+                     (position.y * invW * 0.5f + 0.5f) * OcclusionBuffer::height,
+                     position.z * invW);
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer() : depths(static_cast<size_t>(width) * height, 1.0f) {
+    glm::ivec2 size(width, height);
+    levelSizes.push_back(size);
+    size_t offset = 0;
+    while (size.x > 1 || size.y > 1) {
+        size = glm::ivec2((size.x + 1) / 2, (size.y + 1) / 2);
+        levelSizes.push_back(size);
+        levelOffsets.push_back(offset);
+        offset += static_cast<size_t>(size.x) * size.y;
+    }
+    hierarchy.assign(offset, 1.0f);
+}
+
+void OcclusionBuffer::clear(const glm::mat4& clip_) {
+    clip = clip_;
+    std::fill(depths.begin(), depths.end(), 1.0f);
+    std::fill(hierarchy.begin(), hierarchy.end(), 1.0f);
+    numTrianglesDrawn = 0;
+}
+
+void OcclusionBuffer::drawTriangles(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                                    size_t numIndices) {
+    drawTriangles(positions, numPositions, indices, numIndices, true);
+}
+
+void OcclusionBuffer::drawTrianglesScalar(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                                          size_t numIndices) {
+    drawTriangles(positions, numPositions, indices, numIndices, false);
+}
+
+void OcclusionBuffer::drawTriangles(const glm::vec3* positions, size_t numPositions, const uint32_t* indices,
+                                    size_t numIndices, bool simd) {
+    clipPositions.resize(numPositions);
+    for (size_t i = 0; i < numPositions; ++i) {
+        clipPositions[i] = clip * glm::vec4(positions[i], 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < numIndices; i += 3) {
+        const glm::vec4& a = clipPositions[indices[i]];
+        const glm::vec4& b = clipPositions[indices[i + 1]];
+        const glm::vec4& c = clipPositions[indices[i + 2]];
+
+        // Entirely beside the screen or beyond the far plane
+        if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w)
+            || (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w)
+            || (a.z > a.w && b.z > b.w && c.z > c.w)) {
+            continue;
+        }
+        drawClipTriangle(a, b, c, simd);
+    }
+}
+
+void OcclusionBuffer::drawClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, bool simd) {
+    // Distances to the near plane, w + z >= 0 in front of it
+    const glm::vec4 input[3] = {a, b, c};
+    float distances[3] = {a.w + a.z, b.w + b.z, c.w + c.z};
+    if (distances[0] >= 0.0f && distances[1] >= 0.0f && distances[2] >= 0.0f) {
+        rasterize(toPixel(a), toPixel(b), toPixel(c), simd);
+        return;
+    }
+
+    // Keep the part in front of it (Sutherland and Hodgman), a triangle or
+    // a quad
+    glm::vec4 polygon[4];
+    int numVertices = 0;
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        if (distances[i] >= 0.0f) {
+            polygon[numVertices++] = input[i];
+        }
+        if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f)) {
+            float t = distances[i] / (distances[i] - distances[j]);
+            polygon[numVertices++] = input[i] + t * (input[j] - input[i]);
+        }
+    }
+    for (int i = 2; i < numVertices; ++i) {
+        rasterize(toPixel(polygon[0]), toPixel(polygon[i - 1]), toPixel(polygon[i]), simd);
+    }
+}
+
+void OcclusionBuffer::rasterize(const glm::vec3& a, const glm::vec3& b_, const glm::vec3& c_, bool simd) {
+    glm::vec3 b = b_;
+    glm::vec3 c = c_;
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (!(std::fabs(area) > 1e-6f)) {
+        return;
+    }
+    // Both faces are drawn: make it counterclockwise
+    if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    float minX = std::min(a.x, std::min(b.x, c.x));
+    float maxX = std::max(a.x, std::max(b.x, c.x));
+    float minY = std::min(a.y, std::min(b.y, c.y));
+    float maxY = std::max(a.y, std::max(b.y, c.y));
+    if (maxX < 0.0f || minX >= width || maxY < 0.0f || minY >= height) {
+        return;
+    }
+
+    RasterTriangle triangle;
+    triangle.minX = static_cast<int>(std::floor(std::max(minX, 0.0f)));
+    triangle.maxX = static_cast<int>(std::floor(std::min(maxX, width - 1.0f)));
+    triangle.minY = static_cast<int>(std::floor(std::max(minY, 0.0f)));
+    triangle.maxY = static_cast<int>(std::floor(std::min(maxY, height - 1.0f)));
+
+    // Edge from v0 to v1: (v1 - v0) x (p - v0) >= 0 inside
+    const glm::vec3* vertices[3] = {&a, &b, &c};
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec3& v0 = *vertices[i];
+        const glm::vec3& v1 = *vertices[(i + 1) % 3];
+        triangle.edgeA[i] = v0.y - v1.y;
+        triangle.edgeB[i] = v1.x - v0.x;
+        triangle.edgeC[i] = -(triangle.edgeA[i] * v0.x + triangle.edgeB[i] * v0.y);
+    }
+
+    // NDC depth is linear in screen space
+    triangle.depthA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+    triangle.depthB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+    triangle.depthC = a.z - triangle.depthA * a.x - triangle.depthB * a.y;
+
+    ++numTrianglesDrawn;
+#if defined(COWQUEST_SIMD_AVX2)
+    if (simd) {
+        rasterizeAVX2(triangle);
+        return;
+    }
+#elif defined(COWQUEST_SIMD_SSE2)
+    if (simd) {
+        rasterizeSSE2(triangle);
+        return;
+    }
+#endif
+    rasterizeScalar(triangle);
+}
+
+// The kernels below must do the same float operations in the same order, so
+// that every instruction set draws exactly the same depths: at the center
+// (px, py) of a pixel, each edge is a * px + (b * py + c), the depth is
+// depthA * px + (depthB * py + depthC), and px is (x + 0.5) + lane.
+
+void OcclusionBuffer::rasterizeScalar(const RasterTriangle& triangle) {
+    int firstX = triangle.minX & ~(rowStep - 1);
+    for (int y = triangle.minY; y <= triangle.maxY; ++y) {
+        float py = static_cast<float>(y) + 0.5f;
+        float rowEdge[3];
+        for (int i = 0; i < 3; ++i) {
+            rowEdge[i] = triangle.edgeB[i] * py + triangle.edgeC[i];
+        }
+        float rowDepth = triangle.depthB * py + triangle.depthC;
+
+        float* row = &depths[static_cast<size_t>(y) * width];
+        for (int x = firstX; x <= triangle.maxX; x += rowStep) {
+            float base = static_cast<float>(x) + 0.5f;
+            for (int lane = 0; lane < rowStep; ++lane) {
+                float px = base + static_cast<float>(lane);
+                float e0 = triangle.edgeA[0] * px + rowEdge[0];
+                float e1 = triangle.edgeA[1] * px + rowEdge[1];
+                float e2 = triangle.edgeA[2] * px + rowEdge[2];
+                float depth = triangle.depthA * px + rowDepth;
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                    row[x + lane] = row[x + lane] < depth ? row[x + lane] : depth;
+                }
+            }
+        }
+    }
+}
+
+#if defined(COWQUEST_SIMD_AVX2)
+
+void OcclusionBuffer::rasterizeAVX2(const RasterTriangle& triangle) {
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 edgeA0 = _mm256_set1_ps(triangle.edgeA[0]);
+    const __m256 edgeA1 = _mm256_set1_ps(triangle.edgeA[1]);
+    const __m256 edgeA2 = _mm256_set1_ps(triangle.edgeA[2]);
+    const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+
+    int firstX = triangle.minX & ~(rowStep - 1);
+    for (int y = triangle.minY; y <= triangle.maxY; ++y) {
+        float py = static_cast<float>(y) + 0.5f;
+        const __m256 rowEdge0 = _mm256_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+        const __m256 rowEdge1 = _mm256_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+        const __m256 rowEdge2 = _mm256_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+        const __m256 rowDepth = _mm256_set1_ps(triangle.depthB * py + triangle.depthC);
+
+        float* row = &depths[static_cast<size_t>(y) * width];
+        for (int x = firstX; x <= triangle.maxX; x += rowStep) {
+            const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x) + 0.5f), lanes);
+            const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(edgeA0, px), rowEdge0);
+            const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(edgeA1, px), rowEdge1);
+            const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(edgeA2, px), rowEdge2);
+            const __m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, px), rowDepth);
+            const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                                                              _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                                                _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+            const __m256 old = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, depth), inside));
+        }
+    }
+}
+
+#elif defined(COWQUEST_SIMD_SSE2)
+
+void OcclusionBuffer::rasterizeSSE2(const RasterTriangle& triangle) {
+    const __m128 lanes[2] = {_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)};
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+    const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+    const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+    const __m128 depthA = _mm_set1_ps(triangle.depthA);
+
+    int firstX = triangle.minX & ~(rowStep - 1);
+    for (int y = triangle.minY; y <= triangle.maxY; ++y) {
+        float py = static_cast<float>(y) + 0.5f;
+        const __m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+        const __m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+        const __m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+        const __m128 rowDepth = _mm_set1_ps(triangle.depthB * py + triangle.depthC);
+
+        float* row = &depths[static_cast<size_t>(y) * width];
+        for (int x = firstX; x <= triangle.maxX; x += rowStep) {
+            const __m128 base = _mm_set1_ps(static_cast<float>(x) + 0.5f);
+            for (int half = 0; half < 2; ++half) {
+                const __m128 px = _mm_add_ps(base, lanes[half]);
+                const __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA0, px), rowEdge0);
+                const __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA1, px), rowEdge1);
+                const __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA2, px), rowEdge2);
+                const __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth);
+                const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                                 _mm_cmpge_ps(e2, zero));
+                float* pixels = row + x + 4 * half;
+                const __m128 old = _mm_loadu_ps(pixels);
+                _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, depth)),
+                                                _mm_andnot_ps(inside, old)));
+            }
+        }
+    }
+}
+
+#endif
+
+void OcclusionBuffer::buildHierarchy() {
+    for (size_t level = 1; level < levelSizes.size(); ++level) {
+        glm::ivec2 below = levelSizes[level - 1];
+        glm::ivec2 size = levelSizes[level];
+        float* texels = &hierarchy[levelOffsets[level - 1]];
+        for (int y = 0; y < size.y; ++y) {
+            int y0 = 2 * y;
+            int y1 = std::min(2 * y + 1, below.y - 1);
+            for (int x = 0; x < size.x; ++x) {
+                int x0 = 2 * x;
+                int x1 = std::min(2 * x + 1, below.x - 1);
+                texels[y * size.x + x] = std::max(std::max(getLevelDepth(level - 1, x0, y0),
+                                                           getLevelDepth(level - 1, x1, y0)),
+                                                  std::max(getLevelDepth(level - 1, x0, y1),
+                                                           getLevelDepth(level - 1, x1, y1)));
+            }
+        }
+    }
+}
+
+float OcclusionBuffer::getLevelDepth(int level, int x, int y) const {
+    if (level == 0) {
+        return depths[static_cast<size_t>(y) * width + x];
+    }
+    return hierarchy[levelOffsets[level - 1] + static_cast<size_t>(y) * levelSizes[level].x + x];
+}
+
+bool OcclusionBuffer::isVisible(const glm::vec3& min, const glm::vec3& max) const {
+    // Screen rectangle and nearest depth of the corners
+    glm::vec2 rectMin(std::numeric_limits<float>::max());
+    glm::vec2 rectMax(-std::numeric_limits<float>::max());
+    float nearest = std::numeric_limits<float>::max();
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 corner = clip * glm::vec4((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y,
+                                            (i & 4) ? max.z : min.z, 1.0f);
+        if (corner.w + corner.z < 0.0f) {
+            return true;
+        }
+        glm::vec3 pixel = toPixel(corner);
+        rectMin = glm::min(rectMin, glm::vec2(pixel));
+        rectMax = glm::max(rectMax, glm::vec2(pixel));
+        nearest = std::min(nearest, pixel.z);
+    }
+    if (rectMax.x < 0.0f || rectMin.x >= width || rectMax.y < 0.0f || rectMin.y >= height) {
+        return true;
+    }
+
+    int x0 = static_cast<int>(std::floor(std::max(rectMin.x, 0.0f)));
+    int x1 = static_cast<int>(std::floor(std::min(rectMax.x, width - 1.0f)));
+    int y0 = static_cast<int>(std::floor(std::max(rectMin.y, 0.0f)));
+    int y1 = static_cast<int>(std::floor(std::min(rectMax.y, height - 1.0f)));
+
+    // Lowest level where the rectangle covers at most 4x4 texels
+    int level = 0;
+    while ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3) {
+        ++level;
+    }
+    for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+            if (nearest <= getLevelDepth(level, x, y)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+OcclusionCuller::OcclusionCuller() {
+    worker = std::thread(&OcclusionCuller::workerLoop, this);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    endFrame();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frameRequested.notify_one();
+    worker.join();
+}
+
+void OcclusionCuller::addOccluder(const std::vector<glm::vec3>& occluderPositions,
+                                  const std::vector<uint32_t>& occluderIndices) {
+    if (occluderPositions.empty() || occluderIndices.empty()) {
+        return;
+    }
+    glm::vec3 boundsMin = occluderPositions.front();
+    glm::vec3 boundsMax = boundsMin;
+    for (const glm::vec3& position : occluderPositions) {
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    occluderCuller.add(AABB(glm::vec4(boundsMin, 1.0f), glm::vec4(boundsMax, 1.0f)));
+
+    occluders.push_back({static_cast<uint32_t>(positions.size()), static_cast<uint32_t>(occluderPositions.size()),
+                         static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(occluderIndices.size())});
+    positions.insert(positions.end(), occluderPositions.begin(), occluderPositions.end());
+    indices.insert(indices.end(), occluderIndices.begin(), occluderIndices.end());
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& clip_) {
+    endFrame();
+    clip = clip_;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        framePending = true;
+    }
+    frameInProgress = true;
+    frameRequested.notify_one();
+}
+
+void OcclusionCuller::endFrame() {
+    if (!frameInProgress) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    frameFinished.wait(lock, [this] { return !framePending; });
+    frameInProgress = false;
+    hasFrame = true;
+}
+
+void OcclusionCuller::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        frameRequested.wait(lock, [this] { return framePending || stopping; });
+        if (stopping) {
+            return;
+        }
+        lock.unlock();
+        drawFrame();
+        lock.lock();
+        framePending = false;
+        frameFinished.notify_one();
+    }
+}
+
+void OcclusionCuller::drawFrame() {
+    Clock::time_point start = Clock::now();
+
+    buffer.clear(clip);
+    visibleOccluders.clear();
+    numOccludersDrawn = occluderCuller.cull(ViewFrustum::fromMatrix(clip), visibleOccluders);
+    for (uint32_t i : visibleOccluders) {
+        const Occluder& occluder = occluders[i];
+        buffer.drawTriangles(&positions[occluder.firstPosition], occluder.numPositions,
+                             &indices[occluder.firstIndex], occluder.numIndices);
+    }
+    buffer.buildHierarchy();
+
+    frameTime = std::chrono::duration<double>(Clock::now() - start).count();
+}
@@ -0,0 +1,460 @@
+#include "graphics/pvs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "utils/thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const pvsCacheFolder = "../../cache/pvs/";
+
+// Bump when the layout or the sampling of the cached sets change
+const uint32_t pvsCacheVersion = 1;
+const char pvsCacheMagic[8] = {'C', 'Q', 'P', 'V', 'S', '\0', '\0', '\0'};
+
+/* Layout of a cache file, in native byte order: the header, then the
+ * bitsets of every cell, 'wordsPerCell' words each */
+struct PvsCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numPieces;
+    uint64_t key;
+    float gridMin[2];
+    float cellSize;
+    int32_t cellsX;
+    int32_t cellsZ;
+    uint32_t wordsPerCell;
+    uint64_t fileSize;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+/* Triangle of a piece, set up for the ray test (Moller and Trumbore) */
+struct PvsTriangle {
+    glm::vec3 v0;
+    glm::vec3 edge1;
+    glm::vec3 edge2;
+    uint32_t piece;
+};
+
+/* The triangles of the pieces, bucketed in a grid over (x, z) so that a ray
+ * only tests those of the grid cells it crosses, nearest first */
+class OccluderGrid {
+public:
+    OccluderGrid(std::vector<PvsTriangle> triangles, glm::vec2 gridMin, float cellSize,
+                 int cellsX, int cellsZ, float minY, float maxY);
+
+    size_t getNumTriangles() const { return triangles.size(); }
+
+    // Piece first hit by the ray from 'origin' along 'direction' (unit
+    // length) within 'maxDistance', or -1. 'stamps' holds one entry per
+    // triangle, so that a triangle in several grid cells is tested once.
+    int castRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                std::vector<uint32_t>& stamps, uint32_t rayId) const;
+
+private:
+    std::vector<PvsTriangle> triangles;
+    std::vector<uint32_t> cellStart; // Triangles of cell c: cellTriangles[cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> cellTriangles;
+    glm::vec2 gridMin;
+    float cellSize;
+    int cellsX, cellsZ;
+    float minY, maxY; // Rays leaving these heights hit the floor or the sky
+};
+
+OccluderGrid::OccluderGrid(std::vector<PvsTriangle> triangles_, glm::vec2 gridMin_, float cellSize_,
+                           int cellsX_, int cellsZ_, float minY_, float maxY_)
+    : triangles(std::move(triangles_)), gridMin(gridMin_), cellSize(cellSize_),
+      cellsX(cellsX_), cellsZ(cellsZ_), minY(minY_), maxY(maxY_) {
+    // Grid cells under the (x, z) box of each triangle, counted then filled
+    size_t numCells = static_cast<size_t>(cellsX) * cellsZ;
+    std::vector<glm::ivec4> ranges(triangles.size());
+    cellStart.assign(numCells + 1, 0);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        const PvsTriangle& triangle = triangles[t];
+        glm::vec3 v1 = triangle.v0 + triangle.edge1;
+        glm::vec3 v2 = triangle.v0 + triangle.edge2;
+        glm::vec2 low = glm::min(glm::vec2(triangle.v0.x, triangle.v0.z), glm::min(glm::vec2(v1.x, v1.z), glm::vec2(v2.x, v2.z)));
+        glm::vec2 high = glm::max(glm::vec2(triangle.v0.x, triangle.v0.z), glm::max(glm::vec2(v1.x, v1.z), glm::vec2(v2.x, v2.z)));
+        glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor((low - gridMin) / cellSize)), glm::ivec2(0), glm::ivec2(cellsX - 1, cellsZ - 1));
+        glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor((high - gridMin) / cellSize)), glm::ivec2(0), glm::ivec2(cellsX - 1, cellsZ - 1));
+        ranges[t] = glm::ivec4(first, last);
+        for (int j = first.y; j <= last.y; ++j) {
+            for (int i = first.x; i <= last.x; ++i) {
+                ++cellStart[j * cellsX + i + 1];
+            }
+        }
+    }
+    for (size_t c = 0; c < numCells; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    cellTriangles.resize(cellStart[numCells]);
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        for (int j = ranges[t].y; j <= ranges[t].w; ++j) {
+            for (int i = ranges[t].x; i <= ranges[t].z; ++i) {
+                cellTriangles[fill[j * cellsX + i]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+}
+
+int OccluderGrid::castRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                          std::vector<uint32_t>& stamps, uint32_t rayId) const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float minDistance = 1e-4f;
+
+    float tMax = maxDistance;
+    if (direction.y > 0.0f) {
+        tMax = std::min(tMax, (maxY - origin.y) / direction.y);
+    } else if (direction.y < 0.0f) {
+        tMax = std::min(tMax, (minY - origin.y) / direction.y);
+    }
+
+    // Walk the grid cells along the ray (Amanatides and Woo)
+    glm::vec2 position = (glm::vec2(origin.x, origin.z) - gridMin) / cellSize;
+    int cellX = std::clamp(static_cast<int>(std::floor(position.x)), 0, cellsX - 1);
+    int cellZ = std::clamp(static_cast<int>(std::floor(position.y)), 0, cellsZ - 1);
+    int stepX = direction.x > 0.0f ? 1 : -1;
+    int stepZ = direction.z > 0.0f ? 1 : -1;
+    float deltaX = direction.x != 0.0f ? cellSize / std::fabs(direction.x) : infinity;
+    float deltaZ = direction.z != 0.0f ? cellSize / std::fabs(direction.z) : infinity;
+    float nextX = direction.x != 0.0f
+        ? (gridMin.x + (cellX + (stepX > 0 ? 1 : 0)) * cellSize - origin.x) / direction.x : infinity;
+    float nextZ = direction.z != 0.0f
+        ? (gridMin.y + (cellZ + (stepZ > 0 ? 1 : 0)) * cellSize - origin.z) / direction.z : infinity;
+
+    float nearest = tMax;
+    int nearestPiece = -1;
+    for (;;) {
+        size_t cell = static_cast<size_t>(cellZ) * cellsX + cellX;
+        for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+            uint32_t t = cellTriangles[k];
+            if (stamps[t] == rayId) {
+                continue;
+            }
+            stamps[t] = rayId;
+
+            // Both faces block the ray
+            const PvsTriangle& triangle = triangles[t];
+            glm::vec3 p = glm::cross(direction, triangle.edge2);
+            float det = glm::dot(triangle.edge1, p);
+            if (std::fabs(det) < 1e-12f) {
+                continue;
+            }
+            float invDet = 1.0f / det;
+            glm::vec3 s = origin - triangle.v0;
+            float u = glm::dot(s, p) * invDet;
+            if (u < 0.0f || u > 1.0f) {
+                continue;
+            }
+            glm::vec3 q = glm::cross(s, triangle.edge1);
+            float v = glm::dot(direction, q) * invDet;
+            if (v < 0.0f || u + v > 1.0f) {
+                continue;
+            }
+            float distance = glm::dot(triangle.edge2, q) * invDet;
+            if (distance > minDistance && distance < nearest) {
+                nearest = distance;
+                nearestPiece = static_cast<int>(triangle.piece);
+            }
+        }
+
+        // Nothing in the following cells can be nearer than a hit in this one
+        float exit = std::min(nextX, nextZ);
+        if (nearest <= exit || exit >= tMax) {
+            break;
+        }
+        if (nextX < nextZ) {
+            cellX += stepX;
+            nextX += deltaX;
+        } else {
+            cellZ += stepZ;
+            nextZ += deltaZ;
+        }
+        if (cellX < 0 || cellX >= cellsX || cellZ < 0 || cellZ >= cellsZ) {
+            break;
+        }
+    }
+    return nearestPiece;
+}
+
+} // namespace
+
+void PotentiallyVisibleSet::build(const MeshVertex* vertices, const uint32_t* indices,
+                                  const std::vector<MeshShape>& pieces, const PvsSettings& settings,
+                                  PvsLoadStats* stats) {
+    Clock::time_point start = Clock::now();
+
+    numPieces = pieces.size();
+    wordsPerCell = (numPieces + 63) / 64;
+    cellSize = settings.cellSize;
+    bits.clear();
+    cellsX = cellsZ = 0;
+
+    std::vector<PvsTriangle> triangles;
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (size_t piece = 0; piece < pieces.size(); ++piece) {
+        for (uint32_t i = 0; i + 2 < pieces[piece].numIndices; i += 3) {
+            const uint32_t* triangle = indices + pieces[piece].firstIndex + i;
+            glm::vec3 a = glm::make_vec3(vertices[triangle[0]].position);
+            glm::vec3 b = glm::make_vec3(vertices[triangle[1]].position);
+            glm::vec3 c = glm::make_vec3(vertices[triangle[2]].position);
+            triangles.push_back({a, b - a, c - a, static_cast<uint32_t>(piece)});
+            boundsMin = glm::min(boundsMin, glm::min(a, glm::min(b, c)));
+            boundsMax = glm::max(boundsMax, glm::max(a, glm::max(b, c)));
+        }
+    }
+    if (triangles.empty()) {
+        return;
+    }
+
+    gridMin = glm::vec2(boundsMin.x, boundsMin.z);
+    cellsX = std::max(1, static_cast<int>(std::ceil((boundsMax.x - boundsMin.x) / cellSize)));
+    cellsZ = std::max(1, static_cast<int>(std::ceil((boundsMax.z - boundsMin.z) / cellSize)));
+    OccluderGrid occluders(std::move(triangles), gridMin, cellSize, cellsX, cellsZ, boundsMin.y, boundsMax.y);
+
+    std::vector<glm::vec3> directions;
+    for (uint32_t e = 0; e < settings.numElevations; ++e) {
+        float elevation = settings.numElevations > 1 ? -0.3f + 0.9f * e / (settings.numElevations - 1) : 0.0f;
+        for (uint32_t a = 0; a < settings.numAzimuths; ++a) {
+            float azimuth = 2.0f * 3.14159265f * a / settings.numAzimuths;
+            directions.push_back(glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation),
+                                           std::cos(elevation) * std::sin(azimuth)));
+        }
+    }
+
+    // Rays are cast from a lattice of points, 'samplesPerCell' intervals
+    // per side of a cell, the points on the edges being shared by the cells
+    // around them. A row of points is a job.
+    int step = static_cast<int>(std::max(1u, settings.samplesPerCell));
+    int pointsX = cellsX * step + 1;
+    int pointsZ = cellsZ * step + 1;
+    float spacing = cellSize / step;
+    float angleStep = 2.0f * 3.14159265f / settings.numAzimuths;
+    std::vector<uint64_t> pointBits(static_cast<size_t>(pointsX) * pointsZ * wordsPerCell, 0);
+
+    ThreadPool pool;
+    pool.parallelFor(static_cast<size_t>(pointsZ), [&](size_t j) {
+        std::vector<uint32_t> stamps(occluders.getNumTriangles(), 0);
+        uint32_t rayId = 0;
+        for (int i = 0; i < pointsX; ++i) {
+            size_t point = j * pointsX + i;
+            uint64_t* visible = &pointBits[point * wordsPerCell];
+
+            // Each point turns the directions by a different fraction of
+            // their spacing, so that together they cover the gaps between them
+            float turn = angleStep * std::fmod(point * 0.618034f, 1.0f);
+            float c = std::cos(turn);
+            float s = std::sin(turn);
+            glm::vec3 origin(gridMin.x + i * spacing, settings.eyeHeight, gridMin.y + j * spacing);
+            for (const glm::vec3& d : directions) {
+                glm::vec3 direction(c * d.x - s * d.z, d.y, s * d.x + c * d.z);
+                int piece = occluders.castRay(origin, direction, settings.maxDistance, stamps, ++rayId);
+                if (piece >= 0) {
+                    visible[piece / 64] |= uint64_t(1) << (piece % 64);
+                }
+            }
+        }
+    });
+
+    // A cell sees what the points on and inside its edges see
+    bits.assign(static_cast<size_t>(cellsX) * cellsZ * wordsPerCell, 0);
+    for (int j = 0; j < cellsZ; ++j) {
+        for (int i = 0; i < cellsX; ++i) {
+            uint64_t* cell = &bits[(static_cast<size_t>(j) * cellsX + i) * wordsPerCell];
+            for (int b = 0; b <= step; ++b) {
+                for (int a = 0; a <= step; ++a) {
+                    size_t point = static_cast<size_t>(j * step + b) * pointsX + i * step + a;
+                    for (size_t w = 0; w < wordsPerCell; ++w) {
+                        cell[w] |= pointBits[point * wordsPerCell + w];
+                    }
+                }
+            }
+        }
+    }
+
+    if (stats != nullptr) {
+        stats->buildTime = secondsSince(start);
+        stats->numRays = pointBits.size() / wordsPerCell * directions.size();
+    }
+}
+
+bool PotentiallyVisibleSet::readCache(const std::string& path, uint64_t key) {
+    std::ifstream file(path, std::ios::binary);
+    PvsCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, pvsCacheMagic, sizeof(pvsCacheMagic)) != 0
+        || header.version != pvsCacheVersion
+        || header.key != key
+        || header.cellsX <= 0 || header.cellsZ <= 0
+        || header.wordsPerCell != (header.numPieces + 63) / 64) {
+        return false;
+    }
+    size_t numWords = static_cast<size_t>(header.cellsX) * header.cellsZ * header.wordsPerCell;
+    if (header.fileSize != sizeof(header) + numWords * sizeof(uint64_t)) {
+        return false;
+    }
+
+    std::vector<uint64_t> words(numWords);
+    if (!file.read(reinterpret_cast<char*>(words.data()), numWords * sizeof(uint64_t))) {
+        return false;
+    }
+    gridMin = glm::vec2(header.gridMin[0], header.gridMin[1]);
+    cellSize = header.cellSize;
+    cellsX = header.cellsX;
+    cellsZ = header.cellsZ;
+    numPieces = header.numPieces;
+    wordsPerCell = header.wordsPerCell;
+    bits = std::move(words);
+    return true;
+}
+
+bool PotentiallyVisibleSet::writeCache(const std::string& path, uint64_t key) const {
+    std::error_code error;
+    fs::create_directories(fs::path(path).parent_path(), error);
+
+    PvsCacheHeader header = {};
+    std::memcpy(header.magic, pvsCacheMagic, sizeof(pvsCacheMagic));
+    header.version = pvsCacheVersion;
+    header.numPieces = static_cast<uint32_t>(numPieces);
+    header.key = key;
+    header.gridMin[0] = gridMin.x;
+    header.gridMin[1] = gridMin.y;
+    header.cellSize = cellSize;
+    header.cellsX = cellsX;
+    header.cellsZ = cellsZ;
+    header.wordsPerCell = static_cast<uint32_t>(wordsPerCell);
+    header.fileSize = sizeof(header) + bits.size() * sizeof(uint64_t);
+
+    // Same as the mesh cache: a temporary file, renamed when complete
+    std::string tempPath = makeTempPath(path);
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(bits.data()), bits.size() * sizeof(uint64_t));
+        if (!file) {
+            fprintf(stderr, "WARNING: could not write PVS cache \"%s\".\n", tempPath.c_str());
+            return false;
+        }
+    }
+    fs::rename(tempPath, path, error);
+    if (error) {
+        fprintf(stderr, "WARNING: could not write PVS cache \"%s\": %s.\n", path.c_str(), error.message().c_str());
+        fs::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+int PotentiallyVisibleSet::findCell(const glm::vec3& position) const {
+    if (bits.empty()) {
+        return -1;
+    }
+    float x = std::floor((position.x - gridMin.x) / cellSize);
+    float z = std::floor((position.z - gridMin.y) / cellSize);
+    if (!(x >= 0.0f && x < cellsX && z >= 0.0f && z < cellsZ)) {
+        return -1;
+    }
+    return static_cast<int>(z) * cellsX + static_cast<int>(x);
+}
+
+size_t PotentiallyVisibleSet::countVisible(int cell) const {
+    size_t count = 0;
+    for (size_t w = 0; w < wordsPerCell; ++w) {
+        uint64_t word = bits[cell * wordsPerCell + w];
+        for (; word != 0; word &= word - 1) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t PotentiallyVisibleSet::filter(int cell, std::vector<uint32_t>& pieces) const {
+    if (cell < 0) {
+        return 0;
+    }
+    size_t kept = 0;
+    for (uint32_t piece : pieces) {
+        if (piece < numPieces && isVisible(cell, piece)) {
+            pieces[kept++] = piece;
+        }
+    }
+    size_t removed = pieces.size() - kept;
+    pieces.resize(kept);
+    return removed;
+}
+
+uint64_t HashPvsInput(const MeshVertex* vertices, size_t numVertices, const uint32_t* indices, size_t numIndices,
+                      const std::vector<MeshShape>& pieces, const PvsSettings& settings) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < numVertices; ++i) {
+        hashBytes(hash, vertices[i].position, 3 * sizeof(float));
+    }
+    hashBytes(hash, indices, numIndices * sizeof(uint32_t));
+    // The names tie each bitset to its piece, whatever changed in between
+    for (const MeshShape& piece : pieces) {
+        hashBytes(hash, piece.name.data(), piece.name.size() + 1);
+        hashBytes(hash, &piece.firstIndex, sizeof(piece.firstIndex));
+        hashBytes(hash, &piece.numIndices, sizeof(piece.numIndices));
+    }
+    hashBytes(hash, &settings.cellSize, sizeof(settings.cellSize));
+    hashBytes(hash, &settings.eyeHeight, sizeof(settings.eyeHeight));
+    hashBytes(hash, &settings.maxDistance, sizeof(settings.maxDistance));
+    hashBytes(hash, &settings.numAzimuths, sizeof(settings.numAzimuths));
+    hashBytes(hash, &settings.numElevations, sizeof(settings.numElevations));
+    hashBytes(hash, &settings.samplesPerCell, sizeof(settings.samplesPerCell));
+    return hash;
+}
+
+PotentiallyVisibleSet LoadPotentiallyVisibleSet(const std::string& name, const MeshVertex* vertices,
+                                                size_t numVertices, const uint32_t* indices, size_t numIndices,
+                                                const std::vector<MeshShape>& pieces,
+                                                const PvsSettings& settings, PvsLoadStats* stats) {
+    PvsLoadStats localStats;
+    if (stats == nullptr) {
+        stats = &localStats;
+    }
+    *stats = PvsLoadStats();
+
+    std::string cachePath = pvsCacheFolder + name + ".pvs";
+    uint64_t key = HashPvsInput(vertices, numVertices, indices, numIndices, pieces, settings);
+
+    PotentiallyVisibleSet pvs;
+    Clock::time_point start = Clock::now();
+    if (pvs.readCache(cachePath, key)) {
+        stats->fromCache = true;
+        stats->cacheTime = secondsSince(start);
+        return pvs;
+    }
+
+    pvs.build(vertices, indices, pieces, settings, stats);
+
+    start = Clock::now();
+    pvs.writeCache(cachePath, key);
+    stats->cacheTime = secondsSince(start);
+    return pvs;
+}
@@ -0,0 +1,114 @@
+#include "graphics/render_queue.h"
+
+#include <algorithm>
+#include <cstring>
+
+void RenderQueue::begin(const glm::vec3& cameraPosition) {
+    this->cameraPosition = cameraPosition;
+    packets.clear();
+    rangeCounts.clear();
+    rangeOffsets.clear();
+}
+
+float RenderQueue::depthOf(const AABB& bounds) const {
+    glm::vec3 nearest = glm::clamp(cameraPosition, glm::vec3(bounds.getMin()), glm::vec3(bounds.getMax()));
+    return glm::distance(cameraPosition, nearest);
+}
+
+uint64_t RenderQueue::makeKey(GLuint programId, float depth, GLuint vertexArrayObjectId, int32_t material) {
+    // The bits of a positive float sort like the float, so its upper 24
+    // bits make a depth that only loses precision
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    return (static_cast<uint64_t>(programId & 0xFF) << 56)
+         | (static_cast<uint64_t>(depthBits >> 8) << 32)
+         | (static_cast<uint64_t>(vertexArrayObjectId & 0xFFFF) << 16)
+         | static_cast<uint64_t>(static_cast<uint32_t>(material) & 0xFFFF);
+}
+
+void RenderQueue::add(const DrawPacket& packet, float depth) {
+    packets.push_back(packet);
+    DrawPacket& added = packets.back();
+    added.key = makeKey(packet.programId, depth, packet.vertexArrayObjectId, packet.uniforms.objectId);
+    added.numRanges = 0;
+}
+
+void RenderQueue::add(const DrawPacket& packet, float depth, const std::vector<GLsizei>& counts,
+                      const std::vector<const void*>& offsets) {
+    if (counts.empty()) {
+        return;
+    }
+    add(packet, depth);
+    DrawPacket& added = packets.back();
+    added.firstRange = static_cast<uint32_t>(rangeCounts.size());
+    added.numRanges = static_cast<uint32_t>(counts.size());
+    rangeCounts.insert(rangeCounts.end(), counts.begin(), counts.end());
+    rangeOffsets.insert(rangeOffsets.end(), offsets.begin(), offsets.end());
+}
+
+void RenderQueue::flush(UniformBuffers& uniforms) {
+    stats = Stats();
+
+    order.resize(packets.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    // Equal keys keep the order they were added in
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return packets[a].key != packets[b].key ? packets[a].key < packets[b].key : a < b;
+    });
+
+    // The draw data of the packets goes up in a single upload. A packet
+    // whose data equals the last one's shares its slot.
+    slots.resize(order.size());
+    const DrawUniforms* lastUniforms = nullptr;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const DrawUniforms& packetUniforms = packets[order[i]].uniforms;
+        if (!lastUniforms || std::memcmp(lastUniforms, &packetUniforms, sizeof(DrawUniforms)) != 0) {
+            slots[i] = static_cast<uint32_t>(uniforms.addDraw(packetUniforms));
+            lastUniforms = &packetUniforms;
+            ++stats.uniformUploads;
+        } else {
+            slots[i] = slots[i - 1];
+        }
+    }
+    uniforms.uploadDraws();
+
+    // Whatever was bound before the frame (the text rendering) is unknown
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const DrawPacket& packet = packets[order[i]];
+
+        if (stats.draws == 0 || packet.programId != program) {
+            glUseProgram(packet.programId);
+            program = packet.programId;
+            ++stats.programBinds;
+        }
+        if (stats.draws == 0 || packet.vertexArrayObjectId != vertexArray) {
+            glBindVertexArray(packet.vertexArrayObjectId);
+            vertexArray = packet.vertexArrayObjectId;
+            ++stats.vertexArrayBinds;
+        }
+        if (i == 0 || slots[i] != slots[i - 1]) {
+            uniforms.bindDraw(slots[i]);
+        }
+
+        if (packet.numRanges > 0) {
+            glMultiDrawElements(packet.renderingMode, &rangeCounts[packet.firstRange], packet.indexType,
+                                &rangeOffsets[packet.firstRange], static_cast<GLsizei>(packet.numRanges));
+        } else if (packet.numInstances > 0) {
+            glDrawElementsInstanced(packet.renderingMode, packet.count, packet.indexType, packet.offset,
+                                    packet.numInstances);
+        } else {
+            glDrawElements(packet.renderingMode, packet.count, packet.indexType, packet.offset);
+        }
+        ++stats.draws;
+    }
+
+    if (stats.draws > 0) {
+        glBindVertexArray(0);
+    }
+}
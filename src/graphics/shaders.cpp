@@ -9,7 +9,7 @@
 #include "core/game.h"
 #include "graphics/core.h"
 
-void LoadShadersFromFiles(GLuint& gpuProgramId, UniformMap& uniforms) 
+void LoadShadersFromFiles(GLuint& gpuProgramId, UniformTable& uniforms) 
 {
     GLuint vertex_shader_id = LoadShader_Vertex("../../assets/shaders/shader_vertex.glsl");
     GLuint fragment_shader_id = LoadShader_Fragment("../../assets/shaders/shader_fragment.glsl");
@@ -19,31 +19,21 @@ void LoadShadersFromFiles(GLuint& gpuProgramId, UniformMap& uniforms)
     
     gpuProgramId = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
 
-    // Defined in "shader_vertex.glsl" and "shader_fragment.glsl".
-    uniforms["model"] = glGetUniformLocation(gpuProgramId, "model");
-    uniforms["view"] = glGetUniformLocation(gpuProgramId, "view");
-    uniforms["projection"] = glGetUniformLocation(gpuProgramId, "projection");
-    uniforms["object_id"] = glGetUniformLocation(gpuProgramId, "object_id");
-    uniforms["interpolation_type"] = glGetUniformLocation(gpuProgramId, "interpolation_type");
-    uniforms["bbox_min"] = glGetUniformLocation(gpuProgramId, "bbox_min");
-    uniforms["bbox_max"] = glGetUniformLocation(gpuProgramId, "bbox_max");
+    // Defined in "shader_vertex.glsl" and "shader_fragment.glsl". The other
+    // uniforms are in the FrameData and DrawData blocks (see UniformBuffers).
+    uniforms = GetUniformLocations(gpuProgramId);
 
+    // The texture in the i-th file is on texture unit i (see
+    // LoadTexturesFromFiles()) and goes to the sampler named after the file
     std::vector<std::string> textureFiles = getFiles("../../assets/textures");
-    std::vector<std::string> textureUniforms;
-
-    for (const auto& textureFile : textureFiles) {
-        std::string textureName = textureFile.substr(0, textureFile.find_last_of('.')) + "_texture";
-        textureUniforms.push_back(textureName);
-    }
-
-    for (size_t i = 0; i < textureFiles.size(); ++i) {
-        uniforms[textureUniforms[i]] = glGetUniformLocation(gpuProgramId, textureUniforms[i].c_str());
-    }
 
     glUseProgram(gpuProgramId);
 
     for (size_t i = 0; i < textureFiles.size(); ++i) {
-        glUniform1i(uniforms[textureUniforms[i]], i);
+        Uniform uniform = TextureUniform(textureFiles[i]);
+        if (uniform != NUM_UNIFORMS) {
+            glUniform1i(uniforms[uniform], i);
+        }
     }
 
     glUseProgram(0);
@@ -0,0 +1,173 @@
+#include "graphics/static_batch.h"
+
+#include <cstddef>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "utils/math_utils.h"
+#include "core/scene.h"
+
+void StaticBatch::add(VirtualScene& virtualScene, const Mesh& mesh, const glm::mat4& modelMatrix) {
+    if (mesh.shapes.empty()) {
+        return;
+    }
+    if (vertexArrayObjectId == 0) {
+        glGenVertexArrays(1, &vertexArrayObjectId);
+    }
+
+    uint32_t baseVertex = static_cast<uint32_t>(vertices.size());
+    uint32_t baseIndex = static_cast<uint32_t>(indices.size());
+
+    // Same objects as any other mesh, drawing from the batch
+    AddSceneObjects(virtualScene, mesh, modelMatrix, vertexArrayObjectId, baseIndex);
+
+    bool identity = modelMatrix == Matrix_Identity();
+    glm::mat4 normalMatrix = glm::inverse(glm::transpose(modelMatrix));
+    for (size_t i = 0; i < mesh.numVertices; ++i) {
+        MeshVertex vertex = mesh.vertices[i];
+        if (!identity) {
+            glm::vec4 position = modelMatrix * glm::make_vec4(vertex.position);
+            glm::vec4 normal = normalMatrix * glm::make_vec4(vertex.normal);
+            normal.w = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                vertex.position[k] = position[k];
+                vertex.normal[k] = normal[k];
+            }
+        }
+        vertices.push_back(vertex);
+    }
+    for (size_t i = 0; i < mesh.numIndices; ++i) {
+        indices.push_back(baseVertex + mesh.indices[i]);
+    }
+
+    // Every shape is bounded by the box of its model (see AddSceneObjects)
+    const AABB& bounds = virtualScene.get(virtualScene.find(mesh.shapes.front().name))->getAABB();
+    PieceBounds pieceBounds = {
+        {bounds.getMin().x, bounds.getMin().y, bounds.getMin().z},
+        {bounds.getMax().x, bounds.getMax().y, bounds.getMax().z}
+    };
+    vertexBounds.resize(vertices.size(), pieceBounds);
+
+    for (const MeshShape& shape : mesh.shapes) {
+        pieces.push_back({shape.name, baseIndex + shape.firstIndex, shape.numIndices, bounds});
+    }
+}
+
+void StaticBatch::upload(VirtualScene& virtualScene) {
+    numVertices = vertices.size();
+    numIndices = indices.size();
+    if (vertexArrayObjectId == 0 || vertices.empty()) {
+        return;
+    }
+
+    // One box for the whole batch, so that the pieces keep sharing their
+    // edges exactly
+    glm::vec3 boundsMin = glm::make_vec3(vertices.front().position);
+    glm::vec3 boundsMax = boundsMin;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        glm::vec3 position = glm::make_vec3(vertices[i].position);
+        boundsMin = glm::min(boundsMin, glm::min(position, glm::make_vec3(vertexBounds[i].min)));
+        boundsMax = glm::max(boundsMax, glm::max(position, glm::make_vec3(vertexBounds[i].max)));
+    }
+    quantization = ComputeVertexQuantization(boundsMin, boundsMax);
+
+    PackedMesh packed;
+    packed.quantization = quantization;
+    packed.vertices.reserve(vertices.size());
+    std::vector<PackedPieceBounds> packedBounds(vertexBounds.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        packed.vertices.push_back(PackVertex(vertices[i], quantization));
+        QuantizePosition(vertexBounds[i].min, quantization, packedBounds[i].min);
+        QuantizePosition(vertexBounds[i].max, quantization, packedBounds[i].max);
+        packedBounds[i].min[3] = 0;
+        packedBounds[i].max[3] = 0;
+    }
+    PackIndices(indices.data(), indices.size(), vertices.size(), packed);
+    indexType = packed.indexType;
+
+    sizeInBytes = packed.sizeInBytes() + packedBounds.size() * sizeof(PackedPieceBounds);
+    unpackedSizeInBytes = vertices.size() * sizeof(MeshVertex) + vertexBounds.size() * sizeof(PieceBounds)
+                          + indices.size() * sizeof(uint32_t);
+
+    for (const StaticBatchPiece& piece : pieces) {
+        GameObject* object = virtualScene.get(virtualScene.find(piece.name));
+        SceneObject sceneObject = object->getSceneObject();
+        sceneObject.indexType = indexType;
+        sceneObject.quantization = quantization;
+        object->setSceneObject(sceneObject);
+    }
+
+    glBindVertexArray(vertexArrayObjectId);
+
+    GLuint VBO_vertices_id;
+    glGenBuffers(1, &VBO_vertices_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_vertices_id);
+    glBufferData(GL_ARRAY_BUFFER, packed.vertices.size() * sizeof(PackedVertex), packed.vertices.data(),
+                 GL_STATIC_DRAW);
+    SetPackedVertexAttributes(true, true);
+
+    GLuint VBO_bounds_id;
+    glGenBuffers(1, &VBO_bounds_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_bounds_id);
+    glBufferData(GL_ARRAY_BUFFER, packedBounds.size() * sizeof(PackedPieceBounds), packedBounds.data(),
+                 GL_STATIC_DRAW);
+
+    glVertexAttribPointer(3, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedPieceBounds),
+                          (void*)offsetof(PackedPieceBounds, min));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedPieceBounds),
+                          (void*)offsetof(PackedPieceBounds, max));
+    glEnableVertexAttribArray(4);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLuint indices_id;
+    glGenBuffers(1, &indices_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.indices.size(), packed.indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+
+    // The GPU has its own copy now
+    std::vector<MeshVertex>().swap(vertices);
+    std::vector<PieceBounds>().swap(vertexBounds);
+    std::vector<uint32_t>().swap(indices);
+}
+
+void StaticBatch::draw(RenderQueue& queue, DrawPacket packet, float depth) const {
+    if (numIndices == 0) {
+        return;
+    }
+    packet.vertexArrayObjectId = vertexArrayObjectId;
+    packet.indexType = indexType;
+    packet.count = static_cast<GLsizei>(numIndices);
+    packet.offset = (void*)0;
+    queue.add(packet, depth);
+}
+
+void StaticBatch::draw(RenderQueue& queue, DrawPacket packet, float depth,
+                       const std::vector<uint32_t>& visiblePieces) const {
+    size_t indexSize = IndexSize(indexType);
+    // Reused by every call
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    counts.clear();
+    offsets.clear();
+    for (uint32_t index : visiblePieces) {
+        const StaticBatchPiece& piece = pieces[index];
+        // Pieces follow each other in the index buffer: extend the last range
+        // when this piece starts where it ends
+        if (!counts.empty()) {
+            size_t lastEnd = reinterpret_cast<size_t>(offsets.back()) / indexSize + counts.back();
+            if (lastEnd == piece.firstIndex) {
+                counts.back() += piece.numIndices;
+                continue;
+            }
+        }
+        counts.push_back(static_cast<GLsizei>(piece.numIndices));
+        offsets.push_back(reinterpret_cast<const void*>(piece.firstIndex * indexSize));
+    }
+
+    packet.vertexArrayObjectId = vertexArrayObjectId;
+    packet.indexType = indexType;
+    queue.add(packet, depth, counts, offsets);
+}
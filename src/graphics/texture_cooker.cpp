@@ -0,0 +1,307 @@
+#include "graphics/texture_cooker.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+// Call job(row) for each row, on the pool when there is one
+void forEachRow(uint32_t numRows, ThreadPool* pool, const std::function<void(size_t)>& job) {
+    if (pool != nullptr && pool->size() > 1) {
+        pool->parallelFor(numRows, job);
+        return;
+    }
+    for (uint32_t row = 0; row < numRows; ++row) {
+        job(row);
+    }
+}
+
+const std::array<float, 256>& srgbToLinear() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> values;
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table;
+}
+
+uint8_t linearToSrgb(float c) {
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(s * 255.0f + 0.5f);
+}
+
+// Next level of the chain. Odd sizes repeat the last row or column.
+TextureLevel downsample(const TextureLevel& source, ThreadPool* pool) {
+    TextureLevel level;
+    level.width = std::max(source.width / 2, 1u);
+    level.height = std::max(source.height / 2, 1u);
+    level.texels.resize(size_t(level.width) * level.height * 4);
+
+    const std::array<float, 256>& toLinear = srgbToLinear();
+    forEachRow(level.height, pool, [&](size_t y) {
+        uint32_t y0 = std::min(uint32_t(y) * 2, source.height - 1);
+        uint32_t y1 = std::min(uint32_t(y) * 2 + 1, source.height - 1);
+        for (uint32_t x = 0; x < level.width; ++x) {
+            uint32_t x0 = std::min(x * 2, source.width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+            const uint8_t* texels[4] = {
+                &source.texels[(size_t(y0) * source.width + x0) * 4],
+                &source.texels[(size_t(y0) * source.width + x1) * 4],
+                &source.texels[(size_t(y1) * source.width + x0) * 4],
+                &source.texels[(size_t(y1) * source.width + x1) * 4],
+            };
+            uint8_t* out = &level.texels[(y * level.width + x) * 4];
+            for (int c = 0; c < 3; ++c) {
+                float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]]
+                          + toLinear[texels[2][c]] + toLinear[texels[3][c]];
+                out[c] = linearToSrgb(sum * 0.25f);
+            }
+            // Alpha is not a color
+            out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+        }
+    });
+    return level;
+}
+
+uint16_t packColor565(const glm::vec3& color) {
+    glm::vec3 c = glm::clamp(color, 0.0f, 255.0f);
+    uint16_t r = static_cast<uint16_t>(c.r * 31.0f / 255.0f + 0.5f);
+    uint16_t g = static_cast<uint16_t>(c.g * 63.0f / 255.0f + 0.5f);
+    uint16_t b = static_cast<uint16_t>(c.b * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// The 8-bit channels a decoder expands a RGB565 color to
+void unpackColor565(uint16_t color, int rgb[3]) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// The 4 colors of a block, as decoded
+void blockPalette(uint16_t color0, uint16_t color1, int palette[4][3]) {
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        if (color0 > color1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+struct BlockFit {
+    uint16_t color0 = 0;
+    uint16_t color1 = 0;
+    uint32_t indices = 0;
+    float error = 0.0f;
+};
+
+// Quantize the endpoints and pick the nearest color of the palette for each
+// texel. Uses the 4 color mode, which needs color0 > color1.
+BlockFit fitBlock(const glm::vec3 texels[16], const glm::vec3& endpoint0, const glm::vec3& endpoint1) {
+    BlockFit fit;
+    fit.color0 = packColor565(endpoint0);
+    fit.color1 = packColor565(endpoint1);
+    if (fit.color0 < fit.color1) {
+        std::swap(fit.color0, fit.color1);
+    }
+
+    int palette[4][3];
+    blockPalette(fit.color0, fit.color1, palette);
+    // Equal endpoints fall in the 3 color mode: index 0 is the only color
+    int numColors = fit.color0 == fit.color1 ? 1 : 4;
+
+    for (int i = 0; i < 16; ++i) {
+        float bestError = INFINITY;
+        uint32_t bestIndex = 0;
+        for (int index = 0; index < numColors; ++index) {
+            glm::vec3 d = texels[i] - glm::vec3(palette[index][0], palette[index][1], palette[index][2]);
+            float error = glm::dot(d, d);
+            if (error < bestError) {
+                bestError = error;
+                bestIndex = static_cast<uint32_t>(index);
+            }
+        }
+        fit.indices |= bestIndex << (2 * i);
+        fit.error += bestError;
+    }
+    return fit;
+}
+
+// Endpoints minimizing the squared error of the colors picked by 'fit', or
+// false when its indices do not constrain both endpoints
+bool leastSquaresEndpoints(const glm::vec3 texels[16], const BlockFit& fit,
+                           glm::vec3& endpoint0, glm::vec3& endpoint1) {
+    // Weight of color0 in each palette color of the 4 color mode
+    const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    glm::vec3 ax(0.0f), bx(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        float a = weights[(fit.indices >> (2 * i)) & 3];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax += a * texels[i];
+        bx += b * texels[i];
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    endpoint0 = (ax * bb - bx * ab) / determinant;
+    endpoint1 = (bx * aa - ax * ab) / determinant;
+    return true;
+}
+
+void encodeBlock(const glm::vec3 texels[16], uint8_t* block) {
+    glm::vec3 mean(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        mean += texels[i];
+    }
+    mean /= 16.0f;
+
+    // Principal axis of the colors, by power iteration on their covariance
+    float covariance[6] = {};
+    for (int i = 0; i < 16; ++i) {
+        glm::vec3 d = texels[i] - mean;
+        covariance[0] += d.r * d.r;
+        covariance[1] += d.r * d.g;
+        covariance[2] += d.r * d.b;
+        covariance[3] += d.g * d.g;
+        covariance[4] += d.g * d.b;
+        covariance[5] += d.b * d.b;
+    }
+    glm::vec3 axis(1.0f);
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        glm::vec3 next(covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                       covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                       covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b);
+        float length = glm::length(next);
+        if (length < 1e-6f) {
+            break;
+        }
+        axis = next / length;
+    }
+
+    float minProjection = INFINITY;
+    float maxProjection = -INFINITY;
+    for (int i = 0; i < 16; ++i) {
+        float projection = glm::dot(texels[i] - mean, axis);
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    BlockFit best = fitBlock(texels, mean + axis * maxProjection, mean + axis * minProjection);
+    for (int iteration = 0; iteration < 2 && best.error > 0.0f; ++iteration) {
+        glm::vec3 endpoint0;
+        glm::vec3 endpoint1;
+        if (!leastSquaresEndpoints(texels, best, endpoint0, endpoint1)) {
+            break;
+        }
+        BlockFit refined = fitBlock(texels, endpoint0, endpoint1);
+        if (refined.error >= best.error) {
+            break;
+        }
+        best = refined;
+    }
+
+    block[0] = static_cast<uint8_t>(best.color0 & 0xFF);
+    block[1] = static_cast<uint8_t>(best.color0 >> 8);
+    block[2] = static_cast<uint8_t>(best.color1 & 0xFF);
+    block[3] = static_cast<uint8_t>(best.color1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+        block[4 + i] = static_cast<uint8_t>(best.indices >> (8 * i));
+    }
+}
+
+uint32_t blocksAcross(uint32_t size) {
+    return (size + 3) / 4;
+}
+
+}
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t size = std::max(width, height);
+    uint32_t numLevels = 1;
+    while (size > 1) {
+        size /= 2;
+        ++numLevels;
+    }
+    return numLevels;
+}
+
+std::vector<TextureLevel> GenerateMipChain(TextureLevel base, ThreadPool* pool) {
+    uint32_t numLevels = MipLevelCount(base.width, base.height);
+    std::vector<TextureLevel> levels;
+    levels.reserve(numLevels);
+    levels.push_back(std::move(base));
+    while (levels.size() < numLevels) {
+        levels.push_back(downsample(levels.back(), pool));
+    }
+    return levels;
+}
+
+size_t BC1LevelSize(uint32_t width, uint32_t height) {
+    return size_t(blocksAcross(width)) * blocksAcross(height) * bc1BlockSize;
+}
+
+void EncodeBC1(const TextureLevel& level, uint8_t* blocks, ThreadPool* pool) {
+    uint32_t numBlocksX = blocksAcross(level.width);
+    forEachRow(blocksAcross(level.height), pool, [&](size_t blockY) {
+        glm::vec3 texels[16];
+        for (uint32_t blockX = 0; blockX < numBlocksX; ++blockX) {
+            // Blocks past the edge of the level repeat its last texels
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = std::min(blockX * 4 + i % 4, level.width - 1);
+                uint32_t y = std::min(uint32_t(blockY) * 4 + i / 4, level.height - 1);
+                const uint8_t* texel = &level.texels[(size_t(y) * level.width + x) * 4];
+                texels[i] = glm::vec3(texel[0], texel[1], texel[2]);
+            }
+            encodeBlock(texels, blocks + (blockY * numBlocksX + blockX) * bc1BlockSize);
+        }
+    });
+}
+
+void DecodeBC1(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* texels) {
+    uint32_t numBlocksX = blocksAcross(width);
+    for (uint32_t blockY = 0; blockY < blocksAcross(height); ++blockY) {
+        for (uint32_t blockX = 0; blockX < numBlocksX; ++blockX) {
+            const uint8_t* block = blocks + (size_t(blockY) * numBlocksX + blockX) * bc1BlockSize;
+            uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+            uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+            uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+            int palette[4][3];
+            blockPalette(color0, color1, palette);
+
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = blockX * 4 + i % 4;
+                uint32_t y = blockY * 4 + i / 4;
+                if (x >= width || y >= height) {
+                    continue;
+                }
+                const int* color = palette[(indices >> (2 * i)) & 3];
+                uint8_t* texel = &texels[(size_t(y) * width + x) * 4];
+                texel[0] = static_cast<uint8_t>(color[0]);
+                texel[1] = static_cast<uint8_t>(color[1]);
+                texel[2] = static_cast<uint8_t>(color[2]);
+                texel[3] = 255;
+            }
+        }
+    }
+}
@@ -1,27 +1,272 @@
 #include "graphics/textures.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+#include "graphics/texture_cooker.h"
 #include "utils/file_utils.h"
+#include "utils/thread_pool.h"
 
-/* Loads a texture image and creates an OpenGL texture object. */
-void LoadTextureImage(
-    const char* filename, 
-    GLuint& numLoadedTextures, 
-    GLint wrappingMode
-) {
-    printf("Loading image \"%s\"... ", filename);
+// From GL_EXT_texture_compression_s3tc and GL_EXT_texture_sRGB, which the
+// loader of the core profile does not know
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+const char* const textureCacheFolder = "../../cache/textures/";
+
+// Bump when the layout or the processing of the cooked textures change
+const uint32_t textureCacheVersion = 1;
+const char textureCacheMagic[8] = {'C', 'Q', 'T', 'E', 'X', '\0', '\0', '\0'};
+
+// Enough levels for any size a uint32_t holds
+const uint32_t maxTextureLevels = 32;
+
+// Smaller images (the 16x16 blocks of the maze) stay uncompressed: BC1
+// would save a few bytes and blur their texels
+const uint32_t minCompressedSize = 64;
+
+enum TextureCacheFormat : uint32_t {
+    TEXTURE_RGBA8 = 0,
+    TEXTURE_BC1 = 1
+};
+
+/* Layout of a cache file, a KTX-like container in native byte order: the
+ * header, then the levels of the mip chain from the largest, each starting
+ * at a multiple of 16 bytes. RGBA8 levels have packed rows, bottom row
+ * first, as OpenGL takes them. */
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;      // TextureCacheFormat
+    uint64_t sourceSize;  // Size, modification time and hash of the image file
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numLevels;
+    uint32_t padding;
+    uint64_t levelOffsets[maxTextureLevels];
+    uint64_t levelSizes[maxTextureLevels];
+    uint64_t fileSize;
+};
+
+/* Texture ready for the GPU: the header and levels of its cache file,
+ * mapped, or just cooked when the cache was missing or stale */
+struct CookedTexture {
+    TextureCacheHeader header = {};
+    const uint8_t* data = nullptr;  // The whole file, header included
+    MappedFile mapping;
+    std::vector<uint8_t> storage;
+
+    void release() {
+        data = nullptr;
+        mapping.close();
+        storage = std::vector<uint8_t>();
+    }
+};
+
+/* Image loaded by a worker into the pixel buffer mapped for it */
+struct TextureJob {
+    std::string file;
+    std::string cachePath;
+    SourceInfo source;
+    GLuint unit = 0;
+    CookedTexture cooked;
+    bool fromCache = false;
+    double cookTime = 0.0;      // Or the time to map the cache file
+
+    GLuint pixelBuffer = 0;
+    void* pixels = nullptr;     // The mapped pixel buffer
+    bool decompress = false;    // BC1 levels the driver cannot take
+    uint64_t uploadOffsets[maxTextureLevels] = {};
+    uint64_t uploadSizes[maxTextureLevels] = {};
+    uint64_t uploadSize = 0;
+    double copyTime = 0.0;
+};
+
+uint64_t alignOffset(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+uint32_t levelWidth(const TextureCacheHeader& header, uint32_t level) {
+    return std::max(header.width >> level, 1u);
+}
+
+uint32_t levelHeight(const TextureCacheHeader& header, uint32_t level) {
+    return std::max(header.height >> level, 1u);
+}
+
+// Bytes of a level in the format of the cache file
+uint64_t levelSize(const TextureCacheHeader& header, uint32_t level) {
+    uint32_t width = levelWidth(header, level);
+    uint32_t height = levelHeight(header, level);
+    return header.format == TEXTURE_BC1 ? BC1LevelSize(width, height) : uint64_t(width) * height * 4;
+}
+
+std::string getTextureCachePath(const std::string& imagePath) {
+    // "../../assets/textures/chest.png" -> "assets_textures_chest.png.tex"
+    std::string name = imagePath;
+    while (name.compare(0, 3, "../") == 0 || name.compare(0, 3, "..\\") == 0) {
+        name.erase(0, 3);
+    }
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') {
+            c = '_';
+        }
+    }
+    return textureCacheFolder + name + ".tex";
+}
+
+// Map a cache file into 'cooked'. Returns false if the file is missing,
+// invalid or out of date.
+bool readTextureCache(const std::string& cachePath, const std::string& imagePath,
+                      const SourceInfo& source, CookedTexture& cooked) {
+    MappedFile mapping;
+    if (!mapping.open(cachePath) || mapping.size() < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, textureCacheMagic, sizeof(textureCacheMagic)) != 0
+        || header.version != textureCacheVersion
+        || header.fileSize != mapping.size()
+        || header.sourceSize != source.size
+        || (header.format != TEXTURE_RGBA8 && header.format != TEXTURE_BC1)
+        || header.width == 0 || header.height == 0
+        || header.numLevels != MipLevelCount(header.width, header.height)
+        || header.numLevels > maxTextureLevels) {
+        return false;
+    }
+    // As for the meshes, only a new content makes the cache stale
+    bool timeChanged = header.sourceTime != source.time;
+    if (timeChanged && header.sourceHash != hashFile(imagePath)) {
+        return false;
+    }
+    // Every level of the full chain, at the size its format gives it, so
+    // that the upload never reads past a level
+    for (uint32_t level = 0; level < header.numLevels; ++level) {
+        if (header.levelSizes[level] != levelSize(header, level)
+            || header.levelOffsets[level] > header.fileSize
+            || header.levelSizes[level] > header.fileSize - header.levelOffsets[level]) {
+            return false;
+        }
+    }
+
+    cooked.header = header;
+    cooked.data = mapping.data();
+    cooked.mapping = std::move(mapping);
+
+    // Same content under a new time: store the time, as for the meshes
+    if (timeChanged && !patchFile(cachePath, offsetof(TextureCacheHeader, sourceTime), &source.time,
+                                  sizeof(source.time))) {
+        fprintf(stderr, "WARNING: could not update texture cache \"%s\".\n", cachePath.c_str());
+    }
+    return true;
+}
 
-    // Loads image data from disk
-    stbi_set_flip_vertically_on_load(true);
-    int width;
-    int height;
-    int channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
+// Write a cooked texture next to the other cache files. Failures only cost
+// the next start a new cooking, so they are reported and ignored.
+void writeTextureCache(const std::string& cachePath, const std::vector<uint8_t>& data) {
+    std::error_code error;
+    fs::create_directories(fs::path(cachePath).parent_path(), error);
 
-    if ( data == nullptr )
+    // Write a temporary file and rename it, so that a cache file is never
+    // seen half written
+    std::string tempPath = makeTempPath(cachePath);
     {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            fprintf(stderr, "WARNING: could not write texture cache \"%s\".\n", tempPath.c_str());
+            return;
+        }
+    }
+    fs::rename(tempPath, cachePath, error);
+    if (error) {
+        fprintf(stderr, "WARNING: could not write texture cache \"%s\": %s.\n", cachePath.c_str(),
+                error.message().c_str());
+        fs::remove(tempPath, error);
+    }
+}
+
+// Build the mip chain of a decoded image, compress it if it is large enough
+// and write it to the cache
+void cookTexture(TextureJob& job, TextureLevel image, ThreadPool& pool) {
+    TextureCacheHeader& header = job.cooked.header;
+    std::memcpy(header.magic, textureCacheMagic, sizeof(textureCacheMagic));
+    header.version = textureCacheVersion;
+    header.format = image.width >= minCompressedSize && image.height >= minCompressedSize ? TEXTURE_BC1
+                                                                                          : TEXTURE_RGBA8;
+    header.sourceSize = job.source.size;
+    header.sourceTime = job.source.time;
+    header.sourceHash = hashFile(job.file);
+    header.width = image.width;
+    header.height = image.height;
+
+    std::vector<TextureLevel> levels = GenerateMipChain(std::move(image), &pool);
+    header.numLevels = static_cast<uint32_t>(levels.size());
+    uint64_t offset = alignOffset(sizeof(header));
+    for (uint32_t level = 0; level < header.numLevels; ++level) {
+        header.levelOffsets[level] = offset;
+        header.levelSizes[level] = levelSize(header, level);
+        offset = alignOffset(offset + header.levelSizes[level]);
+    }
+    header.fileSize = header.levelOffsets[header.numLevels - 1] + header.levelSizes[header.numLevels - 1];
+
+    std::vector<uint8_t>& data = job.cooked.storage;
+    data.assign(header.fileSize, 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    for (uint32_t level = 0; level < header.numLevels; ++level) {
+        uint8_t* levelData = data.data() + header.levelOffsets[level];
+        if (header.format == TEXTURE_BC1) {
+            EncodeBC1(levels[level], levelData, &pool);
+        } else {
+            std::memcpy(levelData, levels[level].texels.data(), levels[level].texels.size());
+        }
+    }
+    job.cooked.data = data.data();
+
+    writeTextureCache(job.cachePath, data);
+}
+
+// Whether the driver takes BC1 textures in sRGB. S3TC is an extension, on
+// every desktop driver but outside of the core profile.
+bool supportsBC1() {
+    bool s3tc = false;
+    bool srgb = false;
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        s3tc = s3tc || std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+        srgb = srgb || std::strcmp(name, "GL_EXT_texture_sRGB") == 0
+                    || std::strcmp(name, "GL_EXT_texture_compression_s3tc_srgb") == 0;
     }
-    printf("OK (%dx%d).\n", width, height);
+    return s3tc && srgb;
+}
+
+// Create the texture of a job on its unit, from its pixel buffer
+void uploadTexture(const TextureJob& job, GLint wrappingMode) {
+    const TextureCacheHeader& header = job.cooked.header;
 
     GLuint texture_id;
     GLuint sampler_id;
@@ -32,46 +277,228 @@ void LoadTextureImage(
     glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, wrappingMode);
     glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, wrappingMode);
 
-    // Texture sampling parameters
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Texture sampling parameters: trilinear, over the cooked mip chain
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Send texture data to OpenGL
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // The levels are copied from the pixel buffer: offsets instead of
+    // pointers, and the copies are queued instead of being made here
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
     glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 
-    GLuint textureunit = numLoadedTextures;
-    glActiveTexture(GL_TEXTURE0 + textureunit);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glActiveTexture(GL_TEXTURE0 + job.unit);
     glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindSampler(textureunit, sampler_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(header.numLevels - 1));
+    for (uint32_t level = 0; level < header.numLevels; ++level) {
+        const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(job.uploadOffsets[level]));
+        GLsizei width = static_cast<GLsizei>(levelWidth(header, level));
+        GLsizei height = static_cast<GLsizei>(levelHeight(header, level));
+        if (header.format == TEXTURE_BC1 && !job.decompress) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, width, height, 0,
+                                   static_cast<GLsizei>(job.uploadSizes[level]), offset);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         offset);
+        }
+    }
+    glBindSampler(job.unit, sampler_id);
+
+    // Freed by GL once the copies are done
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &job.pixelBuffer);
+}
 
-    stbi_image_free(data);
+const char* formatName(const TextureJob& job) {
+    if (job.cooked.header.format == TEXTURE_RGBA8) {
+        return "RGBA8";
+    }
+    return job.decompress ? "BC1 decoded to RGBA8" : "BC1";
+}
 
-    numLoadedTextures += 1;
 }
 
 void LoadTexturesFromFiles(
-    const std::string& texturesDirPath, 
-    GLuint& numLoadedTextures, 
-    GLint wrappingMode
+    const std::string& texturesDirPath,
+    GLuint& numLoadedTextures,
+    GLint wrappingMode,
+    const UniformTable& uniforms
 ) {
-    GLuint initialNumLoadedTextures = numLoadedTextures;
+    Clock::time_point start = Clock::now();
     const std::vector<std::string> textureFiles = getFiles(texturesDirPath);
 
-    for (const auto& textureFile : textureFiles) {
-        LoadTextureImage(
-            (texturesDirPath + "/" + textureFile).c_str(), 
-            numLoadedTextures, 
-            wrappingMode
-        );
+    std::vector<TextureJob> jobs;
+    for (size_t i = 0; i < textureFiles.size(); ++i) {
+        Uniform uniform = TextureUniform(textureFiles[i]);
+        if (uniform == NUM_UNIFORMS || uniforms[uniform] == -1) {
+            printf("Skipping image \"%s\": no sampler reads it.\n", textureFiles[i].c_str());
+            continue;
+        }
+
+        TextureJob job;
+        job.file = texturesDirPath + "/" + textureFiles[i];
+        job.cachePath = getTextureCachePath(job.file);
+        job.unit = numLoadedTextures + static_cast<GLuint>(i);
+        if (!getSourceInfo(job.file, job.source)) {
+            fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", job.file.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    ThreadPool pool;
+
+    // Map the cooked textures of the cache
+    std::vector<size_t> toCook;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Clock::time_point readStart = Clock::now();
+        jobs[i].fromCache = readTextureCache(jobs[i].cachePath, jobs[i].file, jobs[i].source, jobs[i].cooked);
+        jobs[i].cookTime = millisecondsSince(readStart);
+        if (!jobs[i].fromCache) {
+            toCook.push_back(i);
+        }
+    }
+
+    // Decode the other images, one per thread, then build and compress the
+    // mip chain of each with every thread
+    if (!toCook.empty()) {
+        std::vector<TextureLevel> images(toCook.size());
+        stbi_set_flip_vertically_on_load(true);
+        pool.parallelFor(toCook.size(), [&](size_t k) {
+            Clock::time_point decodeStart = Clock::now();
+            int width;
+            int height;
+            int channels;
+            unsigned char* data = stbi_load(jobs[toCook[k]].file.c_str(), &width, &height, &channels, 4);
+            if (data != nullptr) {
+                images[k].width = static_cast<uint32_t>(width);
+                images[k].height = static_cast<uint32_t>(height);
+                images[k].texels.assign(data, data + size_t(width) * height * 4);
+                stbi_image_free(data);
+            }
+            jobs[toCook[k]].cookTime += millisecondsSince(decodeStart);
+        });
+
+        for (size_t k = 0; k < toCook.size(); ++k) {
+            TextureJob& job = jobs[toCook[k]];
+            if (images[k].texels.empty()) {
+                fprintf(stderr, "ERROR: Cannot decode image file \"%s\".\n", job.file.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            Clock::time_point cookStart = Clock::now();
+            cookTexture(job, std::move(images[k]), pool);
+            job.cookTime += millisecondsSince(cookStart);
+        }
+    }
+
+    // Map a pixel buffer for each texture, holding its levels as they are
+    // uploaded
+    bool compressed = supportsBC1();
+    if (!compressed) {
+        fprintf(stderr, "WARNING: the driver has no BC1 (S3TC) textures, they are decoded while loading.\n");
+    }
+    for (TextureJob& job : jobs) {
+        const TextureCacheHeader& header = job.cooked.header;
+        job.decompress = header.format == TEXTURE_BC1 && !compressed;
+        for (uint32_t level = 0; level < header.numLevels; ++level) {
+            job.uploadOffsets[level] = job.uploadSize;
+            job.uploadSizes[level] = job.decompress
+                                   ? uint64_t(levelWidth(header, level)) * levelHeight(header, level) * 4
+                                   : header.levelSizes[level];
+            job.uploadSize = alignOffset(job.uploadSize + job.uploadSizes[level]);
+        }
+
+        glGenBuffers(1, &job.pixelBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(job.uploadSize), nullptr, GL_STREAM_DRAW);
+        job.pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(job.uploadSize),
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (job.pixels == nullptr) {
+            fprintf(stderr, "ERROR: Cannot map a pixel buffer for \"%s\".\n", job.file.c_str());
+            std::exit(EXIT_FAILURE);
+        }
     }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    std::mutex mutex;
+    std::condition_variable textureReady;
+    std::deque<size_t> readyTextures;
+
+    // Workers copy the levels (read from the mapped cache file on first
+    // access) into the pixel buffers
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        pool.submit([&, i] {
+            TextureJob& job = jobs[i];
+            const TextureCacheHeader& header = job.cooked.header;
+            Clock::time_point copyStart = Clock::now();
+            uint8_t* pixels = static_cast<uint8_t*>(job.pixels);
+            for (uint32_t level = 0; level < header.numLevels; ++level) {
+                const uint8_t* levelData = job.cooked.data + header.levelOffsets[level];
+                if (job.decompress) {
+                    DecodeBC1(levelData, levelWidth(header, level), levelHeight(header, level),
+                              pixels + job.uploadOffsets[level]);
+                } else {
+                    std::memcpy(pixels + job.uploadOffsets[level], levelData, header.levelSizes[level]);
+                }
+            }
+            job.cooked.release();
+            job.copyTime = millisecondsSince(copyStart);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                readyTextures.push_back(i);
+            }
+            textureReady.notify_one();
+        });
+    }
+
+    // Create the textures in the order they are ready
+    size_t numFromCache = 0;
+    uint64_t textureBytes = 0;
+    uint64_t uncompressedBytes = 0;
+    double cookTime = 0.0;
+    double copyTime = 0.0;
+    double uploadTime = 0.0;
+    for (size_t numUploaded = 0; numUploaded < jobs.size(); ++numUploaded) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            textureReady.wait(lock, [&] { return !readyTextures.empty(); });
+            index = readyTextures.front();
+            readyTextures.pop_front();
+        }
+        const TextureJob& job = jobs[index];
+        const TextureCacheHeader& header = job.cooked.header;
 
-    if (numLoadedTextures - initialNumLoadedTextures != textureFiles.size()) {
-        fprintf(stderr, "ERROR: Failed to load all texture images.\n");
-        std::exit(EXIT_FAILURE);
+        Clock::time_point uploadStart = Clock::now();
+        uploadTexture(job, wrappingMode);
+        double jobUploadTime = millisecondsSince(uploadStart);
+
+        printf("Loaded image \"%s\" (%ux%u, %u levels, %s) on unit %u:", job.file.c_str(), header.width,
+               header.height, header.numLevels, formatName(job), job.unit);
+        printf(" %s %.1f ms, copy %.1f ms, upload %.1f ms\n", job.fromCache ? "cache" : "cook", job.cookTime,
+               job.copyTime, jobUploadTime);
+
+        numFromCache += job.fromCache ? 1 : 0;
+        for (uint32_t level = 0; level < header.numLevels; ++level) {
+            textureBytes += job.uploadSizes[level];
+            uncompressedBytes += uint64_t(levelWidth(header, level)) * levelHeight(header, level) * 4;
+        }
+        cookTime += job.cookTime;
+        copyTime += job.copyTime;
+        uploadTime += jobUploadTime;
     }
-}
\ No newline at end of file
+
+    // Skipped images keep their unit, which matches the index of their file
+    numLoadedTextures += static_cast<GLuint>(textureFiles.size());
+
+    printf("Loaded %zu textures (%zu from cache, %zu skipped) in %.1f ms on %u threads\n", jobs.size(),
+           numFromCache, textureFiles.size() - jobs.size(), millisecondsSince(start), pool.size());
+    printf("  cache or cook %.1f ms, copy %.1f ms (summed over threads), upload %.1f ms\n",
+           cookTime, copyTime, uploadTime);
+    printf("  %.1f MB of texture memory, %.1f MB as RGBA8\n", textureBytes / 1048576.0,
+           uncompressedBytes / 1048576.0);
+}
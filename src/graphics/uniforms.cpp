@@ -0,0 +1,119 @@
+#include "graphics/uniforms.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Indexed by Uniform
+const char* const uniformNames[NUM_UNIFORMS] = {
+    "gold_texture",
+    "grass_texture",
+    "lava_texture",
+    "stonebrick_texture",
+    "galaxy_texture",
+    "glowstone_texture",
+    "wood_texture",
+    "diamond_texture",
+    "chest_texture",
+};
+
+// Binding points of the uniform blocks
+const GLuint frameBinding = 0;
+const GLuint drawBinding = 1;
+
+void bindBlock(GLuint programId, const char* name, GLuint binding, size_t size) {
+    GLuint index = glGetUniformBlockIndex(programId, name);
+    if (index == GL_INVALID_INDEX) {
+        fprintf(stderr, "WARNING: uniform block \"%s\" not found in the GPU program.\n", name);
+        return;
+    }
+    GLint blockSize = 0;
+    glGetActiveUniformBlockiv(programId, index, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    if (static_cast<size_t>(blockSize) != size) {
+        fprintf(stderr, "ERROR: uniform block \"%s\" has %d bytes, %zu expected.\n", name, blockSize, size);
+    }
+    glUniformBlockBinding(programId, index, binding);
+}
+
+} // namespace
+
+const char* UniformName(Uniform uniform) {
+    return uniformNames[uniform];
+}
+
+Uniform TextureUniform(const std::string& textureFile) {
+    std::string name = textureFile.substr(0, textureFile.find_last_of('.')) + "_texture";
+    for (int i = 0; i < NUM_UNIFORMS; ++i) {
+        if (name == uniformNames[i]) {
+            return static_cast<Uniform>(i);
+        }
+    }
+    return NUM_UNIFORMS;
+}
+
+UniformTable GetUniformLocations(GLuint programId) {
+    UniformTable locations;
+    for (int i = 0; i < NUM_UNIFORMS; ++i) {
+        locations[i] = glGetUniformLocation(programId, uniformNames[i]);
+    }
+    return locations;
+}
+
+void UniformBuffers::destroy() {
+    if (frameBuffer != 0) {
+        glDeleteBuffers(1, &frameBuffer);
+        glDeleteBuffers(1, &drawBuffer);
+        frameBuffer = 0;
+        drawBuffer = 0;
+    }
+}
+
+void UniformBuffers::create(GLuint programId) {
+    bindBlock(programId, "FrameData", frameBinding, sizeof(FrameUniforms));
+    bindBlock(programId, "DrawData", drawBinding, sizeof(DrawUniforms));
+    if (frameBuffer != 0) {
+        return;
+    }
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    drawStride = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &frameBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, frameBinding, frameBuffer);
+
+    glGenBuffers(1, &drawBuffer);
+}
+
+void UniformBuffers::beginFrame(const FrameUniforms& frame) {
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    drawData.clear();
+    numDraws = 0;
+}
+
+size_t UniformBuffers::addDraw(const DrawUniforms& draw) {
+    drawData.resize((numDraws + 1) * drawStride);
+    std::memcpy(drawData.data() + numDraws * drawStride, &draw, sizeof(DrawUniforms));
+    return numDraws++;
+}
+
+void UniformBuffers::uploadDraws() {
+    if (drawData.empty()) {
+        return;
+    }
+    // New storage from the driver, while the draws of an earlier upload
+    // still read the old one
+    glBindBuffer(GL_UNIFORM_BUFFER, drawBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(drawData.size()), drawData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffers::bindDraw(size_t slot) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, drawBinding, drawBuffer, static_cast<GLintptr>(slot * drawStride),
+                      sizeof(DrawUniforms));
+}
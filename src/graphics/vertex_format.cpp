@@ -0,0 +1,146 @@
+#include "graphics/vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "graphics/mesh.h"
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t floatExponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (floatExponent == 0xFF) {
+        // Infinity, or NaN (kept a NaN)
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    // Round to nearest, ties to even. A carry out of the mantissa goes into
+    // the exponent, which is still the right result.
+    uint32_t half;
+    uint32_t shift;
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        // Denormal: the implicit 1 becomes part of the mantissa
+        mantissa |= 0x800000;
+        shift = static_cast<uint32_t>(14 - exponent);
+        half = mantissa >> shift;
+    } else {
+        shift = 13;
+        half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+    }
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+uint32_t PackNormal(float x, float y, float z) {
+    auto packComponent = [](float value) {
+        int32_t component = static_cast<int32_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f));
+        return static_cast<uint32_t>(component) & 0x3FF;
+    };
+    return packComponent(x) | (packComponent(y) << 10) | (packComponent(z) << 20);
+}
+
+VertexQuantization ComputeVertexQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    VertexQuantization quantization;
+    quantization.offset = boundsMin;
+    quantization.scale = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return quantization;
+}
+
+void QuantizePosition(const float position[3], const VertexQuantization& quantization, uint16_t packed[3]) {
+    for (int k = 0; k < 3; ++k) {
+        float extent = quantization.scale[k];
+        float t = extent > 0.0f ? (position[k] - quantization.offset[k]) / extent : 0.0f;
+        packed[k] = static_cast<uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+}
+
+PackedVertex PackVertex(const MeshVertex& vertex, const VertexQuantization& quantization) {
+    PackedVertex packed;
+    QuantizePosition(vertex.position, quantization, packed.position);
+    packed.position[3] = 0;
+    packed.normal = PackNormal(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+    packed.texcoord[0] = FloatToHalf(vertex.texcoord[0]);
+    packed.texcoord[1] = FloatToHalf(vertex.texcoord[1]);
+    return packed;
+}
+
+void PackIndices(const uint32_t* indices, size_t numIndices, size_t numVertices, PackedMesh& packed) {
+    packed.numIndices = numIndices;
+    if (numVertices <= 0x10000) {
+        packed.indexType = GL_UNSIGNED_SHORT;
+        packed.indices.resize(numIndices * sizeof(uint16_t));
+        uint16_t* shortIndices = reinterpret_cast<uint16_t*>(packed.indices.data());
+        for (size_t i = 0; i < numIndices; ++i) {
+            shortIndices[i] = static_cast<uint16_t>(indices[i]);
+        }
+    } else {
+        packed.indexType = GL_UNSIGNED_INT;
+        packed.indices.resize(numIndices * sizeof(uint32_t));
+        if (numIndices > 0) {
+            std::memcpy(packed.indices.data(), indices, numIndices * sizeof(uint32_t));
+        }
+    }
+}
+
+void PackMesh(Mesh& mesh) {
+    PackedMesh packed;
+    packed.quantization = ComputeVertexQuantization(glm::vec3(mesh.boundsMin), glm::vec3(mesh.boundsMax));
+    packed.vertices.reserve(mesh.numVertices);
+    for (size_t i = 0; i < mesh.numVertices; ++i) {
+        packed.vertices.push_back(PackVertex(mesh.vertices[i], packed.quantization));
+    }
+    PackIndices(mesh.indices, mesh.numIndices, mesh.numVertices, packed);
+
+    mesh.quantization = packed.quantization;
+    mesh.indexType = packed.indexType;
+    mesh.packedVertexStorage = std::move(packed.vertices);
+    mesh.packedIndexStorage = std::move(packed.indices);
+    mesh.packedVertices = mesh.packedVertexStorage.data();
+    mesh.packedIndices = mesh.packedIndexStorage.data();
+}
+
+size_t IndexSize(GLenum indexType) {
+    switch (indexType) {
+        case GL_UNSIGNED_BYTE:  return sizeof(GLubyte);
+        case GL_UNSIGNED_SHORT: return sizeof(GLushort);
+        default:                return sizeof(GLuint);
+    }
+}
+
+#ifndef COWQUEST_HEADLESS
+void SetPackedVertexAttributes(bool hasNormals, bool hasTexCoords) {
+    // "(location = 0)": decoded with "position_offset" and "position_scale"
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+
+    if (hasNormals) {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(1);
+    }
+
+    if (hasTexCoords) {
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, texcoord));
+        glEnableVertexAttribArray(2);
+    }
+}
+#endif
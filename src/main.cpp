@@ -25,10 +25,31 @@
 #include "tiny_obj_loader.h"
 
 // Local headers 
+#include "core/headless.h"
+#ifndef COWQUEST_HEADLESS
 #include "core/game.h"
+#endif
+
+int main(int argc, char** argv) {
+#ifdef COWQUEST_HEADLESS
+    // Build without window and OpenGL: only the simulation can run
+    return RunHeadless(argc, argv);
+#else
+    if (argc > 1 && std::string(argv[1]) == "--headless") {
+        return RunHeadless(argc, argv);
+    }
 
-int main() {
     auto game = Game::getInstance("CowQuest", 800, 600);
+    // --record log: save the input of the session
+    // --replay log: play a saved session again, frame by frame
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--record") {
+            game->recordInput(argv[++i]);
+        } else if (std::string(argv[i]) == "--replay") {
+            game->replayInput(argv[++i]);
+        }
+    }
     game->run();
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+#endif
+}
@@ -55,13 +55,13 @@ bool AABB::intersects(const BSphere& bsphere) const {
     return intersects(center, radius);
 }
 
-bool AABB::intersects(const glm::vec4& a, const glm::vec4 b) const {
+bool AABB::intersectsSegment(const glm::vec4& a, const glm::vec4& b) const {
     glm::vec4 dir = b - a;
     float tmin = 0.0f;
     float tmax = 1.0f;
 
     for (int i = 0; i < 3; ++i) {
-        if (abs(dir[i]) < 1e-6f) {
+        if (std::abs(dir[i]) < 1e-6f) {
             // Ray is parallel to the surface of the AABB
             if (a[i] < min[i] || a[i] > max[i]) {
                 return false;
@@ -188,7 +188,7 @@ bool BSphere::intersects(const AABB& aabb) const {
     return aabb.intersects(center, radius);
 }
 
-bool BSphere::intersects(const glm::vec4& a, const glm::vec4 b) const {
+bool BSphere::intersectsSegment(const glm::vec4& a, const glm::vec4& b) const {
     glm::vec4 ab = b - a;
     glm::vec4 ac = center - a;
     float t = glm::dot(ac, ab) / glm::dot(ab, ab);
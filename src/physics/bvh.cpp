@@ -0,0 +1,138 @@
+#include "physics/bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct BuildPrimitive {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 centroid;
+    int32_t index;
+};
+
+// Recursively builds the subtree over prims[first, first+count) into nodes[nodeIndex]
+void buildSubtree(
+    std::vector<StaticBVH::Node>& nodes,
+    std::vector<BuildPrimitive>& prims,
+    int32_t nodeIndex,
+    int32_t first,
+    int32_t count,
+    int maxLeafSize
+) {
+    glm::vec3 boundsMin = prims[first].min;
+    glm::vec3 boundsMax = prims[first].max;
+    glm::vec3 centroidMin = prims[first].centroid;
+    glm::vec3 centroidMax = prims[first].centroid;
+    for (int32_t i = first + 1; i < first + count; ++i) {
+        boundsMin = glm::min(boundsMin, prims[i].min);
+        boundsMax = glm::max(boundsMax, prims[i].max);
+        centroidMin = glm::min(centroidMin, prims[i].centroid);
+        centroidMax = glm::max(centroidMax, prims[i].centroid);
+    }
+
+    nodes[nodeIndex].min = boundsMin;
+    nodes[nodeIndex].max = boundsMax;
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    // Small ranges, or ranges whose centroids all coincide, become leaves
+    if (count <= maxLeafSize || extent[axis] <= 0.0f) {
+        nodes[nodeIndex].leftOrFirst = first;
+        nodes[nodeIndex].count = count;
+        return;
+    }
+
+    // Median split along the axis of largest centroid extent
+    int32_t half = count / 2;
+    std::nth_element(
+        prims.begin() + first,
+        prims.begin() + first + half,
+        prims.begin() + first + count,
+        [axis](const BuildPrimitive& a, const BuildPrimitive& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        }
+    );
+
+    // Children are allocated as a pair so that right = left + 1
+    int32_t left = static_cast<int32_t>(nodes.size());
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    nodes[nodeIndex].leftOrFirst = left;
+    nodes[nodeIndex].count = 0;
+
+    buildSubtree(nodes, prims, left, first, half, maxLeafSize);
+    buildSubtree(nodes, prims, left + 1, first + half, count - half, maxLeafSize);
+}
+
+} // namespace
+
+void StaticBVH::build(const std::vector<AABB>& bounds, int maxLeafSize) {
+    clear();
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::vector<BuildPrimitive> prims(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        prims[i].min = glm::vec3(bounds[i].getMin());
+        prims[i].max = glm::vec3(bounds[i].getMax());
+        prims[i].centroid = (prims[i].min + prims[i].max) * 0.5f;
+        prims[i].index = static_cast<int32_t>(i);
+    }
+
+    nodes.reserve(2 * bounds.size());
+    nodes.emplace_back();
+    buildSubtree(nodes, prims, 0, 0, static_cast<int32_t>(prims.size()), maxLeafSize);
+    nodes.shrink_to_fit();
+
+    primitives.resize(prims.size());
+    primMin.resize(prims.size());
+    primMax.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); ++i) {
+        primitives[i] = prims[i].index;
+        primMin[i] = prims[i].min;
+        primMax[i] = prims[i].max;
+    }
+}
+
+void StaticBVH::clear() {
+    nodes.clear();
+    primitives.clear();
+    primMin.clear();
+    primMax.clear();
+}
+
+bool StaticBVH::segmentOverlaps(
+    const glm::vec3& origin,
+    const glm::vec3& dir,
+    const glm::vec3& invDir,
+    const glm::vec3& min,
+    const glm::vec3& max
+) {
+    float tmin = 0.0f;
+    float tmax = 1.0f;
+
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(dir[i]) < 1e-6f) {
+            // Segment is parallel to this slab
+            if (origin[i] < min[i] || origin[i] > max[i]) {
+                return false;
+            }
+        } else {
+            float t1 = (min[i] - origin[i]) * invDir[i];
+            float t2 = (max[i] - origin[i]) * invDir[i];
+            tmin = std::max(tmin, std::min(t1, t2));
+            tmax = std::min(tmax, std::max(t1, t2));
+            if (tmin > tmax) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
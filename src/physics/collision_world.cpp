@@ -0,0 +1,261 @@
+#include "physics/collision_world.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(COWQUEST_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(COWQUEST_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+CollisionWorld::CollisionWorld() : count(0) {
+    resizeArrays(0);
+}
+
+void CollisionWorld::resizeArrays(size_t numObjects) {
+    // New entries are empty boxes (min > max), which never overlap anything
+    const size_t n = numObjects + batchSize;
+    minX.resize(n, FLT_MAX); minY.resize(n, FLT_MAX); minZ.resize(n, FLT_MAX);
+    maxX.resize(n, -FLT_MAX); maxY.resize(n, -FLT_MAX); maxZ.resize(n, -FLT_MAX);
+    centerX.resize(n, 0.0f); centerY.resize(n, 0.0f); centerZ.resize(n, 0.0f);
+    radius.resize(n, 0.0f);
+    sphereMask.resize(n, 0);
+}
+
+size_t CollisionWorld::add(const AABB& aabb, const BSphere& bsphere, bool useSphere) {
+    size_t index = count++;
+    resizeArrays(count);
+    set(index, aabb, bsphere, useSphere);
+    return index;
+}
+
+void CollisionWorld::set(size_t index, const AABB& aabb, const BSphere& bsphere, bool useSphere) {
+    glm::vec4 min = aabb.getMin();
+    glm::vec4 max = aabb.getMax();
+    glm::vec4 center = bsphere.getCenter();
+    minX[index] = min.x; minY[index] = min.y; minZ[index] = min.z;
+    maxX[index] = max.x; maxY[index] = max.y; maxZ[index] = max.z;
+    centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+    radius[index] = bsphere.getRadius();
+    sphereMask[index] = useSphere ? -1 : 0;
+}
+
+void CollisionWorld::clear() {
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    centerX.clear(); centerY.clear(); centerZ.clear();
+    radius.clear();
+    sphereMask.clear();
+    count = 0;
+    resizeArrays(0);
+}
+
+const char* CollisionWorld::simdPath() {
+#if defined(COWQUEST_SIMD_AVX2)
+    return "AVX2";
+#elif defined(COWQUEST_SIMD_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+uint32_t CollisionWorld::testRange(const CollisionQuery& query, size_t first, size_t n) const {
+#if defined(COWQUEST_SIMD_AVX2)
+    uint32_t laneMask = n >= batchSize ? (1u << batchSize) - 1u : (1u << n) - 1u;
+    return testLanesAVX2(query, first) & laneMask;
+#elif defined(COWQUEST_SIMD_SSE2)
+    uint32_t laneMask = n >= batchSize ? (1u << batchSize) - 1u : (1u << n) - 1u;
+    return testLanesSSE2(query, first) & laneMask;
+#else
+    return testLanesScalar(query, first, std::min(n, batchSize));
+#endif
+}
+
+uint32_t CollisionWorld::testRangeScalar(const CollisionQuery& query, size_t first, size_t n) const {
+    return testLanesScalar(query, first, std::min(n, batchSize));
+}
+
+// The kernels below must do the same float operations in the same order, so
+// that every instruction set returns exactly the same bits:
+//   box query,    box object:    per-axis interval overlap
+//   box query,    sphere object: squared distance from the center to the box <= r^2
+//   sphere query, box object:    squared distance from the center to the box <= r^2
+//   sphere query, sphere object: squared distance between centers <= (r1 + r2)^2
+
+uint32_t CollisionWorld::testLanesScalar(const CollisionQuery& query, size_t first, size_t n) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < n; ++lane) {
+        size_t i = first + lane;
+        bool hit;
+        if (!query.useSphere) {
+            if (sphereMask[i]) {
+                float dx = std::max(std::max(query.min.x - centerX[i], centerX[i] - query.max.x), 0.0f);
+                float dy = std::max(std::max(query.min.y - centerY[i], centerY[i] - query.max.y), 0.0f);
+                float dz = std::max(std::max(query.min.z - centerZ[i], centerZ[i] - query.max.z), 0.0f);
+                hit = dx*dx + dy*dy + dz*dz <= radius[i] * radius[i];
+            } else {
+                hit = (query.min.x <= maxX[i]) & (query.max.x >= minX[i]) &
+                      (query.min.y <= maxY[i]) & (query.max.y >= minY[i]) &
+                      (query.min.z <= maxZ[i]) & (query.max.z >= minZ[i]);
+            }
+        } else {
+            if (sphereMask[i]) {
+                float dx = centerX[i] - query.center.x;
+                float dy = centerY[i] - query.center.y;
+                float dz = centerZ[i] - query.center.z;
+                float sum = query.radius + radius[i];
+                hit = dx*dx + dy*dy + dz*dz <= sum * sum;
+            } else {
+                float dx = std::max(std::max(minX[i] - query.center.x, query.center.x - maxX[i]), 0.0f);
+                float dy = std::max(std::max(minY[i] - query.center.y, query.center.y - maxY[i]), 0.0f);
+                float dz = std::max(std::max(minZ[i] - query.center.z, query.center.z - maxZ[i]), 0.0f);
+                hit = dx*dx + dy*dy + dz*dz <= query.radius * query.radius;
+            }
+        }
+        mask |= static_cast<uint32_t>(hit) << lane;
+    }
+    return mask;
+}
+
+#if defined(COWQUEST_SIMD_AVX2)
+
+namespace {
+
+inline __m256 lengthSquared(__m256 dx, __m256 dy, __m256 dz) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+}
+
+// Distance from 'p' to the interval [lo, hi] along one axis, 0 inside
+inline __m256 outsideDistance(__m256 lo, __m256 hi, __m256 p) {
+    return _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(lo, p), _mm256_sub_ps(p, hi)), _mm256_setzero_ps());
+}
+
+} // namespace
+
+uint32_t CollisionWorld::testLanesAVX2(const CollisionQuery& query, size_t first) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < batchSize; lane += 8) {
+        const size_t i = first + lane;
+        __m256 hitBox;
+        __m256 hitSphere;
+        if (!query.useSphere) {
+            const __m256 qMinX = _mm256_set1_ps(query.min.x), qMaxX = _mm256_set1_ps(query.max.x);
+            const __m256 qMinY = _mm256_set1_ps(query.min.y), qMaxY = _mm256_set1_ps(query.max.y);
+            const __m256 qMinZ = _mm256_set1_ps(query.min.z), qMaxZ = _mm256_set1_ps(query.max.z);
+
+            hitBox = _mm256_and_ps(
+                _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(qMinX, _mm256_loadu_ps(&maxX[i]), _CMP_LE_OQ),
+                                  _mm256_cmp_ps(qMaxX, _mm256_loadu_ps(&minX[i]), _CMP_GE_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(qMinY, _mm256_loadu_ps(&maxY[i]), _CMP_LE_OQ),
+                                  _mm256_cmp_ps(qMaxY, _mm256_loadu_ps(&minY[i]), _CMP_GE_OQ))),
+                _mm256_and_ps(_mm256_cmp_ps(qMinZ, _mm256_loadu_ps(&maxZ[i]), _CMP_LE_OQ),
+                              _mm256_cmp_ps(qMaxZ, _mm256_loadu_ps(&minZ[i]), _CMP_GE_OQ)));
+
+            const __m256 r = _mm256_loadu_ps(&radius[i]);
+            const __m256 d2 = lengthSquared(
+                outsideDistance(qMinX, qMaxX, _mm256_loadu_ps(&centerX[i])),
+                outsideDistance(qMinY, qMaxY, _mm256_loadu_ps(&centerY[i])),
+                outsideDistance(qMinZ, qMaxZ, _mm256_loadu_ps(&centerZ[i])));
+            hitSphere = _mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LE_OQ);
+        } else {
+            const __m256 qX = _mm256_set1_ps(query.center.x);
+            const __m256 qY = _mm256_set1_ps(query.center.y);
+            const __m256 qZ = _mm256_set1_ps(query.center.z);
+            const __m256 qR = _mm256_set1_ps(query.radius);
+
+            const __m256 boxD2 = lengthSquared(
+                outsideDistance(_mm256_loadu_ps(&minX[i]), _mm256_loadu_ps(&maxX[i]), qX),
+                outsideDistance(_mm256_loadu_ps(&minY[i]), _mm256_loadu_ps(&maxY[i]), qY),
+                outsideDistance(_mm256_loadu_ps(&minZ[i]), _mm256_loadu_ps(&maxZ[i]), qZ));
+            hitBox = _mm256_cmp_ps(boxD2, _mm256_mul_ps(qR, qR), _CMP_LE_OQ);
+
+            const __m256 sum = _mm256_add_ps(qR, _mm256_loadu_ps(&radius[i]));
+            const __m256 sphereD2 = lengthSquared(
+                _mm256_sub_ps(_mm256_loadu_ps(&centerX[i]), qX),
+                _mm256_sub_ps(_mm256_loadu_ps(&centerY[i]), qY),
+                _mm256_sub_ps(_mm256_loadu_ps(&centerZ[i]), qZ));
+            hitSphere = _mm256_cmp_ps(sphereD2, _mm256_mul_ps(sum, sum), _CMP_LE_OQ);
+        }
+
+        const __m256 useSphere = _mm256_castsi256_ps(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&sphereMask[i])));
+        const __m256 hit = _mm256_blendv_ps(hitBox, hitSphere, useSphere);
+        mask |= static_cast<uint32_t>(_mm256_movemask_ps(hit)) << lane;
+    }
+    return mask;
+}
+
+#elif defined(COWQUEST_SIMD_SSE2)
+
+namespace {
+
+inline __m128 lengthSquared(__m128 dx, __m128 dy, __m128 dz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+}
+
+// Distance from 'p' to the interval [lo, hi] along one axis, 0 inside
+inline __m128 outsideDistance(__m128 lo, __m128 hi, __m128 p) {
+    return _mm_max_ps(_mm_max_ps(_mm_sub_ps(lo, p), _mm_sub_ps(p, hi)), _mm_setzero_ps());
+}
+
+} // namespace
+
+uint32_t CollisionWorld::testLanesSSE2(const CollisionQuery& query, size_t first) const {
+    uint32_t mask = 0;
+    for (size_t lane = 0; lane < batchSize; lane += 4) {
+        const size_t i = first + lane;
+        __m128 hitBox;
+        __m128 hitSphere;
+        if (!query.useSphere) {
+            const __m128 qMinX = _mm_set1_ps(query.min.x), qMaxX = _mm_set1_ps(query.max.x);
+            const __m128 qMinY = _mm_set1_ps(query.min.y), qMaxY = _mm_set1_ps(query.max.y);
+            const __m128 qMinZ = _mm_set1_ps(query.min.z), qMaxZ = _mm_set1_ps(query.max.z);
+
+            hitBox = _mm_and_ps(
+                _mm_and_ps(
+                    _mm_and_ps(_mm_cmple_ps(qMinX, _mm_loadu_ps(&maxX[i])),
+                               _mm_cmpge_ps(qMaxX, _mm_loadu_ps(&minX[i]))),
+                    _mm_and_ps(_mm_cmple_ps(qMinY, _mm_loadu_ps(&maxY[i])),
+                               _mm_cmpge_ps(qMaxY, _mm_loadu_ps(&minY[i])))),
+                _mm_and_ps(_mm_cmple_ps(qMinZ, _mm_loadu_ps(&maxZ[i])),
+                           _mm_cmpge_ps(qMaxZ, _mm_loadu_ps(&minZ[i]))));
+
+            const __m128 r = _mm_loadu_ps(&radius[i]);
+            const __m128 d2 = lengthSquared(
+                outsideDistance(qMinX, qMaxX, _mm_loadu_ps(&centerX[i])),
+                outsideDistance(qMinY, qMaxY, _mm_loadu_ps(&centerY[i])),
+                outsideDistance(qMinZ, qMaxZ, _mm_loadu_ps(&centerZ[i])));
+            hitSphere = _mm_cmple_ps(d2, _mm_mul_ps(r, r));
+        } else {
+            const __m128 qX = _mm_set1_ps(query.center.x);
+            const __m128 qY = _mm_set1_ps(query.center.y);
+            const __m128 qZ = _mm_set1_ps(query.center.z);
+            const __m128 qR = _mm_set1_ps(query.radius);
+
+            const __m128 boxD2 = lengthSquared(
+                outsideDistance(_mm_loadu_ps(&minX[i]), _mm_loadu_ps(&maxX[i]), qX),
+                outsideDistance(_mm_loadu_ps(&minY[i]), _mm_loadu_ps(&maxY[i]), qY),
+                outsideDistance(_mm_loadu_ps(&minZ[i]), _mm_loadu_ps(&maxZ[i]), qZ));
+            hitBox = _mm_cmple_ps(boxD2, _mm_mul_ps(qR, qR));
+
+            const __m128 sum = _mm_add_ps(qR, _mm_loadu_ps(&radius[i]));
+            const __m128 sphereD2 = lengthSquared(
+                _mm_sub_ps(_mm_loadu_ps(&centerX[i]), qX),
+                _mm_sub_ps(_mm_loadu_ps(&centerY[i]), qY),
+                _mm_sub_ps(_mm_loadu_ps(&centerZ[i]), qZ));
+            hitSphere = _mm_cmple_ps(sphereD2, _mm_mul_ps(sum, sum));
+        }
+
+        // SSE2 has no blend instruction: select with and/andnot/or
+        const __m128 useSphere = _mm_castsi128_ps(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sphereMask[i])));
+        const __m128 hit = _mm_or_ps(_mm_and_ps(useSphere, hitSphere), _mm_andnot_ps(useSphere, hitBox));
+        mask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << lane;
+    }
+    return mask;
+}
+
+#endif
@@ -2,6 +2,8 @@
 #include <vector>
 #include <iostream>
 #include <ctime>
+#include <algorithm>
+#include <limits>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -16,13 +18,13 @@ static void reverseTranslation(GameObject& obj) {
     glm::vec3 lastMove = obj.getLastMove();
     obj.translate(-lastMove.x, -lastMove.y, -lastMove.z);
     obj.setLastMove(glm::vec3(0.0f));
-    obj.setLastMoveTime(0.0);
+    obj.setLastMoveTime(0);
 }
 
 void resolveCollision(GameObject& obj1, GameObject& obj2) {
     if (obj1.intersects(obj2)) {
         // Undo the last translation of the object that moved most recently
-        if (difftime(obj1.getLastMoveTime(), obj2.getLastMoveTime()) > 0) {
+        if (obj1.getLastMoveTime() > obj2.getLastMoveTime()) {
             reverseTranslation(obj1);
         } else {
             reverseTranslation(obj2);
@@ -30,52 +32,222 @@ void resolveCollision(GameObject& obj1, GameObject& obj2) {
     }
 }
 
+void resolveCollisions(std::vector<GameObject>& objects, SweepAndPrune& broadphase) {
+    broadphase.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        broadphase.setBox(i, objects[i].getBounds());
+    }
+
+    for (const CollisionPair& pair : broadphase.findPairs()) {
+        resolveCollision(objects[pair.a], objects[pair.b]);
+    }
+}
+
 void resolveCollisions(std::vector<GameObject>& objects) {
-    for (int i = 0; i < objects.size(); ++i) {
-        for (int j = i + 1; j < objects.size(); ++j) {
-            resolveCollision(objects[i], objects[j]);
+    SweepAndPrune broadphase;
+    resolveCollisions(objects, broadphase);
+}
+
+void buildStaticCollisionScene(
+    StaticCollisionScene& staticScene,
+    const VirtualScene& virtualScene,
+    const std::vector<ObjectHandle>& dynamicObjects
+) {
+    staticScene.objects.clear();
+
+    std::vector<AABB> bounds;
+    for (const auto& [name, handle] : virtualScene.getNames()) {
+        if (std::find(dynamicObjects.begin(), dynamicObjects.end(), handle) != dynamicObjects.end()) {
+            continue;
         }
+        const GameObject* object = virtualScene.get(handle);
+        staticScene.objects.push_back(object);
+        bounds.push_back(object->getAABB());
+    }
+
+    // Leaves of up to one batch, tested at once by the collision world
+    staticScene.bvh.build(bounds, static_cast<int>(CollisionWorld::batchSize));
+
+    staticScene.world.clear();
+    for (size_t position = 0; position < bounds.size(); ++position) {
+        const AABB& aabb = bounds[staticScene.bvh.getPrimitive(static_cast<int32_t>(position))];
+        staticScene.world.add(aabb, BSphere(aabb), false);
     }
 }
 
-void resolveCollisionsWithStaticObjects(GameObject* movingObject, const VirtualScene& staticObjects) {
-    for (const auto& [name, staticObject] : staticObjects) {
-        std::string movingObjectName = movingObject->getSceneObject().name;
-        std::string staticObjectName = staticObject->getSceneObject().name;
-        if (movingObjectName == staticObjectName || staticObjectName == "the_plane" || staticObjectName == "the_cow") {
+// Call 'visit(index)' for every static object whose box overlaps [min, max],
+// testing whole BVH leaves with the batch kernels of the collision world.
+// Stops as soon as 'visit' returns true.
+template <typename Visitor>
+static void queryStaticObjects(
+    const StaticCollisionScene& staticScene,
+    const glm::vec3& min,
+    const glm::vec3& max,
+    Visitor&& visit
+) {
+    const CollisionQuery query = CollisionQuery::box(min, max);
+    staticScene.bvh.queryLeaves(min, max, [&](int32_t first, int32_t count) {
+        // Leaves whose centroids coincide may hold more than one batch
+        for (int32_t batch = first; batch < first + count; batch += CollisionWorld::batchSize) {
+            size_t n = std::min<size_t>(first + count - batch, CollisionWorld::batchSize);
+            uint32_t mask = staticScene.world.testRange(query, batch, n);
+            while (mask) {
+                int32_t position = batch + static_cast<int32_t>(CollisionWorld::lowestBit(mask));
+                mask &= mask - 1;
+                if (visit(staticScene.bvh.getPrimitive(position))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+}
+
+void resolveCollisionsWithStaticObjects(GameObject* movingObject, const StaticCollisionScene& staticScene) {
+    const AABB& aabb = movingObject->getAABB();
+    queryStaticObjects(staticScene, glm::vec3(aabb.getMin()), glm::vec3(aabb.getMax()), [&](int index) {
+        const GameObject* staticObject = staticScene.objects[index];
+        if (staticObject == movingObject || !movingObject->intersects(*staticObject)) {
+            return false;
+        }
+        std::cout << "Collision between " << movingObject->getSceneObject().name
+                  << " and " << staticObject->getSceneObject().name << std::endl;
+        reverseTranslation(*movingObject); // Undo the last translation of the moving object
+        return true;
+    });
+}
+
+bool sweepAABB(
+    const glm::vec3& min,
+    const glm::vec3& max,
+    const glm::vec3& displacement,
+    const glm::vec3& otherMin,
+    const glm::vec3& otherMax,
+    float& time,
+    glm::vec3& normal
+) {
+    // Slab test of the displacement against the other box grown by the size
+    // of the moving box (Minkowski sum). Touching faces do not count as an
+    // overlap, so that a box resting against a wall can slide along it.
+    float entry = -std::numeric_limits<float>::infinity();
+    float exit = std::numeric_limits<float>::infinity();
+    int entryAxis = -1;
+
+    for (int i = 0; i < 3; ++i) {
+        if (displacement[i] == 0.0f) {
+            if (max[i] <= otherMin[i] || min[i] >= otherMax[i]) {
+                return false;
+            }
             continue;
         }
-        if (movingObject->intersects(*staticObject)) {
-            std::cout << "Collision between " << movingObjectName << " and " << staticObjectName << std::endl;
-            reverseTranslation(*movingObject); // Undo the last translation of the moving object
+        float invDisplacement = 1.0f / displacement[i];
+        float t1 = (otherMin[i] - max[i]) * invDisplacement;
+        float t2 = (otherMax[i] - min[i]) * invDisplacement;
+        float tNear = std::min(t1, t2);
+        float tFar = std::max(t1, t2);
+        if (tNear > entry) {
+            entry = tNear;
+            entryAxis = i;
         }
+        exit = std::min(exit, tFar);
     }
+
+    if (entryAxis < 0 || entry > exit || entry < 0.0f || entry >= 1.0f) {
+        return false;
+    }
+
+    time = entry;
+    normal = glm::vec3(0.0f);
+    normal[entryAxis] = displacement[entryAxis] > 0.0f ? -1.0f : 1.0f;
+    return true;
 }
 
-bool checkCollisionWithStaticObjects(GameObject* movingObject, const VirtualScene& staticObjects) {
-    for (const auto& [name, staticObject] : staticObjects) {
-        std::string movingObjectName = movingObject->getSceneObject().name;
-        std::string staticObjectName = staticObject->getSceneObject().name;
-        if (movingObjectName == staticObjectName || staticObjectName == "the_plane" || staticObjectName == "the_cow") {
-            continue;
+bool sweepObjects(
+    const glm::vec3& min,
+    const glm::vec3& max,
+    const glm::vec3& displacement,
+    const StaticCollisionScene& staticScene,
+    const DynamicAABBTree& dynamicTree,
+    const GameObject* movingObject,
+    const GameObject* ignoredObject,
+    SweepHit& hit
+) {
+    // Every object met during the movement overlaps the swept box
+    glm::vec3 sweptMin = glm::min(min, min + displacement);
+    glm::vec3 sweptMax = glm::max(max, max + displacement);
+
+    hit.time = 1.0f;
+    hit.object = nullptr;
+    auto sweep = [&](const GameObject* other) {
+        if (other == movingObject || other == ignoredObject) {
+            return;
         }
-        if (staticObjectName.find("the_chest") != std::string::npos) {
-            glm::vec4 movingObjectPosition = movingObject->getAABB().getCenter();
-            glm::vec3 lastMove = movingObject->getLastMove();
-            glm::vec4 lastMove4 = glm::vec4(lastMove.x, lastMove.y, lastMove.z, 0.0f);
-            glm::vec4 origin = movingObjectPosition - lastMove4;
-            glm::vec4 dir = lastMove4;
-            if (checkCollisionRayAABB(origin, dir, staticObject->getAABB())) {
-                std::cout << "Collision between " << movingObjectName << " and " << staticObjectName << std::endl;
-                return true;
-            }
+        AABB bounds = other->getBounds();
+        float time;
+        glm::vec3 normal;
+        if (sweepAABB(min, max, displacement, glm::vec3(bounds.getMin()), glm::vec3(bounds.getMax()), time, normal) &&
+            time < hit.time) {
+            hit.time = time;
+            hit.normal = normal;
+            hit.object = other;
         }
-        if (movingObject->intersects(*staticObject)) {
-            std::cout << "Collision between " << movingObjectName << " and " << staticObjectName << std::endl;
-            return true;
+    };
+
+    queryStaticObjects(staticScene, sweptMin, sweptMax, [&](int index) {
+        sweep(staticScene.objects[index]);
+        return false;
+    });
+    dynamicTree.query(sweptMin, sweptMax, [&](int32_t proxyId) {
+        sweep(static_cast<const GameObject*>(dynamicTree.getUserData(proxyId)));
+        return false;
+    });
+
+    return hit.object != nullptr;
+}
+
+glm::vec3 moveAndSlide(
+    GameObject* movingObject,
+    const glm::vec3& displacement,
+    const StaticCollisionScene& staticScene,
+    const DynamicAABBTree& dynamicTree,
+    const GameObject* ignoredObject
+) {
+    // The box is moved locally and the object is translated once at the end,
+    // so that its last move is the whole displacement done
+    AABB bounds = movingObject->getBounds();
+    glm::vec3 min = glm::vec3(bounds.getMin());
+    glm::vec3 max = glm::vec3(bounds.getMax());
+
+    glm::vec3 moved(0.0f);
+    glm::vec3 remaining = displacement;
+    for (int iteration = 0; iteration < maxSlideIterations; ++iteration) {
+        if (glm::length(remaining) <= collisionSkin) {
+            break;
+        }
+
+        SweepHit hit;
+        if (!sweepObjects(min, max, remaining, staticScene, dynamicTree, movingObject, ignoredObject, hit)) {
+            moved += remaining;
+            break;
         }
+
+        // Stop 'collisionSkin' away from the face that was hit, then keep the
+        // part of the remaining movement that is parallel to that face
+        float approachSpeed = std::abs(glm::dot(remaining, hit.normal));
+        float time = std::max(hit.time - collisionSkin / approachSpeed, 0.0f);
+        glm::vec3 step = remaining * time;
+        min += step;
+        max += step;
+        moved += step;
+
+        remaining -= step;
+        remaining -= glm::dot(remaining, hit.normal) * hit.normal;
     }
-    return false;
+
+    if (moved != glm::vec3(0.0f)) {
+        movingObject->translate(moved.x, moved.y, moved.z);
+    }
+    return moved;
 }
 
 bool checkCollisionRaySphere(
@@ -105,4 +277,11 @@ bool checkCollisionRayAABB(
     float tminmax = glm::max(tmin.x, glm::max(tmin.y, tmin.z));
     float tmaxmin = glm::min(tmax.x, glm::min(tmax.y, tmax.z));
     return tminmax <= tmaxmin;
-}
\ No newline at end of file
+}
+bool checkCollisionSegmentAABB(
+    const glm::vec4& a,
+    const glm::vec4& b,
+    const AABB& aabb
+) {
+    return aabb.intersectsSegment(a, b);
+}
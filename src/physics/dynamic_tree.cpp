@@ -0,0 +1,271 @@
+#include "physics/dynamic_tree.h"
+
+#include <algorithm>
+#include <cassert>
+
+DynamicAABBTree::DynamicAABBTree()
+    : root(nullNode), freeList(nullNode), proxyCount(0) {}
+
+int32_t DynamicAABBTree::allocateNode() {
+    if (freeList == nullNode) {
+        nodes.emplace_back();
+        freeList = static_cast<int32_t>(nodes.size()) - 1;
+        nodes[freeList].parent = nullNode;
+    }
+
+    int32_t nodeId = freeList;
+    freeList = nodes[nodeId].parent;
+
+    Node& node = nodes[nodeId];
+    node.parent = nullNode;
+    node.child1 = nullNode;
+    node.child2 = nullNode;
+    node.height = 0;
+    node.userData = nullptr;
+    return nodeId;
+}
+
+void DynamicAABBTree::freeNode(int32_t nodeId) {
+    nodes[nodeId].parent = freeList;
+    nodes[nodeId].height = -1;
+    freeList = nodeId;
+}
+
+int32_t DynamicAABBTree::createProxy(const AABB& aabb, void* userData) {
+    int32_t proxyId = allocateNode();
+
+    glm::vec3 margin(aabbMargin);
+    nodes[proxyId].min = glm::vec3(aabb.getMin()) - margin;
+    nodes[proxyId].max = glm::vec3(aabb.getMax()) + margin;
+    nodes[proxyId].userData = userData;
+    nodes[proxyId].height = 0;
+
+    insertLeaf(proxyId);
+    ++proxyCount;
+
+    return proxyId;
+}
+
+void DynamicAABBTree::destroyProxy(int32_t proxyId) {
+    assert(nodes[proxyId].isLeaf());
+
+    removeLeaf(proxyId);
+    freeNode(proxyId);
+    --proxyCount;
+}
+
+bool DynamicAABBTree::moveProxy(int32_t proxyId, const AABB& aabb, const glm::vec3& displacement) {
+    assert(nodes[proxyId].isLeaf());
+
+    glm::vec3 min(aabb.getMin());
+    glm::vec3 max(aabb.getMax());
+
+    // Still inside the fat AABB: nothing to do
+    Node& node = nodes[proxyId];
+    if (node.min.x <= min.x && node.min.y <= min.y && node.min.z <= min.z &&
+        max.x <= node.max.x && max.y <= node.max.y && max.z <= node.max.z) {
+        return false;
+    }
+
+    removeLeaf(proxyId);
+
+    // Extend the AABB in the direction of movement, predicting where the
+    // object will be in the next updates
+    glm::vec3 margin(aabbMargin);
+    glm::vec3 fatMin = min - margin;
+    glm::vec3 fatMax = max + margin;
+    glm::vec3 d = displacementMultiplier * displacement;
+    for (int i = 0; i < 3; ++i) {
+        if (d[i] < 0.0f) {
+            fatMin[i] += d[i];
+        } else {
+            fatMax[i] += d[i];
+        }
+    }
+    nodes[proxyId].min = fatMin;
+    nodes[proxyId].max = fatMax;
+
+    insertLeaf(proxyId);
+    return true;
+}
+
+void DynamicAABBTree::insertLeaf(int32_t leaf) {
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // Find the best sibling using the surface area heuristic
+    glm::vec3 leafMin = nodes[leaf].min;
+    glm::vec3 leafMax = nodes[leaf].max;
+    int32_t index = root;
+    while (!nodes[index].isLeaf()) {
+        int32_t child1 = nodes[index].child1;
+        int32_t child2 = nodes[index].child2;
+
+        float nodeArea = area(nodes[index].min, nodes[index].max);
+        float combinedArea = area(glm::min(nodes[index].min, leafMin), glm::max(nodes[index].max, leafMax));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+        auto descendCost = [&](int32_t child) {
+            glm::vec3 mergedMin = glm::min(nodes[child].min, leafMin);
+            glm::vec3 mergedMax = glm::max(nodes[child].max, leafMax);
+            float mergedArea = area(mergedMin, mergedMax);
+            if (nodes[child].isLeaf()) {
+                return mergedArea + inheritanceCost;
+            }
+            return mergedArea - area(nodes[child].min, nodes[child].max) + inheritanceCost;
+        };
+
+        float cost1 = descendCost(child1);
+        float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    // Create a new parent for the sibling and the leaf
+    int32_t sibling = index;
+    int32_t oldParent = nodes[sibling].parent;
+    int32_t newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].min = glm::min(leafMin, nodes[sibling].min);
+    nodes[newParent].max = glm::max(leafMax, nodes[sibling].max);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    fixUpwards(nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(int32_t leaf) {
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    int32_t parent = nodes[leaf].parent;
+    int32_t grandParent = nodes[parent].parent;
+    int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != nullNode) {
+        // Replace the parent by the sibling
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        fixUpwards(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+    }
+}
+
+void DynamicAABBTree::fixUpwards(int32_t index) {
+    while (index != nullNode) {
+        index = balance(index);
+
+        int32_t child1 = nodes[index].child1;
+        int32_t child2 = nodes[index].child2;
+
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+        nodes[index].min = glm::min(nodes[child1].min, nodes[child2].min);
+        nodes[index].max = glm::max(nodes[child1].max, nodes[child2].max);
+
+        index = nodes[index].parent;
+    }
+}
+
+int32_t DynamicAABBTree::balance(int32_t iA) {
+    Node& A = nodes[iA];
+    if (A.isLeaf() || A.height < 2) {
+        return iA;
+    }
+
+    int32_t iB = A.child1;
+    int32_t iC = A.child2;
+    int32_t heightBalance = nodes[iC].height - nodes[iB].height;
+
+    // Rotate C up (C is the taller child), or B up (B is the taller child).
+    // In both cases the taller child F takes the place of A, A takes the
+    // place of F, and the shorter grandchild is moved below A.
+    auto rotateUp = [&](int32_t iF, bool fIsChild2) {
+        Node& F = nodes[iF];
+        int32_t iG = F.child1;
+        int32_t iH = F.child2;
+        int32_t iOther = fIsChild2 ? iB : iC;
+
+        // Swap A and F
+        F.child1 = iA;
+        F.parent = A.parent;
+        A.parent = iF;
+
+        if (F.parent != nullNode) {
+            if (nodes[F.parent].child1 == iA) {
+                nodes[F.parent].child1 = iF;
+            } else {
+                nodes[F.parent].child2 = iF;
+            }
+        } else {
+            root = iF;
+        }
+
+        // Keep the taller grandchild under F, move the other one under A
+        int32_t iKeep = iG;
+        int32_t iMove = iH;
+        if (nodes[iG].height <= nodes[iH].height) {
+            iKeep = iH;
+            iMove = iG;
+        }
+
+        F.child2 = iKeep;
+        if (fIsChild2) {
+            A.child2 = iMove;
+        } else {
+            A.child1 = iMove;
+        }
+        nodes[iMove].parent = iA;
+
+        A.min = glm::min(nodes[iOther].min, nodes[iMove].min);
+        A.max = glm::max(nodes[iOther].max, nodes[iMove].max);
+        F.min = glm::min(A.min, nodes[iKeep].min);
+        F.max = glm::max(A.max, nodes[iKeep].max);
+
+        A.height = 1 + std::max(nodes[iOther].height, nodes[iMove].height);
+        F.height = 1 + std::max(A.height, nodes[iKeep].height);
+
+        return iF;
+    };
+
+    if (heightBalance > 1) {
+        return rotateUp(iC, true);
+    }
+    if (heightBalance < -1) {
+        return rotateUp(iB, false);
+    }
+    return iA;
+}
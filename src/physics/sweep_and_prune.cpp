@@ -0,0 +1,136 @@
+#include "physics/sweep_and_prune.h"
+
+#include <algorithm>
+
+void SweepAndPrune::resize(size_t numBoxes) {
+    if (numBoxes == minX.size()) {
+        return;
+    }
+    minX.resize(numBoxes); minY.resize(numBoxes); minZ.resize(numBoxes);
+    maxX.resize(numBoxes); maxY.resize(numBoxes); maxZ.resize(numBoxes);
+    activePosition.resize(numBoxes);
+    needsReset = true;
+}
+
+void SweepAndPrune::reset() {
+    const size_t numBoxes = minX.size();
+
+    // Variance of the box centers along each axis
+    double sum[3] = {0.0, 0.0, 0.0};
+    double sumSquares[3] = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < numBoxes; ++i) {
+        double center[3] = {
+            0.5 * (minX[i] + maxX[i]),
+            0.5 * (minY[i] + maxY[i]),
+            0.5 * (minZ[i] + maxZ[i])
+        };
+        for (int a = 0; a < 3; ++a) {
+            sum[a] += center[a];
+            sumSquares[a] += center[a] * center[a];
+        }
+    }
+    axis = 0;
+    double bestVariance = -1.0;
+    for (int a = 0; a < 3; ++a) {
+        double mean = numBoxes ? sum[a] / numBoxes : 0.0;
+        double variance = numBoxes ? sumSquares[a] / numBoxes - mean * mean : 0.0;
+        if (variance > bestVariance) {
+            bestVariance = variance;
+            axis = a;
+        }
+    }
+
+    endpoints.resize(2 * numBoxes);
+    for (size_t i = 0; i < numBoxes; ++i) {
+        endpoints[2*i + 0].box = static_cast<uint32_t>(i << 1);
+        endpoints[2*i + 1].box = static_cast<uint32_t>((i << 1) | 1u);
+    }
+    needsReset = false;
+}
+
+const std::vector<CollisionPair>& SweepAndPrune::findPairs() {
+    bool fullSort = needsReset;
+    if (needsReset) {
+        reset();
+    }
+
+    const std::vector<float>& axisMin = minOf(axis);
+    const std::vector<float>& axisMax = maxOf(axis);
+
+    // Refresh the endpoint values, keeping the order of the last frame
+    for (Endpoint& endpoint : endpoints) {
+        uint32_t index = endpoint.index();
+        endpoint.value = endpoint.isMax() ? axisMax[index] : axisMin[index];
+    }
+
+    // Minimums go before maximums of equal value so that touching boxes are reported
+    auto endpointLess = [](const Endpoint& p, const Endpoint& q) {
+        return p.value < q.value || (p.value == q.value && !p.isMax() && q.isMax());
+    };
+
+    lastSwapCount = 0;
+    if (fullSort) {
+        std::sort(endpoints.begin(), endpoints.end(), endpointLess);
+    } else {
+        // Insertion sort, nearly linear thanks to temporal coherence
+        for (size_t i = 1; i < endpoints.size(); ++i) {
+            Endpoint key = endpoints[i];
+            size_t j = i;
+            while (j > 0 && endpointLess(key, endpoints[j-1])) {
+                endpoints[j] = endpoints[j-1];
+                --j;
+                ++lastSwapCount;
+            }
+            endpoints[j] = key;
+        }
+    }
+
+    // Sweep: every box starting while another is still open overlaps it on
+    // the sweep axis, so only the two other axes need to be tested
+    const int axisU = (axis + 1) % 3;
+    const int axisV = (axis + 2) % 3;
+    const std::vector<float>& minU = minOf(axisU);
+    const std::vector<float>& maxU = maxOf(axisU);
+    const std::vector<float>& minV = minOf(axisV);
+    const std::vector<float>& maxV = maxOf(axisV);
+
+    pairs.clear();
+    active.clear();
+    for (const Endpoint& endpoint : endpoints) {
+        uint32_t index = endpoint.index();
+        if (endpoint.isMax()) {
+            // Swap-remove the box from the active list
+            uint32_t position = activePosition[index];
+            active[position] = active.back();
+            activePosition[active[position].index] = position;
+            active.pop_back();
+            continue;
+        }
+
+        const ActiveBox box = {index, minU[index], maxU[index], minV[index], maxV[index]};
+        // Branchless filter: every active box is written to the candidate
+        // buffer and only kept if it overlaps, since the outcome is random
+        if (candidates.size() < active.size()) {
+            candidates.resize(2 * active.size());
+        }
+        uint32_t* out = candidates.data();
+        for (const ActiveBox& other : active) {
+            bool overlap = (box.minU <= other.maxU) & (box.maxU >= other.minU) &
+                           (box.minV <= other.maxV) & (box.maxV >= other.minV);
+            *out = other.index;
+            out += overlap;
+        }
+        for (const uint32_t* other = candidates.data(); other != out; ++other) {
+            pairs.push_back({std::min(index, *other), std::max(index, *other)});
+        }
+
+        activePosition[index] = static_cast<uint32_t>(active.size());
+        active.push_back(box);
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](const CollisionPair& p, const CollisionPair& q) {
+        return p.a < q.a || (p.a == q.a && p.b < q.b);
+    });
+
+    return pairs;
+}
@@ -1,5 +1,9 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "utils/file_utils.h"
@@ -38,9 +42,71 @@ std::vector<std::string> getFiles(const std::string& folderPath) {
 }
 
 
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    // Shared for writing, so that patchFile() can refresh the header of a
+    // cache file while it is mapped
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedData = static_cast<const uint8_t*>(view);
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData != nullptr) {
+        UnmapViewOfFile(mappedData);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+    }
+    mappedData = nullptr;
+    mappedSize = 0;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(mappedData, other.mappedData);
+        std::swap(mappedSize, other.mappedSize);
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+    }
+    return *this;
+}
+
 #elif __linux__ || __APPLE__
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 bool endsWith(const std::string& str, const std::string& suffix) {
     return str.size() >= suffix.size() && 
@@ -99,6 +165,89 @@ std::vector<std::string> getFiles(const std::string& folderPath) {
     return objFiles;
 }
 
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(file);
+        return false;
+    }
+    void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps its own reference to the file
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    mappedData = static_cast<const uint8_t*>(view);
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData != nullptr) {
+        munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+    }
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(mappedData, other.mappedData);
+        std::swap(mappedSize, other.mappedSize);
+    }
+    return *this;
+}
+
 #else
 #error "Unsupported platform"
-#endif
\ No newline at end of file
+#endif
+
+bool getSourceInfo(const std::string& path, SourceInfo& info) {
+    std::error_code error;
+    info.size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    info.time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    return !error;
+}
+
+uint64_t hashFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    uint64_t hash = 14695981039346656037ULL;
+    char buffer[1 << 16];
+    while (file) {
+        file.read(buffer, sizeof(buffer));
+        for (std::streamsize i = 0; i < file.gcount(); ++i) {
+            hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+bool patchFile(const std::string& path, uint64_t offset, const void* data, size_t size) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+std::string makeTempPath(const std::string& path) {
+    static std::atomic<uint32_t> counter(0);
+#ifdef _WIN32
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+    return path + "." + std::to_string(processId) + "." + std::to_string(counter++) + ".tmp";
+}
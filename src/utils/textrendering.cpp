@@ -1,6 +1,9 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
+#include <cstring>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -87,6 +90,161 @@ GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+namespace {
+
+struct TextVertex {
+    float x, y, s, t;
+};
+
+// Glyph of each codepoint, so that a character is found with a single
+// lookup. The font only has glyphs for ASCII.
+const size_t numCodepoints = 128;
+const texture_glyph_t* glyphTable[numCodepoints] = {};
+
+/* A string printed at a given position and scale, in a window of a given
+ * size: the quads built for it stay valid as long as none of them changes */
+struct TextKey {
+    std::string str;
+    float x, y, scale;
+    int width, height;
+
+    bool operator==(const TextKey& other) const {
+        return str == other.str && x == other.x && y == other.y && scale == other.scale
+               && width == other.width && height == other.height;
+    }
+};
+
+struct TextKeyHash {
+    size_t operator()(const TextKey& key) const {
+        size_t hash = std::hash<std::string>()(key.str);
+        float values[3] = {key.x, key.y, key.scale};
+        uint32_t bits[3];
+        std::memcpy(bits, values, sizeof(bits));
+        for (uint32_t b : bits) {
+            hash = hash * 31 + b;
+        }
+        return hash * 31 + static_cast<size_t>(key.width) * 65537 + static_cast<size_t>(key.height);
+    }
+};
+
+/* Range of textVBO holding the quads of a string */
+struct CachedText {
+    GLint first;
+    GLsizei count;
+    bool used; // Since the last time the cache was compacted
+};
+
+// Every string printed is kept in textVBO, six vertices per glyph. When it
+// is full, the strings printed since the last time it was full are moved to
+// its start and the others are dropped, so the ones printed each frame
+// (the life bar) are only built once and the ones that change make room.
+std::unordered_map<TextKey, CachedText, TextKeyHash> textCache;
+std::vector<TextVertex> textVertices; // Copy of the used part of textVBO
+size_t textBufferCapacity = 6 * 1024; // Vertices
+std::vector<TextVertex> newTextVertices; // Reused by every uncached string
+
+void appendGlyphQuads(const std::string& str, float x, float y, float sx, float sy, std::vector<TextVertex>& vertices)
+{
+    float ds = 0.5f / dejavufont.tex_width;
+    float dt = 0.5f / dejavufont.tex_height;
+    for (char c : str)
+    {
+        unsigned char codepoint = static_cast<unsigned char>(c);
+        const texture_glyph_t* glyph = codepoint < numCodepoints ? glyphTable[codepoint] : nullptr;
+        if (!glyph) {
+            continue;
+        }
+        x += glyph->kerning[0].kerning;
+        float x0 = (float) (x + glyph->offset_x * sx);
+        float y0 = (float) (y + glyph->offset_y * sy);
+        float x1 = (float) (x0 + glyph->width * sx);
+        float y1 = (float) (y0 - glyph->height * sy);
+
+        float s0 = glyph->s0 - ds;
+        float t0 = glyph->t0 - dt;
+        float s1 = glyph->s1 - ds;
+        float t1 = glyph->t1 - dt;
+
+        TextVertex quad[6] = {
+            { x0, y0, s0, t0 },
+            { x0, y1, s0, t1 },
+            { x1, y1, s1, t1 },
+            { x0, y0, s0, t0 },
+            { x1, y1, s1, t1 },
+            { x1, y0, s1, t0 }
+        };
+        vertices.insert(vertices.end(), quad, quad + 6);
+
+        x += (glyph->advance_x * sx);
+    }
+}
+
+// Keep only the strings used since the last call, at the start of textVBO,
+// growing it if they and 'needed' more vertices do not fit
+void compactTextCache(size_t needed)
+{
+    std::vector<TextVertex> kept;
+    for (auto it = textCache.begin(); it != textCache.end(); )
+    {
+        if (!it->second.used) {
+            it = textCache.erase(it);
+            continue;
+        }
+        GLint first = static_cast<GLint>(kept.size());
+        kept.insert(kept.end(), textVertices.begin() + it->second.first,
+                    textVertices.begin() + it->second.first + it->second.count);
+        it->second.first = first;
+        it->second.used = false;
+        ++it;
+    }
+    textVertices.swap(kept);
+
+    bool grow = textVertices.size() + needed > textBufferCapacity;
+    while (textVertices.size() + needed > textBufferCapacity) {
+        textBufferCapacity *= 2;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    if (grow) {
+        glBufferData(GL_ARRAY_BUFFER, textBufferCapacity * sizeof(TextVertex), NULL, GL_DYNAMIC_DRAW);
+    }
+    if (!textVertices.empty()) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, textVertices.size() * sizeof(TextVertex), textVertices.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Range of textVBO with the quads of a string, built on its first use
+const CachedText& findText(const TextKey& key)
+{
+    auto found = textCache.find(key);
+    if (found != textCache.end()) {
+        found->second.used = true;
+        return found->second;
+    }
+
+    newTextVertices.clear();
+    appendGlyphQuads(key.str, key.x, key.y, key.scale / key.width, key.scale / key.height, newTextVertices);
+    if (textVertices.size() + newTextVertices.size() > textBufferCapacity) {
+        compactTextCache(newTextVertices.size());
+    }
+
+    CachedText text;
+    text.first = static_cast<GLint>(textVertices.size());
+    text.count = static_cast<GLsizei>(newTextVertices.size());
+    text.used = true;
+    if (text.count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, text.first * sizeof(TextVertex), text.count * sizeof(TextVertex),
+                        newTextVertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        textVertices.insert(textVertices.end(), newTextVertices.begin(), newTextVertices.end());
+    }
+    return textCache.emplace(key, text).first->second;
+}
+
+} // namespace
+
 void TextRendering_Init()
 {
     GLuint sampler;
@@ -127,7 +285,7 @@ void TextRendering_Init()
     glBindVertexArray(textVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, textBufferCapacity * sizeof(TextVertex), NULL, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
@@ -140,79 +298,43 @@ void TextRendering_Init()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     glCheckError();
+
+    for (size_t i = 0; i < dejavufont.glyphs_count; ++i)
+    {
+        const texture_glyph_t& glyph = dejavufont.glyphs[i];
+        if (glyph.codepoint < numCodepoints && !glyphTable[glyph.codepoint]) {
+            glyphTable[glyph.codepoint] = &glyph;
+        }
+    }
 }
 
 void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
 {
     int width, height;
     glfwGetWindowSize(window, &width, &height);
-    float sx = scale / width;
-    float sy = scale / height;
-
-    for (char i : str)
-    {
-        // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = nullptr;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
-        {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)i)
-            {
-                glyph = &dejavufont.glyphs[j];
-                break;
-            }
-        }
-        if (!glyph) {
-            continue;
-        }
-        x += glyph->kerning[0].kerning;
-        float x0 = (float) (x + glyph->offset_x * sx);
-        float y0 = (float) (y + glyph->offset_y * sy);
-        float x1 = (float) (x0 + glyph->width * sx);
-        float y1 = (float) (y0 - glyph->height * sy);
-
-        float s0 = glyph->s0 - 0.5f/dejavufont.tex_width;
-        float t0 = glyph->t0 - 0.5f/dejavufont.tex_height;
-        float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
-        float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
-
-        struct {float x, y, s, t;} data[6] = {
-            { x0, y0, s0, t0 },
-            { x0, y1, s0, t1 },
-            { x1, y1, s1, t1 },
-            { x0, y0, s0, t0 },
-            { x1, y1, s1, t1 },
-            { x1, y0, s1, t0 }
-        };
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glUseProgram(textprogram_id);
-
-        // Set the text color to red
-        GLint colorLocation = glGetUniformLocation(textprogram_id, "textColor");
-        if (colorLocation != -1) {
-            glUniform4f(colorLocation, 1.0f, 0.0f, 0.0f, 1.0f);
-        }
-
-        glBindVertexArray(textVAO);
+    if (width == 0 || height == 0) {
+        return;
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    // Every glyph of the string, with a single draw call
+    const CachedText& text = findText({str, x, y, scale, width, height});
+    if (text.count == 0) {
+        return;
+    }
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
 
-        glDisable(GL_BLEND);
+    glUseProgram(textprogram_id);
+    glBindVertexArray(textVAO);
+    glDrawArrays(GL_TRIANGLES, text.first, text.count);
+    glBindVertexArray(0);
+    glUseProgram(0);
 
-        x += (glyph->advance_x * sx);
-    }
+    glDepthFunc(GL_LESS);
+    glDisable(GL_BLEND);
 }
 
 float TextRendering_LineHeight(GLFWwindow* window, float scale = 1.0f)
@@ -0,0 +1,81 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned numThreads) {
+    if (numThreads == 0) {
+        numThreads = defaultThreadCount();
+    }
+    for (unsigned i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+        ++numPending;
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this] { return numPending == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& job) {
+    // Workers take the next index from a shared counter, so uneven jobs
+    // still keep every thread busy
+    std::atomic<size_t> next(0);
+    for (unsigned i = 0; i < size(); ++i) {
+        submit([&next, count, &job] {
+            for (size_t index = next++; index < count; index = next++) {
+                job(index);
+            }
+        });
+    }
+    wait();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --numPending;
+            if (numPending == 0) {
+                jobsDone.notify_all();
+            }
+        }
+    }
+}